@@ -0,0 +1,26 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <stdint.h>
+#include "common.h"
+
+/*
+ * Optional cgroup v2 placement of a module. Every module gets its own leaf under CGROUP_ROOT,
+ * created by the daemon before the fork; the child moves itself in before dropping privileges.
+ * Failures are logged and ignored: limits are a safety net, not a precondition to run.
+ */
+#define CGROUP_ROOT         "/sys/fs/cgroup/zenith"
+
+typedef struct module_cgroup_s {
+    uint32_t cpu_weight;        /* cpu.weight, 1..10000 (100 = default). 0 leaves it alone */
+    uint64_t memory_max;        /* memory.max in bytes. 0 = no limit */
+    uint32_t io_weight;         /* io.weight, 1..10000 (100 = default). 0 leaves it alone */
+} module_cgroup_t;
+
+/* Daemon side: creates CGROUP_ROOT/<name> and applies 'limits'. Done once per module per run */
+ProjectStatus cgroup_prepare(const char* name, const module_cgroup_t* limits);
+
+/* Child side: moves the calling process into CGROUP_ROOT/<name> */
+ProjectStatus cgroup_enter(const char* name);
+
+#endif // CGROUP_H
@@ -5,10 +5,61 @@
 #include <stdint.h>
 #include <sys/types.h>
 
-#define TIMEOUT_IPC_MS      2000  /* Timeout: waiting for module response */
-#define TIMEOUT_EXIT_MS     1000  /* Timeout: waiting for process exit */
+#define TIMEOUT_IPC_MS      2000  /* Timeout: waiting for module response, unless the module declares one */
+#define TIMEOUT_EXIT_MS     1000  /* Timeout: waiting for process exit, unless the module declares one */
 #define POLL_INTERVAL_MS    50    /* Timeout: waitpid interval */
 
+/*
+ * Hard bound of a whole run. Collection stages share what is left of it; stages flagged 'always'
+ * (the upload) get their declared budgets reserved at the end and run with whatever was collected.
+ */
+#define RUN_DEADLINE_MS         16000
+#define RUN_CANCEL_GRACE_MS     200     /* SIGTERM -> SIGKILL for modules still running at the deadline */
+
+/* Worker pool: pre-fork one sandboxed worker per module instead of forking per stage */
+#define CONFIG_WORKER_POOL          0
+#define WORKER_POOL_MAX_REQUESTS    32    /* Requests served before a worker is recycled */
+
+/*
+ * Stage fusion: stages of modules sharing a security domain (same uid, gid and SELinux context)
+ * are served one after the other by a single sandboxed process per run, forked and reaped once
+ */
+#define CONFIG_STAGE_FUSION         1
+
+/* Latency histograms are always kept, this also writes them as CSV/JSON after every run */
+#define CONFIG_LATENCY_EXPORT       0
+
+/*
+ * Response deadlines from each module's latency history: ADAPTIVE_DEADLINE_FACTOR times its
+ * p99.9, clamped to [ADAPTIVE_DEADLINE_MIN_MS, timeout_max_ms]. The declared timeout_ms is used
+ * until ADAPTIVE_MIN_SAMPLES responses were seen.
+ */
+#define CONFIG_ADAPTIVE_DEADLINE    0
+#define ADAPTIVE_DEADLINE_PCT       99.9
+#define ADAPTIVE_DEADLINE_FACTOR    3
+#define ADAPTIVE_DEADLINE_MIN_MS    50
+#define ADAPTIVE_MIN_SAMPLES        32
+
+/*
+ * Resident mode: the daemon stays up and re-runs each stage on its own interval (resident.h)
+ * instead of doing one run per launch. Every period gets up to RESIDENT_JITTER_PCT percent added.
+ */
+#define CONFIG_RESIDENT_MODE        0
+#define RESIDENT_COLLECT_MS         (6u * 3600u * 1000u)    /* IMEI, phone number */
+#define RESIDENT_UPLOAD_MS          (3600u * 1000u)
+#define RESIDENT_DB_CLEAN_MS        (24u * 3600u * 1000u)
+#define RESIDENT_JITTER_PCT         10
+
+/* SAL backend: 0 = dlopen/dlsym on first use, 1 = link liblog/libc/libselinux/libsqlite directly */
+#define CONFIG_SAL_STATIC_LINK      0
+
+/* System properties: 0 = bionic's property area, 1 = the file-backed stand-in of props_file.h */
+#ifdef __ANDROID__
+#define CONFIG_SAL_PROPS_FILE       0
+#else
+#define CONFIG_SAL_PROPS_FILE       1
+#endif
+
 typedef enum module_id_s {
     MOD_ID_IMEI = 0,
     MOD_ID_PHONE,
@@ -39,7 +90,8 @@ typedef enum {
     STATUS_ERR_NETWORK_FAILURE,
     STATUS_ERR_OPEN_ERROR,
     STATUS_ERR_READ_ERROR,
-    STATUS_ERR_XML_PARSER
+    STATUS_ERR_XML_PARSER,
+    STATUS_ERR_CANCELLED
 } ProjectStatus;
 
 typedef struct daemon_context_s {
@@ -50,10 +102,23 @@ typedef struct daemon_context_s {
     int has_phone;
     int has_mac;
     int db_cleaned;
+
+    struct latency_stats_s* latency;    /* Optional: per-phase stage latencies are recorded here */
+
+    struct result_cache_s* results;     /* Optional: cached results are served without spawning */
+    struct props_snapshot_s* props;     /* Optional: serials of the properties cache signals watch */
+
+    uint64_t deadline_ms;               /* End of the run in sched_clock_ms() time, 0 = unbounded */
+    int partial;                        /* Some stage was cancelled or skipped by the deadline */
 } daemon_context_t;
 
-#define DEBUG(...)
-#define INFO(...)
-#define ERROR(...)
+/* Lowest level recorded by the trace ring, see trace.h. Sites below it compile to nothing */
+#define CONFIG_TRACE_LEVEL  TRACE_LEVEL_INFO
+
+#include "trace.h"
+
+#define DEBUG(...)  TRACE(TRACE_LEVEL_DEBUG, __VA_ARGS__)
+#define INFO(...)   TRACE(TRACE_LEVEL_INFO, __VA_ARGS__)
+#define ERROR(...)  TRACE(TRACE_LEVEL_ERROR, __VA_ARGS__)
 
 #endif // COMMON_H
\ No newline at end of file
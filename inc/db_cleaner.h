@@ -0,0 +1,28 @@
+#ifndef DB_CLEANER_H
+#define DB_CLEANER_H
+
+#include <stdint.h>
+#include "common.h"
+#include "sal.h"
+
+#define DB_CLEAN_CHUNK_ROWS         500                     /* Rows deleted per transaction */
+#define DB_CLEAN_VACUUM_PAGES       256                     /* Pages released per incremental_vacuum step */
+#define DB_CLEAN_BUDGET_MS          (TIMEOUT_IPC_MS / 2)    /* Leaves room to answer before the IPC timeout */
+#define DB_CLEAN_MIGRATE_MAX_BYTES  (8 * 1024 * 1024)       /* Largest DB we switch to auto_vacuum=INCREMENTAL */
+#define DB_CLEAN_WRITE_BYTES_PER_MS (16 * 1024)             /* Conservative eMMC write rate, to price whole-file rewrites */
+
+typedef struct db_clean_report_s {
+    long long rows_deleted;     /* This run */
+    long long pages_freed;      /* This run */
+    int complete;               /* Nothing left to delete or reclaim */
+} db_clean_report_t;
+
+/**
+ * Deletes the stale rows in bounded chunks, then reclaims free pages with incremental_vacuum
+ * and truncates the WAL, stopping as soon as 'budget_ms' is used up. The one-time VACUUM and the
+ * WAL truncation are unbounded steps: they only start if their estimated cost fits what is left.
+ * Progress is kept in 'state_path' so the next run picks up where this one stopped.
+ */
+ProjectStatus db_clean_run(sqlite3* db, const char* state_path, uint32_t budget_ms, db_clean_report_t* report);
+
+#endif // DB_CLEANER_H
@@ -0,0 +1,14 @@
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#include <stddef.h>
+#include "common.h"
+
+/*
+ * Replaces 'path' with 'len' bytes of 'data'. They are written to a file aside, synced, then
+ * renamed over 'path': after a crash, 'path' holds either the old content or the new one, never a
+ * truncated file. The temporary file is named after the process, so concurrent writers don't clash.
+ */
+ProjectStatus write_file_atomic(const char* path, const void* data, size_t len);
+
+#endif // FILE_UTILS_H
@@ -1,28 +1,117 @@
 #ifndef IPC_H
 #define IPC_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "common.h"
 
-/* Simpler code decision: every IPC message is IPC_PACKET_SIZE bytes. */
+/*
+ * Every message is a small ipc_header_t followed by exactly 'data_len' payload bytes.
+ * Messages travel over SOCK_SEQPACKET, so boundaries are kept and a message is never split.
+ * IPC_PACKET_SIZE only bounds the size of a single message.
+ */
+#define IPC_PROTO_VERSION   3
 #define IPC_PACKET_SIZE     4096
-#define PAYLOAD_MAX_SIZE    (IPC_PACKET_SIZE - sizeof(int32_t) - sizeof(int32_t))
 
- /* Aligned to ensure IPC_PACKET_SIZE is enforced */
-__attribute__((aligned(IPC_PACKET_SIZE)))
+/* Module-side CLOCK_MONOTONIC timestamps (ns), comparable with the daemon's since the clock is system-wide */
+typedef struct ipc_timing_s {
+    uint64_t start_ns;      /* Child running after fork, or worker got the request */
+    uint64_t ready_ns;      /* Sandbox entered (setcon/setresuid), module body about to run */
+    uint64_t sent_ns;       /* Response handed to the socket */
+} ipc_timing_t;
+
+typedef enum ipc_mark_s {
+    IPC_MARK_START = 0,
+    IPC_MARK_READY
+} ipc_mark_e;
+
+typedef struct ipc_header_s {
+    uint16_t version;
+    uint16_t flags;
+    int32_t status_code;
+    uint32_t data_len;
+    int32_t mod_id;         /* Module that answered, tells apart the stages a fused process serves. -1 if unset */
+    ipc_timing_t timing;
+} ipc_header_t;
+
+#define PAYLOAD_MAX_SIZE    (IPC_PACKET_SIZE - sizeof(ipc_header_t))
+
+/* Header flags */
+#define IPC_FLAG_BLOB       0x0001  /* Result lives in a sealed memfd passed with SCM_RIGHTS */
+#define IPC_FLAG_TLV        0x0002  /* Payload is a TLV buffer (tlv.h) rather than a string */
+
+/* Room for a TLV payload built in place in ipc_response_t.payload */
+#define IPC_TLV_MAX         (PAYLOAD_MAX_SIZE - 1)
+
 typedef struct ipc_response_s {
     /* Status of the IPC operation */
     int32_t status_code;
+    uint16_t flags;
 
-    /* The response payload from the module + its length */
+    /* The response payload from the module + its length. Only 'data_len' bytes are meaningful */
     uint32_t data_len;
     char payload[PAYLOAD_MAX_SIZE];
+
+    /* Local only: memfd received along with an IPC_FLAG_BLOB message, -1 otherwise */
+    int blob_fd;
+
+    /* Filled on receive: module that answered, see ipc_set_module() */
+    int32_t mod_id;
+
+    /* Filled on receive: when the module started, got ready and answered */
+    ipc_timing_t timing;
 } ipc_response_t;
 
+/*
+ * Large results bypass the packet size limit: the module fills a memfd, seals it and passes
+ * the fd over the socketpair. The daemon maps it read-only, no byte is copied on either side.
+ */
+typedef struct ipc_blob_s {
+    void* data;
+    size_t size;
+    int fd;
+} ipc_blob_t;
+
+/* Daemon -> module request, used by long-lived workers that serve more than one packet */
+#define IPC_REQUEST_ARG_MAX (IPC_PACKET_SIZE - 3 * sizeof(int32_t))
+
+typedef enum ipc_opcode_s {
+    IPC_OP_RUN = 1,     /* Run the module entry point with 'arg' */
+    IPC_OP_EXIT         /* Worker should exit */
+} ipc_opcode_e;
+
+typedef struct ipc_request_s {
+    int32_t opcode;
+    int32_t mod_id;     /* Module to run: a worker serves every module of its security domain */
+    int32_t has_arg;    /* Distinguishes a NULL arg from an empty one */
+    char arg[IPC_REQUEST_ARG_MAX];
+} ipc_request_t;
+
 /* Exported Methods */
 void ipc_set_data(ipc_response_t* resp, const char* data);
+/* Successful response whose first 'len' payload bytes were filled by a tlv_writer_t */
+void ipc_set_tlv(ipc_response_t* resp, size_t len);
 void ipc_set_error(ipc_response_t* resp, int code, const char* msg);
 ProjectStatus ipc_receive_packet(int socket_fd, ipc_response_t* resp);
 ProjectStatus ipc_send_packet(int socket_fd, const ipc_response_t* resp);
 
+/* Module side: creates a writable blob of 'capacity' bytes to fill in place */
+ProjectStatus ipc_blob_create(ipc_blob_t* blob, size_t capacity);
+/* Module side: shrinks the blob to 'used' bytes, seals it and sends it as the response */
+ProjectStatus ipc_send_blob(int socket_fd, ipc_blob_t* blob, size_t used);
+/* Daemon side: maps the blob attached to 'resp' read-only. Takes ownership of resp->blob_fd */
+ProjectStatus ipc_map_blob(ipc_response_t* resp, size_t max_size, ipc_blob_t* blob);
+/* Unmaps and closes a blob from either side */
+void ipc_release_blob(ipc_blob_t* blob);
+
+/* Module side: timestamps a phase, reported with the next response */
+void ipc_mark(ipc_mark_e mark);
+
+/* Module side: tags the next responses with the module they come from */
+void ipc_set_module(int mod_id);
+
+/* 'arg_len' is the size of a binary (TLV) 'arg', 0 if 'arg' is a C string */
+ProjectStatus ipc_send_request(int socket_fd, int opcode, int mod_id, const char* arg, size_t arg_len);
+ProjectStatus ipc_receive_request(int socket_fd, ipc_request_t* req);
+
 #endif // IPC_H
\ No newline at end of file
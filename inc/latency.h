@@ -0,0 +1,69 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+/*
+ * Per-module, per-phase latency histograms. Buckets are HDR-style (log-linear): every power of
+ * two is split into LATENCY_SUB_BUCKETS linear buckets, so the relative error stays below
+ * 1/LATENCY_SUB_BUCKETS from 1 us up to about an hour. Histograms are merged into a file after
+ * every run, so percentiles cover the device's whole history.
+ */
+#define LATENCY_STATS_PATH      "/data/local/tmp/latency.hist"
+#define LATENCY_EXPORT_CSV      "/data/local/tmp/latency.csv"
+#define LATENCY_EXPORT_JSON     "/data/local/tmp/latency.json"
+
+#define LATENCY_SUB_BITS        4
+#define LATENCY_SUB_BUCKETS     (1u << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS        32      /* Values are clamped to 2^32 us */
+#define LATENCY_BUCKETS         (LATENCY_SUB_BUCKETS * (LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1))
+
+typedef enum latency_phase_s {
+    LAT_PHASE_DISPATCH = 0,     /* Daemon starts the stage -> module process running (fork, or hand-off to a worker) */
+    LAT_PHASE_SANDBOX,          /* setcon/setresgid/setresuid */
+    LAT_PHASE_BODY,             /* Module entry point, up to its response */
+    LAT_PHASE_IPC,              /* Response sent -> read by the daemon (poll wakeup + receive) */
+    LAT_PHASE_REAP,             /* Response read -> child reaped */
+    LAT_PHASE_TOTAL,            /* Stage start -> stage done */
+    LAT_PHASE_COUNT
+} latency_phase_e;
+
+typedef struct latency_hist_s {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t min_us;
+    uint64_t max_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+typedef struct latency_stats_s {
+    uint32_t magic;
+    uint32_t version;
+    latency_hist_t hist[MODULE_COUNT][LAT_PHASE_COUNT];
+} latency_stats_t;
+
+void latency_init(latency_stats_t* stats);
+void latency_record(latency_stats_t* stats, int mod_id, latency_phase_e phase, uint64_t value_us);
+
+/* Value at or below which 'pct' percent of the samples are. 0 if the histogram is empty */
+uint64_t latency_percentile(const latency_hist_t* hist, double pct);
+
+/*
+ * Upper bound of the module's response time (stage start -> response read) at 'pct': the sum of
+ * the phases' percentiles. 0 if fewer than 'min_samples' responses were recorded.
+ */
+uint64_t latency_response_bound_us(const latency_stats_t* stats, int mod_id, double pct, uint64_t min_samples);
+
+/* Loads the persisted histograms, or starts empty if there are none (or they are unreadable) */
+void latency_load(latency_stats_t* stats, const char* path);
+ProjectStatus latency_save(const latency_stats_t* stats, const char* path);
+
+/* One row / object per module and phase: count, mean, min, p50, p90, p99, p99.9, max (us) */
+ProjectStatus latency_export_csv(const latency_stats_t* stats, const char* path);
+ProjectStatus latency_export_json(const latency_stats_t* stats, const char* path);
+
+const char* latency_phase_name(latency_phase_e phase);
+
+#endif // LATENCY_H
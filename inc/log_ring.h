@@ -0,0 +1,49 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+#define LOG_RING_CAPACITY       64      /* Records kept, the oldest is overwritten when full */
+#define LOG_RING_MSG_MAX        96      /* Longer messages are truncated */
+#define LOG_RING_FLUSH_RECORDS  32      /* Flush threshold: pending records */
+#define LOG_RING_FLUSH_MS       30000   /* Flush threshold: age of the oldest pending record */
+
+#define LOG_STAGE_NONE          (-1)    /* Record not tied to a stage */
+
+typedef struct log_record_s {
+    uint64_t ts_ms;                     /* Wall clock, so the server can order records across runs */
+    int16_t stage;
+    uint16_t len;
+    char msg[LOG_RING_MSG_MAX];
+} log_record_t;
+
+/*
+ * Remote log records collected in the daemon, sent by the Logger module in batches.
+ * Only touched from the scheduler loop (callbacks), so there is no locking.
+ */
+typedef struct log_ring_s {
+    log_record_t records[LOG_RING_CAPACITY];
+    uint32_t head;                      /* Next record to drain */
+    uint32_t count;
+    uint32_t dropped;                   /* Overwritten before they could be drained */
+} log_ring_t;
+
+void log_ring_init(log_ring_t* ring);
+
+/* Queues a record. Never blocks, never fails: when full the oldest record makes room */
+void log_ring_push(log_ring_t* ring, int stage, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/* Non-zero once enough records are pending, or the oldest has waited long enough */
+int log_ring_should_flush(const log_ring_t* ring, uint64_t now_ms);
+
+/**
+ * Moves as many whole records as fit into 'out_buf', one "<ts_ms> <stage> <msg>\n" line each.
+ * Records that do not fit stay queued for the next batch. Returns the batch length.
+ */
+size_t log_ring_drain(log_ring_t* ring, char* out_buf, size_t max_len);
+
+uint64_t log_ring_now_ms(void);
+
+#endif // LOG_RING_H
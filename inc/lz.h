@@ -0,0 +1,27 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+/*
+ * Small LZ77 compressor for upload frames, LZ4 block format: sequences of a token (literal length
+ * and match length nibbles), the literals, a 2-byte little-endian offset and the extra match
+ * length bytes. The last sequence has literals only. Greedy, one hash probe per position: built
+ * for a few KiB of repetitive records, not for ratio.
+ */
+#define LZ_MIN_MATCH        4
+#define LZ_HASH_BITS        12
+#define LZ_MAX_INPUT        0xFFFF      /* Offsets are 16 bits */
+
+/* Worst case output size for 'len' input bytes */
+#define LZ_BOUND(len)       ((len) + (len) / 255 + 16)
+
+/* Compressed size, or 0 if 'src' is too large or the output did not fit in 'cap' */
+size_t lz_compress(const void* src, size_t len, void* dst, size_t cap);
+
+/* STATUS_ERR_INVALID_ARG if the input is malformed or decompresses to more than 'cap' bytes */
+ProjectStatus lz_decompress(const void* src, size_t len, void* dst, size_t cap, size_t* out_len);
+
+#endif // LZ_H
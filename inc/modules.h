@@ -3,6 +3,23 @@
 
 #include <sys/types.h>
 #include "common.h"
+#include "cgroup.h"
+#include "result_cache.h"
+
+/*
+ * Scheduling attributes of a module process, applied in the child before the sandbox is entered.
+ * Lets background modules (VACUUM, uploads) yield cores and disk to latency-sensitive stages.
+ */
+typedef struct module_sched_s {
+    uint64_t cpu_mask;          /* Bit N = CPU N. 0 inherits the daemon's affinity */
+    int policy;                 /* SCHED_OTHER, SCHED_BATCH or SCHED_IDLE */
+    int nice;                   /* -20..19, ignored by SCHED_IDLE */
+    int ioprio_class;           /* IOPRIO_CLASS_BE or IOPRIO_CLASS_IDLE, 0 inherits */
+    int ioprio_level;           /* 0 (highest)..7, best-effort class only */
+} module_sched_t;
+
+#define IOPRIO_CLASS_BE     2
+#define IOPRIO_CLASS_IDLE   3
 
 /* Entrypoint function signature for each module */
 typedef void (*module_entry_fn)(int socket_fd, const char* input_arg);
@@ -17,8 +34,57 @@ typedef struct module_config_s {
     const char* selinux_context;
 
     module_entry_fn entry_point;
+
+    /* Largest memfd result (ipc_send_blob) accepted from this module. 0 = packet-sized results only */
+    size_t max_blob_size;
+
+    /* cgroup v2 limits, NULL to run in the daemon's own cgroup */
+    const module_cgroup_t* cgroup;
+
+    /* Affinity, policy, nice and I/O priority. NULL inherits the daemon's */
+    const module_sched_t* sched;
+
+    /* Response and exit budgets in ms. 0 = TIMEOUT_IPC_MS / TIMEOUT_EXIT_MS */
+    uint32_t timeout_ms;
+    uint32_t exit_timeout_ms;
+    uint32_t timeout_max_ms;    /* Ceiling of the adaptive deadline. 0 = timeout_ms */
+
+    /* Extra attempts after a timeout or crash. Errors reported by the module itself are final */
+    uint8_t retries;
+
+    /* If this module fails, so does the run: sched_run() reports it */
+    uint8_t critical;
+
+    /* Result reuse across runs, NULL to always spawn. Only for modules that take no 'arg' */
+    const module_cache_t* cache;
 } module_config_t;
 
+/* TLV tags (tlv.h) of module results and of the record the daemon hands to the Sender */
+typedef enum result_tag_s {
+    RESULT_TAG_UPLOAD = 1,          /* Record: one run's artifacts */
+    RESULT_TAG_IMEI,                /* Bytes, absent if it could not be read */
+    RESULT_TAG_PHONE,               /* Bytes, absent if it could not be read */
+    RESULT_TAG_DB_CLEANED,          /* Uint, 0/1 */
+    RESULT_TAG_PARTIAL,             /* Uint, 0/1: the run deadline cut collection short */
+    RESULT_TAG_ROWS_DELETED,        /* Uint, DBCleaner result */
+    RESULT_TAG_PAGES_FREED,         /* Uint, DBCleaner result */
+    RESULT_TAG_CLEAN_COMPLETE,      /* Uint, DBCleaner result: 0 if work is left for the next run */
+    RESULT_TAG_BATCH,               /* Record: the Sender's 'arg'. BASE_VERSION, BASELINE, then UPLOAD records, oldest first */
+    RESULT_TAG_SENT,                /* Uint, Sender result: UPLOAD records delivered, in order */
+    RESULT_TAG_BASE_VERSION,        /* Uint: records the server acknowledged so far, see upload.h */
+    RESULT_TAG_BASELINE,            /* Record: fields of the last UPLOAD record the server acknowledged */
+    RESULT_TAG_DELTA,               /* Record, upload frame: the fields of an UPLOAD record that changed */
+    RESULT_TAG_CLEARED,             /* Uint, in a DELTA: bit 'tag' set for every field that was dropped */
+    RESULT_TAG_FULL,                /* Uint, upload frame: the first DELTA is against an empty state */
+    RESULT_TAG_RESYNC               /* Uint, Sender result: the server asked for a full upload */
+} result_tag_e;
+
 const module_config_t* get_module_config(int module_id);
 
+/*
+ * Non-zero if both modules run under the same credentials: uid, gid and SELinux context, and no
+ * resource limits of their own. Such modules may share one sandboxed process.
+ */
+int module_same_domain(const module_config_t* a, const module_config_t* b);
+
 #endif // MODULES_H
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "common.h"
+#include "modules.h"
+
+/* Resource usage of one reaped child, from wait4() */
+typedef struct process_usage_s {
+    int valid;                  /* 0 if the child was reaped elsewhere (ECHILD) */
+    uint64_t utime_us;
+    uint64_t stime_us;
+    long maxrss_kb;
+    long minflt;
+    long majflt;
+    long nvcsw;                 /* Voluntary context switches (blocking) */
+    long nivcsw;                /* Involuntary context switches (preempted) */
+} process_usage_t;
+
+/**
+ * Forks a sandboxed child for the given module. The child switches to the module's
+ * selinux context + uid/gid and runs its entry point with 'arg'.
+ * On success returns the child pid and stores the daemon side of the socketpair in 'parent_fd'.
+ */
+pid_t spawn_module_process(const module_config_t* config, int* parent_fd, const char* arg);
+
+/**
+ * Forks a sandboxed long-lived worker for the given module. The worker is credentialed once,
+ * then runs the entry point of the requested module for every IPC_OP_RUN request it receives on
+ * 'parent_fd'. Requests for a module outside of the worker's domain (module_same_domain()) are
+ * answered with an error.
+ */
+pid_t spawn_module_worker(const module_config_t* config, int* parent_fd);
+
+/**
+ * Module side: non-zero once the daemon asked the module to wrap up (SIGTERM at the run deadline).
+ * Long-running modules check it between units of work and answer with what they have; the
+ * daemon sends SIGKILL after RUN_CANCEL_GRACE_MS.
+ */
+int module_cancel_requested(void);
+
+/**
+ * Returns a pidfd that becomes readable once 'pid' exits, or -1 if the kernel lacks pidfd_open.
+ * Only valid for our own, not yet reaped, children.
+ */
+int open_process_fd(pid_t pid);
+
+/**
+ * Non-blocking reap. Returns STATUS_SUCCESS once 'pid' is gone, STATUS_ERR_GENERIC if it still runs.
+ * If 'usage' is not NULL it receives the child's resource usage.
+ */
+ProjectStatus reap_process(pid_t pid, process_usage_t* usage);
+
+/**
+ * Reaps 'pid', escalating to SIGKILL if it does not exit within TIMEOUT_EXIT_MS.
+ * Waits on a pidfd when available, otherwise polls waitpid every POLL_INTERVAL_MS.
+ * If 'usage' is not NULL it receives the child's resource usage.
+ */
+ProjectStatus wait_for_process_exit(pid_t pid, process_usage_t* usage);
+
+#endif // PROCESS_H
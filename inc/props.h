@@ -0,0 +1,42 @@
+#ifndef PROPS_H
+#define PROPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "sal.h"
+
+/*
+ * Batched property snapshot. Each property is looked up once; a refresh then costs a single area
+ * serial load when nothing was written anywhere, and one serial load per property otherwise. Only
+ * properties whose serial moved are read again.
+ * The daemon keeps one over the properties its result cache watches, see daemon_context_t.
+ */
+#define PROPS_SNAPSHOT_MAX  64
+#define PROPS_VALUE_MAX     92
+
+typedef struct props_entry_s {
+    const char* name;               /* Set by the caller */
+    const prop_info* pi;            /* NULL while the property does not exist */
+    uint32_t serial;
+    char value[PROPS_VALUE_MAX];
+} props_entry_t;
+
+typedef struct props_snapshot_s {
+    props_entry_t* entries;
+    size_t count;
+    uint32_t area_serial;           /* As of the last refresh */
+    uint64_t changed;               /* Bit i: entries[i] changed in the last refresh */
+    int primed;
+} props_snapshot_t;
+
+/* 'entries' are owned by the caller, with 'name' set. At most PROPS_SNAPSHOT_MAX of them */
+ProjectStatus props_snapshot_init(props_snapshot_t* snap, props_entry_t* entries, size_t count);
+
+/* Re-reads what changed since the last refresh. Returns the number of changed entries */
+int props_snapshot_refresh(props_snapshot_t* snap);
+
+/* Entry of 'name' as of the last refresh ('pi' NULL if not set), NULL if not part of the snapshot */
+const props_entry_t* props_snapshot_find(const props_snapshot_t* snap, const char* name);
+
+#endif // PROPS_H
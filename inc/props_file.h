@@ -0,0 +1,30 @@
+#ifndef PROPS_FILE_H
+#define PROPS_FILE_H
+
+#include <stdint.h>
+#include "sal.h"
+
+/*
+ * File-backed stand-in for bionic's property area, for Linux hosts (CONFIG_SAL_PROPS_FILE).
+ * Same model: a shared mapping of fixed records, lock-free readers that check a per-property
+ * serial, an area serial bumped by every write, and futex waits on either.
+ * The file is PROPS_FILE_PATH unless the PROPS_FILE environment variable names another one.
+ */
+#define PROPS_FILE_PATH     "/tmp/zenith.props"
+#define PROPS_FILE_MAX      256
+#define PROP_NAME_MAX       64
+#define PROP_VALUE_MAX      92      /* Same as bionic, terminator included */
+
+/* __system_property_get: length of the value, 0 if the property does not exist */
+int props_file_get(const char* name, char* value);
+
+const prop_info* props_file_find(const char* name);
+uint32_t props_file_serial(const prop_info* pi);
+int props_file_read(const prop_info* pi, prop_read_fn callback, void* cookie);
+uint32_t props_file_area_serial(void);
+int props_file_wait(const prop_info* pi, uint32_t old_serial, uint32_t* new_serial, uint32_t timeout_ms);
+
+/* Writer side (property_service's role): creates or updates 'name'. 0 on success */
+int props_file_set(const char* name, const char* value);
+
+#endif // PROPS_FILE_H
@@ -0,0 +1,35 @@
+#ifndef RESIDENT_H
+#define RESIDENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+/*
+ * Resident mode: instead of being re-launched by init for every run, the daemon stays up and
+ * re-runs the stages on their own timers. SAL state, the worker pool, latency histograms and the
+ * result cache stay warm between runs.
+ */
+#define RESIDENT_COALESCE_MS    2000    /* Jobs due this close to a run are folded into it */
+
+typedef struct resident_job_s {
+    uint32_t stages;                /* Stage bits handed to the run callback when the job is due */
+    uint32_t interval_ms;
+    uint32_t jitter_ms;             /* Every period is interval_ms + [0, jitter_ms), spreads a fleet's uploads */
+    int first_run;                  /* Due right at startup rather than after one interval */
+
+    /* Owned by resident_loop() */
+    int fd;                         /* One-shot timerfd, re-armed after every run of the job */
+} resident_job_t;
+
+/* One pipeline run over 'due_stages'. Runs are never concurrent: jobs due meanwhile wait and merge */
+typedef ProjectStatus (*resident_run_fn)(uint32_t due_stages, void* cookie);
+
+/**
+ * Event loop: waits on one timerfd per job plus a signalfd for SIGTERM/SIGINT. Every wakeup turns
+ * into a single run covering all the jobs that are due, or due within RESIDENT_COALESCE_MS.
+ * Returns STATUS_SUCCESS once stopped by a signal.
+ */
+ProjectStatus resident_loop(resident_job_t* jobs, size_t count, resident_run_fn run, void* cookie);
+
+#endif // RESIDENT_H
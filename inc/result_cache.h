@@ -0,0 +1,64 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdint.h>
+#include "common.h"
+#include "props.h"
+
+/*
+ * Persistent cache of module results that rarely change (IMEI, phone number). An entry is served
+ * without spawning the module as long as it is younger than its TTL and the module's change
+ * signal still reads the same token it read when the entry was stored.
+ * Only results of modules that take no 'arg' are cached: the key is the module ID alone.
+ */
+#define RESULT_CACHE_PATH       "/data/local/tmp/result.cache"
+#define RESULT_CACHE_DATA_MAX   256
+
+typedef enum cache_signal_s {
+    CACHE_SIGNAL_NONE = 0,      /* TTL only */
+    CACHE_SIGNAL_PROPERTY,      /* 'source' is a system property: its serial and value */
+    CACHE_SIGNAL_FILE,          /* 'source' is a file: inode, size and mtime */
+    CACHE_SIGNAL_SQLITE         /* 'source' is a database: file change counter and WAL state */
+} cache_signal_e;
+
+typedef struct module_cache_s {
+    uint32_t ttl_ms;
+    cache_signal_e signal;
+    const char* source;
+} module_cache_t;
+
+typedef struct result_cache_entry_s {
+    uint32_t valid;
+    uint32_t len;
+    uint64_t stored_ms;         /* CLOCK_REALTIME: TTLs span reboots */
+    uint64_t token;
+    char data[RESULT_CACHE_DATA_MAX];
+} result_cache_entry_t;
+
+typedef struct result_cache_s {
+    uint32_t magic;
+    uint32_t version;
+    result_cache_entry_t entries[MODULE_COUNT];
+    int dirty;                  /* Not persisted: set when an entry changed since the load */
+} result_cache_t;
+
+/* Loads the persisted cache, or starts empty */
+void result_cache_load(result_cache_t* cache, const char* path);
+
+/* Writes the cache back if an entry changed */
+ProjectStatus result_cache_save(result_cache_t* cache, const char* path);
+
+/*
+ * Reads the current change token of 'policy' into 'token'. Returns STATUS_SUCCESS, or an error if
+ * the signal can't be read (the result must not be cached nor served then).
+ * Properties come from 'props' if it holds them, otherwise they are looked up.
+ */
+ProjectStatus result_cache_token(const module_cache_t* policy, const props_snapshot_t* props, uint64_t* token);
+
+/* Copies a fresh entry of 'mod_id' matching 'token' into 'out'. Returns 1 on a hit, 0 otherwise */
+int result_cache_lookup(const result_cache_t* cache, int mod_id, const module_cache_t* policy, uint64_t token,
+                        char* out, size_t out_size);
+
+void result_cache_store(result_cache_t* cache, int mod_id, uint64_t token, const char* data);
+
+#endif // RESULT_CACHE_H
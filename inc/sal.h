@@ -2,11 +2,21 @@
 #define SAL_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 // --- System Types ---
 typedef int (*pfn_android_log_print)(int prio, const char* tag, const char* fmt, ...);
 typedef int (*pfn_system_property_get)(const char* key, char* value);
 typedef int (*pfn_setcon)(const char* context);
+typedef struct prop_info prop_info;
+typedef const prop_info* (*pfn_system_property_find)(const char* name);
+typedef uint32_t (*pfn_system_property_serial)(const prop_info* pi);
+typedef void (*prop_read_fn)(void* cookie, const char* name, const char* value, uint32_t serial);
+typedef void (*pfn_system_property_read_callback)(const prop_info* pi, prop_read_fn callback, void* cookie);
+typedef _Bool (*pfn_system_property_wait)(const prop_info* pi, uint32_t old_serial, uint32_t* new_serial,
+                                          const struct timespec* relative_timeout);
+typedef uint32_t (*pfn_system_property_area_serial)(void);
 
 // --- SQLite Types ---
 typedef struct sqlite3 sqlite3;
@@ -14,6 +24,27 @@ typedef int (*pfn_sqlite3_open_v2)(const char *filename, sqlite3 **ppDb, int fla
 typedef int (*pfn_sqlite3_exec)(sqlite3*, const char *sql, int (*callback)(void*,int,char**,char**), void *, char **errmsg);
 typedef int (*pfn_sqlite3_close)(sqlite3*);
 typedef void (*pfn_sqlite3_free)(void*);
+typedef struct sqlite3_stmt sqlite3_stmt;
+typedef int (*pfn_sqlite3_prepare_v2)(sqlite3*, const char *sql, int nByte, sqlite3_stmt **ppStmt, const char **pzTail);
+typedef int (*pfn_sqlite3_bind_int64)(sqlite3_stmt*, int, long long);
+typedef int (*pfn_sqlite3_bind_text)(sqlite3_stmt*, int, const char*, int, void(*)(void*));
+typedef int (*pfn_sqlite3_bind_null)(sqlite3_stmt*, int);
+typedef int (*pfn_sqlite3_step)(sqlite3_stmt*);
+typedef int (*pfn_sqlite3_reset)(sqlite3_stmt*);
+typedef int (*pfn_sqlite3_clear_bindings)(sqlite3_stmt*);
+typedef int (*pfn_sqlite3_finalize)(sqlite3_stmt*);
+typedef long long (*pfn_sqlite3_column_int64)(sqlite3_stmt*, int iCol);
+typedef const unsigned char* (*pfn_sqlite3_column_text)(sqlite3_stmt*, int iCol);
+typedef int (*pfn_sqlite3_busy_timeout)(sqlite3*, int ms);
+typedef int (*pfn_sqlite3_changes)(sqlite3*);
+
+// --- SQLite Result Codes (sqlite3.h) ---
+#ifndef SQLITE_ROW
+#define SQLITE_ROW  100
+#endif
+#ifndef SQLITE_DONE
+#define SQLITE_DONE 101
+#endif
 
 // --- Lifecycle ---
 int sal_init(void);
@@ -23,12 +54,43 @@ void sal_cleanup(void);
 void sal_log_info(const char* fmt, ...);
 void sal_log_error(const char* fmt, ...);
 int sal_get_property(const char* key, char* value);
+// Serial of 'key', bumped by every write to it. 0 on success, -1 if unknown or unavailable
+int sal_get_property_serial(const char* key, uint32_t* serial);
 int sal_set_selinux_context(const char* context);
 
+// --- Property Wrappers ---
+// Bionic's property area, or props_file.c's file-backed stand-in (CONFIG_SAL_PROPS_FILE).
+// Lookups are the expensive part: keep the prop_info* and only re-read when the serial moved.
+const prop_info* sal_property_find(const char* name);
+uint32_t sal_property_serial(const prop_info* pi);
+// Consistent value + serial pair through 'callback'. 0 on success, -1 if unavailable
+int sal_property_read(const prop_info* pi, prop_read_fn callback, void* cookie);
+// Bumped by every property write, anywhere
+uint32_t sal_property_area_serial(void);
+// Blocks until the serial of 'pi' (or the area serial if NULL) moves past 'old_serial'.
+// 1 if it did ('new_serial' set), 0 on timeout or if unavailable. timeout_ms 0 = no timeout
+int sal_property_wait(const prop_info* pi, uint32_t old_serial, uint32_t* new_serial, uint32_t timeout_ms);
+
 // --- SQLite Wrappers ---
 int sal_sqlite_open(const char* path, sqlite3** ppDb);
 int sal_sqlite_exec(sqlite3* db, const char* sql, char** errmsg);
+int sal_sqlite_query_int(sqlite3* db, const char* sql, long long* out);
 int sal_sqlite_close(sqlite3* db);
 void sal_sqlite_free(void* ptr);
 
+// --- SQLite Prepared Statements ---
+// Bound text is not copied: it must stay valid until the next step/reset of the statement.
+int sal_sqlite_prepare(sqlite3* db, const char* sql, sqlite3_stmt** ppStmt);
+int sal_sqlite_bind_int64(sqlite3_stmt* stmt, int idx, long long value);
+int sal_sqlite_bind_text(sqlite3_stmt* stmt, int idx, const char* value, int len);
+int sal_sqlite_bind_null(sqlite3_stmt* stmt, int idx);
+int sal_sqlite_step(sqlite3_stmt* stmt);
+int sal_sqlite_reset(sqlite3_stmt* stmt);
+int sal_sqlite_clear_bindings(sqlite3_stmt* stmt);
+int sal_sqlite_finalize(sqlite3_stmt* stmt);
+long long sal_sqlite_column_int64(sqlite3_stmt* stmt, int col);
+const char* sal_sqlite_column_text(sqlite3_stmt* stmt, int col);
+int sal_sqlite_busy_timeout(sqlite3* db, int ms);
+int sal_sqlite_changes(sqlite3* db);
+
 #endif // SYMBOL_RESOLVER
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "common.h"
+#include "worker_pool.h"
+#include "ipc.h"
+#include "process.h"
+
+#define SCHED_MAX_STAGES    16
+#define STAGE_BIT(idx)      (1u << (idx))
+
+typedef struct sched_stage_s sched_stage_t;
+
+/* Called right before the stage is spawned. Used to build 'arg' out of results collected so far. */
+typedef void (*stage_prepare_fn)(sched_stage_t* stage, const daemon_context_t* ctx);
+
+/* Called once the stage finished (success or not). Used to fold the result into the context. */
+typedef void (*stage_complete_fn)(sched_stage_t* stage, daemon_context_t* ctx);
+
+typedef enum stage_state_s {
+    STAGE_PENDING = 0,
+    STAGE_RUNNING,                  /* Waiting for the module's response */
+    STAGE_EXITING,                  /* Response handled, waiting for the child to be reaped */
+    STAGE_DONE
+} stage_state_e;
+
+typedef enum stage_cache_s {
+    STAGE_CACHE_NONE = 0,           /* Not cacheable, or the change signal could not be read */
+    STAGE_CACHE_MISS,               /* Spawned, a successful result is stored under 'cache_token' */
+    STAGE_CACHE_HIT                 /* Served from the result cache, no process ran */
+} stage_cache_e;
+
+struct sched_stage_s {
+    /* Filled by the caller */
+    int mod_id;
+    uint32_t deps;                  /* STAGE_BIT() of every stage that must be done before this one starts */
+    const char* arg;
+    size_t arg_len;                 /* Size of a binary (TLV) 'arg', 0 if it is a C string */
+    char* out_buf;
+    size_t out_size;
+    size_t out_len;                 /* Set by the scheduler: bytes of the result in 'out_buf' */
+    ipc_blob_t blob;                /* Mapped memfd result, valid during 'complete' only */
+    stage_prepare_fn prepare;
+    stage_complete_fn complete;
+    int always;                     /* Still runs once the run deadline cancelled the others */
+
+    /* Owned by the scheduler */
+    stage_state_e state;
+    ProjectStatus status;
+    pid_t pid;
+    int pidfd;                      /* -1 if the kernel has no pidfd support, reaping is synchronous then */
+    int fd;
+    int pooled;                     /* Served by a worker_pool_t worker instead of a fresh fork */
+    int domain;                     /* Served by the run's process for its security domain, -1 if not fused */
+    int killed;                     /* SIGKILL already sent while exiting */
+    int attempt;                    /* Retries used so far, see module_config_t.retries */
+    int cut_short;                  /* Deadline set by the run budget rather than the module's timeout */
+    int cancelling;                 /* SIGTERM sent at that deadline, SIGKILL after the grace period */
+    uint64_t deadline_ms;
+
+    /* Phase timestamps (CLOCK_MONOTONIC ns), 0 when the phase was never reached */
+    uint64_t t_start_ns;
+    uint64_t t_response_ns;
+    ipc_timing_t timing;            /* Module side, from the response header */
+
+    /* Resource usage of the module process, from wait4(). Not valid for pooled stages */
+    process_usage_t usage;
+
+    stage_cache_e cache;
+    uint64_t cache_token;           /* Change signal read before the module ran */
+};
+
+/* CLOCK_MONOTONIC in ms: the time base of daemon_context_t.deadline_ms */
+uint64_t sched_clock_ms(void);
+
+/**
+ * Runs every stage once, respecting 'deps'. Stages whose dependencies are done are started
+ * right away and served concurrently from a single poll loop, which also reaps children
+ * through their pidfds.
+ * A failed stage still counts as done: dependencies express ordering, not success.
+ * A stage that timed out or crashed is re-run (including 'prepare') up to its module's 'retries',
+ * as long as the run deadline has not passed.
+ * If ctx->deadline_ms is set, stages not flagged 'always' are cancelled (STATUS_ERR_CANCELLED) once
+ * what is left of the run is needed by the 'always' ones, and ctx->partial is set. 'always' stages
+ * still running at ctx->deadline_ms are cancelled the same way.
+ * Per-stage results are stored in 'status'. Returns STATUS_ERR_INVALID_ARG if the graph itself is
+ * invalid, STATUS_ERR_MODULE_FAIL if a stage of a 'critical' module failed.
+ * If 'pool' is not NULL, stages are dispatched to its warm workers when one is idle.
+ * Otherwise, with CONFIG_STAGE_FUSION, stages of modules sharing a security domain share one
+ * process for the whole run: it serves them one at a time, a ready stage waits while it is busy.
+ * If ctx->results is set, stages of modules with a cache policy are served from it when fresh.
+ */
+ProjectStatus sched_run(sched_stage_t* stages, size_t count, daemon_context_t* ctx, worker_pool_t* pool);
+
+#endif // SCHEDULER_H
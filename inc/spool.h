@@ -0,0 +1,67 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+/*
+ * Crash-safe upload spool: a fixed-size, mmap'd ring of checksummed records. Upload records the
+ * Sender could not deliver are queued here and re-sent by later runs, oldest first, many per Sender
+ * invocation.
+ *
+ * Records are never moved. Each carries its sequence number and a CRC32, so on open the ring is
+ * walked from the persisted head and stops at the first record that is torn, stale (from an older
+ * lap) or out of sequence. The head lives in two alternating header slots: a torn header write
+ * falls back to the previous one. Delivery is at-least-once: a crash between an upload and the
+ * next header sync re-sends those records.
+ * When full, the oldest records are dropped: the spool never grows past SPOOL_CAPACITY.
+ */
+#define SPOOL_PATH          "/data/local/tmp/upload.spool"
+#define SPOOL_CAPACITY      (256 * 1024)    /* Bytes of records, headers included */
+#define SPOOL_RECORD_MAX    1024            /* Largest record payload */
+#define SPOOL_SYNC_RECORDS  16              /* Appends between two msync()s, see spool_sync() */
+
+typedef struct spool_s {
+    int fd;
+    uint8_t* map;
+    size_t map_size;
+    uint8_t* data;                  /* Ring, SPOOL_CAPACITY bytes after the header slots */
+
+    uint32_t head_off;              /* Oldest record */
+    uint64_t head_seq;
+    uint32_t tail_off;              /* Where the next record goes */
+    uint64_t tail_seq;
+    uint32_t count;
+
+    uint32_t gen;                   /* Generation of the last header written */
+    int header_dirty;               /* Head moved since the header was last synced */
+    uint32_t unsynced;              /* Appends since the last sync */
+} spool_t;
+
+typedef struct spool_iter_s {
+    uint32_t off;
+    uint64_t seq;
+    uint32_t left;
+} spool_iter_t;
+
+/* Maps the spool at 'path', creating it if needed. An unreadable spool is started over empty */
+ProjectStatus spool_open(spool_t* spool, const char* path);
+
+/* Syncs and unmaps */
+void spool_close(spool_t* spool);
+
+/* Queues a record, dropping the oldest ones if there is no room. Synced every SPOOL_SYNC_RECORDS */
+ProjectStatus spool_append(spool_t* spool, const void* data, size_t len);
+
+/* Drops the 'n' oldest records, e.g. once they were delivered */
+void spool_consume(spool_t* spool, uint32_t n);
+
+/* Writes back the header and every record appended since the last sync */
+ProjectStatus spool_sync(spool_t* spool);
+
+/* Walks the queued records, oldest first, without consuming them. Pointers are into the mapping */
+void spool_iter_init(const spool_t* spool, spool_iter_t* it);
+int spool_iter_next(const spool_t* spool, spool_iter_t* it, const void** data, size_t* len);
+
+#endif // SPOOL_H
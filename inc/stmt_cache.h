@@ -0,0 +1,42 @@
+#ifndef STMT_CACHE_H
+#define STMT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "sal.h"
+
+#define STMT_CACHE_SLOTS    8   /* Statements kept compiled per connection, least recently used is evicted */
+
+typedef struct stmt_cache_entry_s {
+    const char* sql;            /* Not copied: callers pass string literals */
+    sqlite3_stmt* stmt;
+    uint32_t last_used;
+} stmt_cache_entry_t;
+
+/*
+ * Compiled statements of one connection, so loops re-bind and re-step instead of re-parsing
+ * and re-planning the same SQL. Not thread-safe, like the connection it belongs to.
+ */
+typedef struct stmt_cache_s {
+    sqlite3* db;
+    size_t count;
+    uint32_t clock;
+    stmt_cache_entry_t entries[STMT_CACHE_SLOTS];
+} stmt_cache_t;
+
+void stmt_cache_init(stmt_cache_t* cache, sqlite3* db);
+
+/**
+ * Returns the compiled statement for 'sql', reset and with its bindings cleared,
+ * or NULL if it does not compile. The statement stays owned by the cache.
+ */
+sqlite3_stmt* stmt_cache_get(stmt_cache_t* cache, const char* sql);
+
+/* Steps a statement that returns no rows (DML, BEGIN/COMMIT) and resets it */
+ProjectStatus stmt_cache_exec(sqlite3_stmt* stmt);
+
+/* Finalizes every statement. Must run before the connection is closed */
+void stmt_cache_destroy(stmt_cache_t* cache);
+
+#endif // STMT_CACHE_H
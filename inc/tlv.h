@@ -0,0 +1,88 @@
+#ifndef TLV_H
+#define TLV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+/*
+ * Compact typed encoding for module results and stage arguments. A field is a varint key
+ * (tag << 2 | type) followed by its value:
+ *   TLV_UINT    varint
+ *   TLV_SINT    zigzag varint
+ *   TLV_BYTES   varint length, then the bytes (no terminator)
+ *   TLV_RECORD  varint length, then the nested fields
+ * A record's length is reserved as a fixed 2-byte varint when it is opened and filled in when it
+ * is closed, so the builder never moves what it already wrote. Unknown tags are skipped by readers.
+ */
+#define TLV_MAX_DEPTH       4
+#define TLV_RECORD_MAX      0x3FFF      /* Largest record body: what a 2-byte varint holds */
+#define TLV_TAG_MAX         0x3FFFFFFF
+
+typedef enum tlv_type_s {
+    TLV_UINT = 0,
+    TLV_SINT,
+    TLV_BYTES,
+    TLV_RECORD
+} tlv_type_e;
+
+typedef struct tlv_writer_s {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    int overflow;                   /* Sticky: a field did not fit, or records were misnested */
+    int depth;
+    size_t open[TLV_MAX_DEPTH];     /* Offset of the reserved length of every open record */
+} tlv_writer_t;
+
+typedef struct tlv_reader_s {
+    const uint8_t* p;
+    const uint8_t* end;
+} tlv_reader_t;
+
+typedef struct tlv_field_s {
+    uint32_t tag;
+    tlv_type_e type;
+    uint64_t u;                     /* TLV_UINT */
+    int64_t i;                      /* TLV_SINT */
+    const uint8_t* data;            /* TLV_BYTES, TLV_RECORD: points into the decoded buffer */
+    size_t len;
+} tlv_field_t;
+
+/* Builder. Puts never fail on their own: check tlv_finish() once at the end */
+void tlv_writer_init(tlv_writer_t* w, void* buf, size_t cap);
+void tlv_put_uint(tlv_writer_t* w, uint32_t tag, uint64_t value);
+void tlv_put_sint(tlv_writer_t* w, uint32_t tag, int64_t value);
+void tlv_put_bytes(tlv_writer_t* w, uint32_t tag, const void* data, size_t len);
+void tlv_put_str(tlv_writer_t* w, uint32_t tag, const char* str);
+void tlv_begin_record(tlv_writer_t* w, uint32_t tag);
+void tlv_end_record(tlv_writer_t* w);
+
+/* Appends bytes that are already encoded fields, e.g. a record kept from an earlier run */
+void tlv_put_raw(tlv_writer_t* w, const void* data, size_t len);
+
+/* Re-encodes a field returned by tlv_next(), e.g. to copy it from one buffer into another */
+void tlv_put_field(tlv_writer_t* w, const tlv_field_t* field);
+
+/* Encoded size in 'len'. STATUS_ERR_INVALID_ARG if something did not fit or a record is still open */
+ProjectStatus tlv_finish(const tlv_writer_t* w, size_t* len);
+
+/* Reader. Fields point into the buffer, nothing is copied */
+void tlv_reader_init(tlv_reader_t* r, const void* data, size_t len);
+
+/* 1 and the next field in 'field', 0 at the end, -1 if the buffer is malformed or truncated */
+int tlv_next(tlv_reader_t* r, tlv_field_t* field);
+
+/* Reader over the fields of a TLV_RECORD field */
+void tlv_open_record(const tlv_field_t* field, tlv_reader_t* r);
+
+/* First top-level field with 'tag'. Returns 1 if found */
+int tlv_find(const void* data, size_t len, uint32_t tag, tlv_field_t* field);
+
+/* Copies a TLV_BYTES field as a C string, truncated to 'size' - 1. Returns the bytes copied */
+size_t tlv_copy_str(const tlv_field_t* field, char* out, size_t size);
+
+/* Encoded size of the first field of 'data' (key, length and value), 0 if it is not complete in 'max' */
+size_t tlv_field_size(const void* data, size_t max);
+
+#endif // TLV_H
@@ -0,0 +1,134 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Deferred-formatting trace. A call site only stores its site ID, a timestamp and its raw
+ * arguments in a per-process ring; the format string is applied offline by tools/trace_decode.
+ * Sites below CONFIG_TRACE_LEVEL compile to nothing.
+ */
+#define TRACE_LEVEL_DEBUG   0
+#define TRACE_LEVEL_INFO    1
+#define TRACE_LEVEL_ERROR   2
+#define TRACE_LEVEL_OFF     3
+
+#ifndef CONFIG_TRACE_LEVEL
+#define CONFIG_TRACE_LEVEL  TRACE_LEVEL_INFO
+#endif
+
+#define TRACE_RING_EVENTS   4096                    /* Per process, power of two. Oldest events are overwritten */
+#define TRACE_MAX_ARGS      4
+#define TRACE_STR_INLINE    16                      /* Bytes of the first %s argument kept in the event */
+#define TRACE_DUMP_DIR      "/data/local/tmp/trace"
+#define TRACE_DUMP_MAGIC    0x54524143u             /* "TRAC" */
+#define TRACE_DUMP_VERSION  1
+
+/*
+ * Static description of one call site. The linker collects a pointer to each site into the
+ * "trace_sites" section; a site's ID is the index of that pointer. Pointers rather than the sites
+ * themselves, because compilers are free to over-align larger objects and break the stride.
+ */
+typedef struct trace_site_s {
+    const char* fmt;
+    const char* file;
+    uint32_t line;
+    uint8_t level;
+    uint8_t nargs;
+    uint16_t reserved;
+} trace_site_t;
+
+/* One record in the ring: a cache line */
+typedef struct trace_event_s {
+    uint64_t ticks;                     /* Raw CPU counter, see the calibration in the dump header */
+    uint32_t seq;                       /* Low bits of the ring position, written last */
+    uint16_t site_id;                   /* Index into the trace_sites section */
+    uint8_t nargs;
+    uint8_t str_len;                    /* Bytes in 'str' + 1, 0 if no %s argument was captured */
+    uint64_t args[TRACE_MAX_ARGS];      /* Integers widened, doubles as bits, strings as pointers */
+    char str[TRACE_STR_INLINE];
+} trace_event_t;
+
+_Static_assert(sizeof(trace_event_t) == 64, "trace_event_t must stay one cache line");
+
+/* Dump file: header, then 'site_count' site records, then 'event_count' events, oldest first */
+typedef struct trace_dump_header_s {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t event_size;
+    int32_t pid;
+    uint32_t site_count;
+    uint32_t event_count;
+    uint32_t lost;                      /* Events overwritten before the dump */
+    uint64_t mono_to_real_ns;           /* Add to a CLOCK_MONOTONIC time to get wall clock time */
+    uint64_t base_ticks;                /* Two (ticks, CLOCK_MONOTONIC ns) pairs, to convert event ticks */
+    uint64_t base_ns;
+    uint64_t dump_ticks;
+    uint64_t dump_ns;
+} trace_dump_header_t;
+
+/* Followed by 'fmt_len' + 'file_len' bytes, no terminators */
+typedef struct trace_dump_site_s {
+    uint32_t line;
+    uint8_t level;
+    uint8_t nargs;
+    uint16_t fmt_len;
+    uint16_t file_len;
+    uint16_t reserved;
+} trace_dump_site_t;
+
+/* Claims the next slot. Lock-free: a single atomic increment */
+trace_event_t* trace_begin(const trace_site_t* const* site_ref);
+
+/* Publishes the event filled since trace_begin() */
+void trace_commit(trace_event_t* ev);
+
+/* Called in a freshly forked child, so its dump doesn't repeat the parent's events */
+void trace_reset(void);
+
+/* Writes the ring to TRACE_DUMP_DIR/trace.<pid>. Returns 0 on success */
+int trace_dump(void);
+
+/* Same, but only if an event at 'min_level' or above was recorded. Keeps healthy children from dumping */
+int trace_dump_if(int min_level);
+
+/* Argument capture, picked by the static type of each argument */
+void trace_put_u64(trace_event_t* ev, int idx, uint64_t value);
+void trace_put_f64(trace_event_t* ev, int idx, double value);
+void trace_put_ptr(trace_event_t* ev, int idx, const void* value);
+void trace_put_str(trace_event_t* ev, int idx, const char* value);
+
+#define TRACE_PUT(ev, idx, x) \
+    _Generic((x), \
+        char*: trace_put_str, const char*: trace_put_str, \
+        void*: trace_put_ptr, const void*: trace_put_ptr, \
+        float: trace_put_f64, double: trace_put_f64, \
+        default: trace_put_u64)((ev), (idx), (x))
+
+/* More than TRACE_MAX_ARGS arguments fails to build on the undefined TRACE_ARGS_TOO_MANY */
+#define TRACE_NARGS(...)        TRACE_NARGS_(_, ##__VA_ARGS__, TOO_MANY, TOO_MANY, TOO_MANY, TOO_MANY, 4, 3, 2, 1, 0)
+#define TRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define TRACE_ARGS_0(ev)
+#define TRACE_ARGS_1(ev, a)             TRACE_PUT(ev, 0, a)
+#define TRACE_ARGS_2(ev, a, b)          TRACE_ARGS_1(ev, a); TRACE_PUT(ev, 1, b)
+#define TRACE_ARGS_3(ev, a, b, c)       TRACE_ARGS_2(ev, a, b); TRACE_PUT(ev, 2, c)
+#define TRACE_ARGS_4(ev, a, b, c, d)    TRACE_ARGS_3(ev, a, b, c); TRACE_PUT(ev, 3, d)
+#define TRACE_ARGS_N(n)                 TRACE_ARGS_N_(n)
+#define TRACE_ARGS_N_(n)                TRACE_ARGS_##n
+
+#define TRACE(lvl, fmt, ...) \
+    do { \
+        if ((lvl) >= CONFIG_TRACE_LEVEL) { \
+            static const trace_site_t trace_site_ = \
+                { fmt, __FILE__, __LINE__, (lvl), TRACE_NARGS(__VA_ARGS__), 0 }; \
+            static const trace_site_t* trace_site_ref_ \
+                __attribute__((section("trace_sites"), used, aligned(sizeof(void*)))) = &trace_site_; \
+            trace_event_t* trace_ev_ = trace_begin(&trace_site_ref_); \
+            TRACE_ARGS_N(TRACE_NARGS(__VA_ARGS__))(trace_ev_, ##__VA_ARGS__); \
+            trace_commit(trace_ev_); \
+        } \
+    } while (0)
+
+#endif // TRACE_H
@@ -0,0 +1,71 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "ipc.h"
+#include "spool.h"
+#include "tlv.h"
+
+/*
+ * Upload wire format. The Sender turns a batch of UPLOAD records into one frame and sends it as a
+ * single payload.
+ *
+ * The frame is TLV: BASE_VERSION, FULL if the server must start from an empty state, then one
+ * DELTA record per UPLOAD record. A DELTA holds only the fields that differ from the previous
+ * record (for the first one, from the daemon's BASELINE). Fields that were dropped are listed in
+ * its CLEARED mask.
+ * Frames of UPLOAD_LZ_MIN bytes or more are LZ-compressed if that makes them smaller. The result
+ * is base64'd: payloads travel as C strings.
+ *
+ * The server keeps its own copy of the state and a version, the number of records it applied.
+ * It answers UPLOAD_RESYNC_REPLY when a delta frame's BASE_VERSION is not its version, e.g. after
+ * it lost its state or the daemon crashed before recording an acknowledgement. The Sender then
+ * sends the same batch with FULL set. After a frame, both sides are at BASE_VERSION + records,
+ * and the server acknowledges it with "OK <version>". Any other reply is a failed upload.
+ */
+#define UPLOAD_STATE_PATH   "/data/local/tmp/upload.acked"
+#define UPLOAD_FRAME_MAX    IPC_REQUEST_ARG_MAX                         /* Binary frame, before base64 */
+#define UPLOAD_TEXT_MAX     (((UPLOAD_FRAME_MAX + 3 + 2) / 3) * 4 + 1)  /* Header, base64, terminator */
+#define UPLOAD_LZ_MIN       64
+#define UPLOAD_RESYNC_REPLY "RESYNC"
+#define UPLOAD_ACK_REPLY    "OK"            /* Followed by a space and the server's new version */
+
+/* First byte of a frame. With UPLOAD_FRAME_LZ, a 2-byte little-endian raw length follows */
+#define UPLOAD_FRAME_LZ     0x01
+
+/* What the server acknowledged last. The daemon keeps it in UPLOAD_STATE_PATH */
+typedef struct upload_state_s {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t acked;                         /* Records applied since the last full upload + its base */
+    uint32_t len;
+    uint8_t fields[SPOOL_RECORD_MAX];       /* Fields of the last UPLOAD record applied, 'len' bytes */
+} upload_state_t;
+
+/* Loads the acknowledged state, or starts empty (the first upload is then full) */
+void upload_state_load(upload_state_t* state, const char* path);
+ProjectStatus upload_state_save(const upload_state_t* state, const char* path);
+
+/*
+ * Sender side: the frame for the UPLOAD records of a BATCH record, as a NUL-terminated string.
+ * 'full' ignores the batch's BASELINE. 'records' is the number of UPLOAD records in the frame,
+ * 'version' the one the server acknowledges it with.
+ */
+ProjectStatus upload_encode_frame(const tlv_field_t* batch, int full, char* text, size_t size, uint32_t* records,
+                                  uint64_t* version);
+
+/* Sender side: non-zero if 'reply' is the server's acknowledgement of 'version' */
+int upload_reply_acked(const char* reply, uint64_t version);
+
+/* Server side: the frame's TLV fields back from its text */
+ProjectStatus upload_decode_frame(const char* text, uint8_t* out, size_t cap, size_t* len);
+
+/*
+ * Server side: applies one DELTA record to the fields of 'state'. 'state->acked' is left to the
+ * caller.
+ */
+ProjectStatus upload_apply_delta(upload_state_t* state, const tlv_field_t* delta);
+
+#endif // UPLOAD_H
@@ -0,0 +1,43 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "common.h"
+
+typedef struct pool_worker_s {
+    pid_t pid;          /* -1 when the slot has no live worker */
+    int fd;
+    uint32_t served;    /* Requests served since the worker was forked */
+    int busy;
+} pool_worker_t;
+
+typedef struct worker_pool_s {
+    pool_worker_t workers[MODULE_COUNT];
+    uint32_t max_requests;
+} worker_pool_t;
+
+/**
+ * Pre-forks one already-credentialed worker per registered module.
+ * Workers are recycled after 'max_requests' requests, or as soon as a request fails.
+ */
+ProjectStatus pool_init(worker_pool_t* pool, uint32_t max_requests);
+
+/**
+ * Hands 'arg' ('arg_len' bytes if binary, see ipc_send_request()) to the module's warm worker. On success 'out_fd' is the channel the response
+ * will arrive on, and the worker is busy until pool_release().
+ * Fails if the module has no idle worker, in which case the caller should fork as usual.
+ */
+ProjectStatus pool_dispatch(worker_pool_t* pool, int mod_id, const char* arg, size_t arg_len, int* out_fd);
+
+/**
+ * Returns the worker to the pool. A worker that failed ('healthy' == 0) or reached its
+ * request budget is replaced by a fresh one.
+ */
+void pool_release(worker_pool_t* pool, int mod_id, int healthy);
+
+/* Stops and reaps every worker */
+void pool_destroy(worker_pool_t* pool);
+
+#endif // WORKER_POOL_H
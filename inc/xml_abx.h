@@ -0,0 +1,29 @@
+#ifndef XML_ABX_H
+#define XML_ABX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "xml_utils.h"
+
+/*
+ * Reader for Android Binary XML ("ABX"), the format newer Android releases use for settings
+ * and shared prefs. Documents are walked token by token straight from the mapping: strings
+ * are referenced in place (interned ones through the string table) and typed attributes
+ * (int/long/float/double/boolean) are decoded from their binary form, never from text.
+ */
+#define ABX_MAGIC_SIZE  4
+
+/* Returns non-zero if 'data' starts with the ABX magic */
+int xml_is_abx(const void* data, size_t size);
+
+/**
+ * Same contract as xml_for_each_entry(), over an ABX document held in memory.
+ * Typed values come with their binary form in 'raw' only, see xml_entry_t.
+ */
+ProjectStatus abx_for_each_entry(const uint8_t* data, size_t size, xml_entry_fn fn, void* user);
+
+/* Renders a typed value the way the text serializer would have written it */
+size_t xml_format_value(xml_value_type_e type, uint64_t raw, char* out_buf, size_t max_len);
+
+#endif // XML_ABX_H
@@ -0,0 +1,61 @@
+#ifndef XML_INDEX_H
+#define XML_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "common.h"
+
+/*
+ * Parsed index of a shared prefs file: key -> value offset table.
+ * An index is bound to the file identity it was built from (dev/inode/size/mtime), so any
+ * rewrite of the file invalidates it. Indexes are cached in memory and persisted under
+ * XML_INDEX_CACHE_DIR, which lets short lived module children reuse them across daemon runs.
+ */
+#define XML_INDEX_CACHE_DIR     "/data/local/tmp/xml_index"
+#define XML_INDEX_CACHE_SLOTS   4
+
+typedef struct xml_index_entry_s {
+    uint32_t hash;          /* Hash of the key, entries are sorted by it */
+    uint32_t name_off;      /* Offset of the key in the index name table */
+    uint32_t name_len;
+    uint32_t value_len;
+    uint64_t value_off;     /* Offset of the value in the XML file, or the raw bits of a typed value */
+    uint32_t type;          /* xml_value_type_e */
+    uint32_t reserved;
+} xml_index_entry_t;
+
+typedef struct xml_index_s {
+    /* Identity of the indexed file */
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+
+    uint32_t count;
+    uint32_t names_len;
+    xml_index_entry_t* entries;
+    char* names;
+} xml_index_t;
+
+/**
+ * Returns the index of the open file 'fd' (stat'ed into 'st'), from memory, from disk, or by
+ * parsing the file once. The index is owned by the cache. Returns NULL if it can't be built.
+ */
+const xml_index_t* xml_index_get(const char* file_path, int fd, const struct stat* st);
+
+/* First entry (in document order) for 'key', or NULL */
+const xml_index_entry_t* xml_index_find(const xml_index_t* idx, const char* key, size_t key_len);
+
+/* Builds a fresh index out of the open file 'fd' */
+xml_index_t* xml_index_build(int fd, const struct stat* st);
+
+ProjectStatus xml_index_save(const xml_index_t* idx, const char* cache_path);
+ProjectStatus xml_index_load(const char* cache_path, xml_index_t** out_idx);
+void xml_index_free(xml_index_t* idx);
+
+/* Drops every in-memory index */
+void xml_index_cache_clear(void);
+
+#endif // XML_INDEX_H
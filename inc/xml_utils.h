@@ -2,12 +2,66 @@
 #define XML_UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include "common.h"
 
 /**
  * Reads an XML file and extracts the value for a specific key.
  * This is not a robust parser! It's used for simple shared pref files.
- * Assumptions: file must not be larger than 16KB.
+ * The file is mapped and scanned in a single pass (streamed in 64KB windows if it can't be mapped),
+ * so there is no size limit. A single tag must fit in 64KB when streaming.
+ * Repeated lookups on an unchanged file are served from a cached index, see xml_index.h.
+ * Android Binary XML files are detected by their magic and read directly, see xml_abx.h.
  */
 ProjectStatus xml_get_value(const char* file_path, const char* key, char* out_buf, size_t max_len);
 
-#endif // XML_UTILS_H
\ No newline at end of file
+/* One key of a batch lookup. 'status' is STATUS_SUCCESS once the key was found */
+typedef struct xml_query_s {
+    const char* key;
+    char* out_buf;
+    size_t max_len;
+    ProjectStatus status;
+} xml_query_t;
+
+/**
+ * Resolves every query with a single pass over the file (or none, if its index is cached).
+ * Returns an error only if the file itself could not be read; per-key results are in 'status'.
+ */
+ProjectStatus xml_get_values(const char* file_path, xml_query_t* queries, size_t count);
+
+/* --- Low level scanning, used to build indexes --- */
+
+/* A view into the document. Nothing is copied until a value is written out. */
+typedef struct xml_span_s {
+    const char* ptr;
+    size_t len;
+} xml_span_t;
+
+/* How a value is stored in the file. Only ABX documents carry typed values */
+typedef enum xml_value_type_s {
+    XML_VALUE_TEXT = 0,
+    XML_VALUE_INT,
+    XML_VALUE_INT_HEX,
+    XML_VALUE_LONG,
+    XML_VALUE_LONG_HEX,
+    XML_VALUE_FLOAT,
+    XML_VALUE_DOUBLE,
+    XML_VALUE_BOOL
+} xml_value_type_e;
+
+typedef struct xml_entry_s {
+    xml_span_t name;
+    xml_span_t value;           /* ptr is NULL if the element has neither a value attribute nor text */
+    uint64_t name_offset;       /* File offsets of the spans above (text values only) */
+    uint64_t value_offset;
+    xml_value_type_e type;
+    uint64_t raw;               /* Typed values: the binary value, 'value' is empty. See xml_format_value() */
+} xml_entry_t;
+
+/* Called for every element that has a name attribute. Return non-zero to stop the scan. */
+typedef int (*xml_entry_fn)(void* user, const xml_entry_t* entry);
+
+/* Single pass over every entry of the open file 'fd' of 'size' bytes */
+ProjectStatus xml_for_each_entry(int fd, size_t size, xml_entry_fn fn, void* user);
+
+#endif // XML_UTILS_H
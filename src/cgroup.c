@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "cgroup.h"
+
+static ProjectStatus cgroup_write(const char* dir, const char* file, const char* value)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    size_t len = strlen(value);
+    ssize_t written;
+    do {
+        written = write(fd, value, len);
+    } while (written < 0 && errno == EINTR);
+    close(fd);
+    return (written == (ssize_t)len) ? STATUS_SUCCESS : STATUS_ERR_GENERIC;
+}
+
+static int cgroup_mkdir(const char* path)
+{
+    return (mkdir(path, 0755) == 0 || errno == EEXIST) ? 0 : -1;
+}
+
+ProjectStatus cgroup_prepare(const char* name, const module_cgroup_t* limits)
+{
+    /* The limits are static, so once the leaf is set up it stays valid for the rest of the run */
+    static const module_cgroup_t* prepared[MODULE_COUNT];
+    static size_t prepared_count;
+    char dir[256];
+    char value[32];
+    ProjectStatus status = STATUS_SUCCESS;
+
+    if (name == NULL || limits == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < prepared_count; i++) {
+        if (prepared[i] == limits) {
+            return STATUS_SUCCESS;
+        }
+    }
+
+    if (cgroup_mkdir(CGROUP_ROOT) < 0) {
+        ERROR("cgroup: cannot create %s (errno %d)", CGROUP_ROOT, errno);
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    /* Controllers must be enabled on the parent before the leaf exposes their files */
+    if (cgroup_write(CGROUP_ROOT, "cgroup.subtree_control", "+cpu +memory +io") != STATUS_SUCCESS) {
+        ERROR("cgroup: cannot enable controllers under %s (errno %d)", CGROUP_ROOT, errno);
+    }
+
+    snprintf(dir, sizeof(dir), "%s/%s", CGROUP_ROOT, name);
+    if (cgroup_mkdir(dir) < 0) {
+        ERROR("cgroup: cannot create %s (errno %d)", dir, errno);
+        return STATUS_ERR_OPEN_ERROR;
+    }
+
+    if (limits->cpu_weight != 0) {
+        snprintf(value, sizeof(value), "%u", limits->cpu_weight);
+        if (cgroup_write(dir, "cpu.weight", value) != STATUS_SUCCESS) status = STATUS_ERR_GENERIC;
+    }
+    if (limits->memory_max != 0) {
+        snprintf(value, sizeof(value), "%llu", (unsigned long long)limits->memory_max);
+        if (cgroup_write(dir, "memory.max", value) != STATUS_SUCCESS) status = STATUS_ERR_GENERIC;
+    }
+    if (limits->io_weight != 0) {
+        snprintf(value, sizeof(value), "default %u", limits->io_weight);
+        if (cgroup_write(dir, "io.weight", value) != STATUS_SUCCESS) status = STATUS_ERR_GENERIC;
+    }
+    if (status != STATUS_SUCCESS) {
+        ERROR("cgroup: some limits of %s were not applied", name);
+    }
+
+    if (prepared_count < MODULE_COUNT) {
+        prepared[prepared_count++] = limits;
+    }
+    return status;
+}
+
+ProjectStatus cgroup_enter(const char* name)
+{
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s/%s", CGROUP_ROOT, name);
+    /* "0" means the writing process itself */
+    return cgroup_write(dir, "cgroup.procs", "0");
+}
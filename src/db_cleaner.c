@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "db_cleaner.h"
+#include "stmt_cache.h"
+#include "process.h"
+#include "file_utils.h"
+#include "symbol_resolver.h"
+
+/* What gets cleaned. The predicate must be idempotent: a chunk interrupted mid-way is simply redone */
+#define DB_CLEAN_TABLE      "..."
+#define DB_CLEAN_PREDICATE  "...='...'"
+
+#define DB_STATE_MAGIC      0x434C4E52u     /* "CLNR" */
+#define AUTO_VACUUM_INCREMENTAL 2
+#define DB_CLEAN_BUSY_MS    100
+
+#define DB_STR_(x)  #x
+#define DB_STR(x)   DB_STR_(x)
+
+typedef enum db_vacuum_mode_s {
+    DB_VACUUM_NEVER = 0,    /* Not incremental and too large to migrate: free pages are only reused */
+    DB_VACUUM_READY,        /* auto_vacuum=INCREMENTAL */
+    DB_VACUUM_LATER         /* The migration does not fit this run's budget */
+} db_vacuum_mode_e;
+
+typedef enum db_clean_phase_s {
+    DB_PHASE_DELETE = 0,    /* Stale rows may remain */
+    DB_PHASE_RECLAIM,       /* Rows gone, free pages may remain */
+    DB_PHASE_IDLE           /* Fully clean, only new rows need deleting */
+} db_clean_phase_e;
+
+/* Persisted between runs */
+typedef struct db_clean_state_s {
+    uint32_t magic;
+    uint32_t phase;
+    int64_t rows_deleted_total;
+    int64_t pages_freed_total;
+    int64_t runs;
+} db_clean_state_t;
+
+static uint64_t db_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint64_t db_left_ms(uint64_t deadline)
+{
+    uint64_t now = db_now_ms();
+    return (now < deadline) ? deadline - now : 0;
+}
+
+/* Estimated time to write 'bytes', plus one wait on another connection's lock */
+static uint64_t db_write_cost_ms(long long bytes)
+{
+    return (uint64_t)bytes / DB_CLEAN_WRITE_BYTES_PER_MS + DB_CLEAN_BUSY_MS;
+}
+
+static void db_load_state(const char* path, db_clean_state_t* state)
+{
+    memset(state, 0, sizeof(*state));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (read(fd, state, sizeof(*state)) != (ssize_t)sizeof(*state) || state->magic != DB_STATE_MAGIC
+        || state->phase > DB_PHASE_IDLE) {
+        memset(state, 0, sizeof(*state));
+    }
+    close(fd);
+}
+
+static int db_exec(sqlite3* db, const char* sql)
+{
+    char* err_msg = NULL;
+    int rc = sal_sqlite_exec(db, sql, &err_msg);
+    if (err_msg != NULL) {
+        sal_sqlite_free(err_msg);
+    }
+    return rc;
+}
+
+/*
+ * auto_vacuum=INCREMENTAL only takes effect after one full VACUUM. That is done once, and only
+ * while the DB is small enough for it to be cheap. Larger DBs keep reusing their free pages.
+ * VACUUM can't be interrupted, so it waits for a run with enough budget left.
+ */
+static db_vacuum_mode_e db_ensure_incremental(sqlite3* db, uint64_t deadline)
+{
+    long long mode = 0, pages = 0, page_size = 0;
+    if (sal_sqlite_query_int(db, "PRAGMA auto_vacuum;", &mode) != SQLITE_OK) {
+        return DB_VACUUM_NEVER;
+    }
+    if (mode == AUTO_VACUUM_INCREMENTAL) {
+        return DB_VACUUM_READY;
+    }
+    if (sal_sqlite_query_int(db, "PRAGMA page_count;", &pages) != SQLITE_OK
+        || sal_sqlite_query_int(db, "PRAGMA page_size;", &page_size) != SQLITE_OK
+        || pages * page_size > DB_CLEAN_MIGRATE_MAX_BYTES) {
+        return DB_VACUUM_NEVER;
+    }
+    /* The whole DB is written twice: into a temporary copy, then back */
+    if (db_write_cost_ms(2 * pages * page_size) > db_left_ms(deadline)) {
+        return DB_VACUUM_LATER;
+    }
+    if (db_exec(db, "PRAGMA auto_vacuum=INCREMENTAL;") != SQLITE_OK || db_exec(db, "VACUUM;") != SQLITE_OK) {
+        return DB_VACUUM_NEVER;
+    }
+    return DB_VACUUM_READY;
+}
+
+/* Deletes chunk after chunk until nothing is left or the next chunk would not fit the budget */
+static ProjectStatus db_delete_chunks(sqlite3* db, stmt_cache_t* cache, uint64_t deadline,
+                                      db_clean_report_t* report, int* done)
+{
+    static const char* delete_sql =
+        "DELETE FROM " DB_CLEAN_TABLE " WHERE rowid IN "
+        "(SELECT rowid FROM " DB_CLEAN_TABLE " WHERE " DB_CLEAN_PREDICATE " LIMIT ?1);";
+    uint64_t last_chunk_ms = 0;
+
+    *done = 0;
+    for (;;) {
+        uint64_t start = db_now_ms();
+        if (start + last_chunk_ms >= deadline || module_cancel_requested()) {
+            return STATUS_SUCCESS;
+        }
+
+        /* Compiled once, every further chunk only re-binds and re-steps */
+        sqlite3_stmt* del = stmt_cache_get(cache, delete_sql);
+        if (del == NULL || stmt_cache_exec(stmt_cache_get(cache, "BEGIN IMMEDIATE;")) != STATUS_SUCCESS) {
+            return STATUS_ERR_DB_EXEC;
+        }
+        sal_sqlite_bind_int64(del, 1, DB_CLEAN_CHUNK_ROWS);
+        if (stmt_cache_exec(del) != STATUS_SUCCESS) {
+            stmt_cache_exec(stmt_cache_get(cache, "ROLLBACK;"));
+            return STATUS_ERR_DB_EXEC;
+        }
+        long long changed = sal_sqlite_changes(db);
+        if (stmt_cache_exec(stmt_cache_get(cache, "COMMIT;")) != STATUS_SUCCESS) {
+            stmt_cache_exec(stmt_cache_get(cache, "ROLLBACK;"));
+            return STATUS_ERR_DB_EXEC;
+        }
+        report->rows_deleted += changed;
+        last_chunk_ms = db_now_ms() - start;
+
+        if (changed < DB_CLEAN_CHUNK_ROWS) {
+            *done = 1;
+            return STATUS_SUCCESS;
+        }
+    }
+}
+
+/* Releases free pages a few at a time. Returns 1 once the freelist is empty */
+static int db_reclaim_pages(stmt_cache_t* cache, uint64_t deadline, db_clean_report_t* report)
+{
+    static const char* vacuum_sql = "PRAGMA incremental_vacuum(" DB_STR(DB_CLEAN_VACUUM_PAGES) ");";
+
+    while (db_now_ms() < deadline && !module_cancel_requested()) {
+        sqlite3_stmt* count = stmt_cache_get(cache, "PRAGMA freelist_count;");
+        if (count == NULL || sal_sqlite_step(count) != SQLITE_ROW) {
+            return 0;
+        }
+        long long free_pages = sal_sqlite_column_int64(count, 0);
+        sal_sqlite_reset(count);
+        if (free_pages == 0) {
+            return 1;
+        }
+        if (stmt_cache_exec(stmt_cache_get(cache, vacuum_sql)) != STATUS_SUCCESS) {
+            return 0;
+        }
+        report->pages_freed += (free_pages < DB_CLEAN_VACUUM_PAGES) ? free_pages : DB_CLEAN_VACUUM_PAGES;
+    }
+    return 0;
+}
+
+/*
+ * Copies the WAL back into the DB and truncates it, if that fits in what is left of the budget.
+ * Returns 1 once the WAL is empty (or the DB is not in WAL mode).
+ */
+static int db_truncate_wal(stmt_cache_t* cache, uint64_t deadline)
+{
+    char wal_path[256];
+    struct stat st;
+
+    sqlite3_stmt* list = stmt_cache_get(cache, "PRAGMA database_list;");
+    if (list == NULL || sal_sqlite_step(list) != SQLITE_ROW) {
+        return 0;
+    }
+    const char* file = sal_sqlite_column_text(list, 2);
+    snprintf(wal_path, sizeof(wal_path), "%s-wal", (file != NULL) ? file : "");
+    sal_sqlite_reset(list);
+    if (file == NULL || stat(wal_path, &st) != 0 || st.st_size == 0) {
+        return 1;
+    }
+    if (db_write_cost_ms(st.st_size) > db_left_ms(deadline)) {
+        return 0;
+    }
+
+    /* One row: busy (a reader kept it from completing), frames in the log, frames checkpointed */
+    sqlite3_stmt* checkpoint = stmt_cache_get(cache, "PRAGMA wal_checkpoint(TRUNCATE);");
+    if (checkpoint == NULL || sal_sqlite_step(checkpoint) != SQLITE_ROW) {
+        if (checkpoint != NULL) sal_sqlite_reset(checkpoint);
+        return 0;
+    }
+    int done = (sal_sqlite_column_int64(checkpoint, 0) == 0);
+    sal_sqlite_reset(checkpoint);
+    return done;
+}
+
+ProjectStatus db_clean_run(sqlite3* db, const char* state_path, uint32_t budget_ms, db_clean_report_t* report)
+{
+    db_clean_state_t state;
+    stmt_cache_t cache;
+    ProjectStatus status = STATUS_SUCCESS;
+    int deleted_all = 0;
+    if (db == NULL || state_path == NULL || report == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    uint64_t deadline = db_now_ms() + budget_ms;
+    memset(report, 0, sizeof(*report));
+    db_load_state(state_path, &state);
+    state.magic = DB_STATE_MAGIC;
+    state.runs++;
+
+    /* Wait a little for other writers instead of failing the whole run on SQLITE_BUSY */
+    sal_sqlite_busy_timeout(db, DB_CLEAN_BUSY_MS);
+    stmt_cache_init(&cache, db);
+
+    /* Phase 1: delete in bounded chunks. New stale rows may show up at any time, so always look */
+    status = db_delete_chunks(db, &cache, deadline, report, &deleted_all);
+    if (status != STATUS_SUCCESS) {
+        goto out;
+    }
+    if (!deleted_all) {
+        state.phase = DB_PHASE_DELETE;
+        goto out;
+    }
+    if (report->rows_deleted > 0 || state.phase == DB_PHASE_DELETE) {
+        state.phase = DB_PHASE_RECLAIM;
+    }
+
+    /* Phase 2: give free pages back and shrink the WAL. Whatever does not fit is left to the next run */
+    if (state.phase == DB_PHASE_RECLAIM) {
+        db_vacuum_mode_e vacuum = db_ensure_incremental(db, deadline);
+        int reclaimed = (vacuum == DB_VACUUM_READY) ? db_reclaim_pages(&cache, deadline, report)
+                                                    : (vacuum == DB_VACUUM_NEVER);
+        if (db_truncate_wal(&cache, deadline) && reclaimed) {
+            state.phase = DB_PHASE_IDLE;
+        }
+    }
+
+out:
+    stmt_cache_destroy(&cache);
+    report->complete = (state.phase == DB_PHASE_IDLE);
+    state.rows_deleted_total += report->rows_deleted;
+    state.pages_freed_total += report->pages_freed;
+    write_file_atomic(state_path, &state, sizeof(state));
+    return status;
+}
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "file_utils.h"
+
+ProjectStatus write_file_atomic(const char* path, const void* data, size_t len)
+{
+    char tmp_path[256];
+    const char* p = data;
+
+    if (path == NULL || (data == NULL && len > 0)) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            unlink(tmp_path);
+            return STATUS_ERR_GENERIC;
+        }
+        p += written;
+        len -= (size_t)written;
+    }
+    /* Otherwise the rename may reach the disk before the data, and a crash leaves an empty file */
+    if (fsync(fd) < 0) {
+        close(fd);
+        unlink(tmp_path);
+        return STATUS_ERR_GENERIC;
+    }
+    close(fd);
+    if (rename(tmp_path, path) < 0) {
+        unlink(tmp_path);
+        return STATUS_ERR_GENERIC;
+    }
+    return STATUS_SUCCESS;
+}
@@ -1,22 +1,62 @@
+#define _GNU_SOURCE
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
 
 #include "ipc.h"
 
+/* Module-side phase timestamps, sent along with the next response */
+static ipc_timing_t g_timing;
+static int32_t g_mod_id = -1;
+
+static uint64_t ipc_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void ipc_mark(ipc_mark_e mark)
+{
+    uint64_t now = ipc_now_ns();
+    if (mark == IPC_MARK_START) {
+        g_timing.start_ns = now;
+    }
+    g_timing.ready_ns = now;
+}
+
+void ipc_set_module(int mod_id)
+{
+    g_mod_id = mod_id;
+}
+
+/* Copies at most PAYLOAD_MAX_SIZE - 1 bytes so the receiver can always NUL terminate */
+static void ipc_fill(ipc_response_t* resp, int code, const char* data)
+{
+    size_t len = 0;
+    resp->status_code = code;
+    resp->flags = 0;
+    if (data != NULL) {
+        len = strnlen(data, PAYLOAD_MAX_SIZE - 1);
+        memcpy(resp->payload, data, len);
+    }
+    resp->payload[len] = '\0';
+    resp->data_len = (uint32_t)len;
+}
+
 void ipc_set_error(ipc_response_t* resp, int code, const char* msg)
 {
     if (resp == NULL) {
         return;
     }
-    memset(resp, 0, sizeof(*resp));
-    resp->status_code = code;
-    if (msg != NULL) {
-        strncpy(resp->payload, msg, PAYLOAD_MAX_SIZE - 1);
-        resp->payload[PAYLOAD_MAX_SIZE - 1] = '\0';
-        resp->data_len = (int32_t)strlen(resp->payload);
-    }
+    ipc_fill(resp, code, msg);
 }
 
 void ipc_set_data(ipc_response_t* resp, const char* data)
@@ -24,26 +64,53 @@ void ipc_set_data(ipc_response_t* resp, const char* data)
     if (resp == NULL) {
         return;
     }
-    memset(resp, 0, sizeof(*resp));
-    resp->status_code = STATUS_SUCCESS;
-    if (data != NULL) {
-        strncpy(resp->payload, data, PAYLOAD_MAX_SIZE - 1);
-        resp->payload[PAYLOAD_MAX_SIZE - 1] = '\0';
-        resp->data_len = (int32_t)strlen(resp->payload);
+    ipc_fill(resp, STATUS_SUCCESS, data);
+}
+
+void ipc_set_tlv(ipc_response_t* resp, size_t len)
+{
+    if (resp == NULL || len > IPC_TLV_MAX) {
+        return;
     }
+    resp->status_code = STATUS_SUCCESS;
+    resp->flags = IPC_FLAG_TLV;
+    resp->data_len = (uint32_t)len;
+    resp->payload[len] = '\0';
 }
 
 ProjectStatus ipc_send_packet(int socket_fd, const ipc_response_t* resp)
 {
-    if (socket_fd < 0 || resp == NULL) {
+    if (socket_fd < 0 || resp == NULL || resp->data_len >= PAYLOAD_MAX_SIZE) {
         return STATUS_ERR_INVALID_ARG;
     }
 
-    /* TODO: Maybe add support for partial write? */
-    /* Not really supposed to happen thanks to SOCK_DGRAM + strict packet size... */
-    if (send(socket_fd, resp, sizeof(ipc_response_t), 0) != sizeof(ipc_response_t)) {
+    ipc_header_t hdr = {
+        .version = IPC_PROTO_VERSION,
+        .flags = resp->flags,
+        .status_code = resp->status_code,
+        .data_len = resp->data_len,
+        .mod_id = g_mod_id,
+        .timing = g_timing
+    };
+    hdr.timing.sent_ns = ipc_now_ns();
+    struct iovec iov[2] = {
+        { .iov_base = &hdr, .iov_len = sizeof(hdr) },
+        { .iov_base = (void*)resp->payload, .iov_len = resp->data_len }
+    };
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+    ssize_t expected = (ssize_t)(sizeof(hdr) + resp->data_len);
+
+    /* SOCK_SEQPACKET: the whole message goes out in one piece or not at all */
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != expected) {
+        ERROR("ipc_send_packet: fd %d sent %d of %d bytes (errno %d)", socket_fd, (int)sent, (int)expected, errno);
         return STATUS_ERR_IPC_SEND;
     }
+    DEBUG("ipc_send_packet: fd %d status %d len %u", socket_fd, resp->status_code, resp->data_len);
     return STATUS_SUCCESS;
 }
 
@@ -53,17 +120,238 @@ ProjectStatus ipc_receive_packet(int socket_fd, ipc_response_t* resp)
         return STATUS_ERR_INVALID_ARG;
     }
 
-    /* TODO: Maybe add support for partial read? */
-    /* Not really supposed to happen thanks to SOCK_DGRAM + strict packet size... */
-    if (recv(socket_fd, resp, sizeof(ipc_response_t), 0) != sizeof(ipc_response_t)) {
-        return STATUS_ERR_IPC_PROTO;
+    /* Header and payload are scattered straight into place, nothing is copied afterwards */
+    ipc_header_t hdr;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov[2] = {
+        { .iov_base = &hdr, .iov_len = sizeof(hdr) },
+        { .iov_base = resp->payload, .iov_len = PAYLOAD_MAX_SIZE - 1 }
+    };
+    struct msghdr msg = {
+        .msg_iov = iov, .msg_iovlen = 2,
+        .msg_control = control.buf, .msg_controllen = sizeof(control.buf)
+    };
+
+    resp->blob_fd = -1;
+    resp->mod_id = -1;
+    ssize_t len;
+    do {
+        len = recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (len < 0 && errno == EINTR);
+
+    if (len <= 0) {
+        /* 0: the module closed its end without answering */
+        INFO("ipc_receive_packet: fd %d closed or failed (errno %d)", socket_fd, (len < 0) ? errno : 0);
+        return STATUS_ERR_IPC_RECV;
     }
-    if (resp->data_len < 0) {
-        resp->data_len = 0;
-    } else if  (resp->data_len >= PAYLOAD_MAX_SIZE) {
-        resp->data_len = PAYLOAD_MAX_SIZE - 1;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+        && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(&resp->blob_fd, CMSG_DATA(cmsg), sizeof(int));
     }
+
+    if (len < (ssize_t)sizeof(hdr) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+        || hdr.version != IPC_PROTO_VERSION || hdr.data_len != (size_t)len - sizeof(hdr)
+        || ((hdr.flags & IPC_FLAG_BLOB) != 0) != (resp->blob_fd >= 0)) {
+        ERROR("ipc_receive_packet: fd %d malformed packet (len %d, version %u, flags 0x%x)",
+              socket_fd, (int)len, hdr.version, msg.msg_flags);
+        if (resp->blob_fd >= 0) {
+            close(resp->blob_fd);
+            resp->blob_fd = -1;
+        }
+        return STATUS_ERR_IPC_PROTO;
+    }
+
+    DEBUG("ipc_receive_packet: fd %d status %d len %u", socket_fd, hdr.status_code, hdr.data_len);
+    resp->status_code = hdr.status_code;
+    resp->flags = hdr.flags;
+    resp->mod_id = hdr.mod_id;
+    resp->timing = hdr.timing;
+    resp->data_len = hdr.data_len;
     resp->payload[resp->data_len] = '\0';
 
     return STATUS_SUCCESS;
-}
\ No newline at end of file
+}
+
+ProjectStatus ipc_blob_create(ipc_blob_t* blob, size_t capacity)
+{
+    if (blob == NULL || capacity == 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    blob->data = NULL;
+    blob->size = 0;
+    blob->fd = memfd_create("ipc_blob", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (blob->fd < 0) {
+        return STATUS_ERR_GENERIC;
+    }
+    if (ftruncate(blob->fd, (off_t)capacity) < 0) {
+        ipc_release_blob(blob);
+        return STATUS_ERR_GENERIC;
+    }
+
+    void* data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, blob->fd, 0);
+    if (data == MAP_FAILED) {
+        ipc_release_blob(blob);
+        return STATUS_ERR_GENERIC;
+    }
+    blob->data = data;
+    blob->size = capacity;
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus ipc_send_blob(int socket_fd, ipc_blob_t* blob, size_t used)
+{
+    if (socket_fd < 0 || blob == NULL || blob->fd < 0 || used > blob->size) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    /* F_SEAL_WRITE is refused while a writable mapping exists */
+    munmap(blob->data, blob->size);
+    blob->data = NULL;
+    blob->size = used;
+    if (ftruncate(blob->fd, (off_t)used) < 0
+        || fcntl(blob->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        return STATUS_ERR_IPC_SEND;
+    }
+
+    ipc_header_t hdr = {
+        .version = IPC_PROTO_VERSION,
+        .flags = IPC_FLAG_BLOB,
+        .status_code = STATUS_SUCCESS,
+        .data_len = 0,
+        .mod_id = g_mod_id,
+        .timing = g_timing
+    };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { .iov_base = &hdr, .iov_len = sizeof(hdr) };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control.buf, .msg_controllen = sizeof(control.buf)
+    };
+    memset(&control, 0, sizeof(control));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &blob->fd, sizeof(int));
+    hdr.timing.sent_ns = ipc_now_ns();
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != (ssize_t)sizeof(hdr)) {
+        return STATUS_ERR_IPC_SEND;
+    }
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus ipc_map_blob(ipc_response_t* resp, size_t max_size, ipc_blob_t* blob)
+{
+    struct stat st;
+    if (resp == NULL || blob == NULL || resp->blob_fd < 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    blob->fd = resp->blob_fd;
+    blob->data = NULL;
+    blob->size = 0;
+    resp->blob_fd = -1;
+
+    /* Without these seals the module could still change the content under our feet */
+    const int required = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+    int seals = fcntl(blob->fd, F_GET_SEALS);
+    if (seals < 0 || (seals & required) != required || fstat(blob->fd, &st) < 0
+        || st.st_size < 0 || (size_t)st.st_size > max_size) {
+        ERROR("ipc_map_blob: rejected blob (seals 0x%x, size %lld, max %zu)", seals, (long long)st.st_size, max_size);
+        ipc_release_blob(blob);
+        return STATUS_ERR_IPC_PROTO;
+    }
+
+    blob->size = (size_t)st.st_size;
+    if (blob->size > 0) {
+        void* data = mmap(NULL, blob->size, PROT_READ, MAP_SHARED, blob->fd, 0);
+        if (data == MAP_FAILED) {
+            ipc_release_blob(blob);
+            return STATUS_ERR_IPC_RECV;
+        }
+        blob->data = data;
+    }
+    return STATUS_SUCCESS;
+}
+
+void ipc_release_blob(ipc_blob_t* blob)
+{
+    if (blob == NULL) {
+        return;
+    }
+    if (blob->data != NULL) {
+        munmap(blob->data, blob->size);
+        blob->data = NULL;
+    }
+    if (blob->fd >= 0) {
+        close(blob->fd);
+        blob->fd = -1;
+    }
+    blob->size = 0;
+}
+
+ProjectStatus ipc_send_request(int socket_fd, int opcode, int mod_id, const char* arg, size_t arg_len)
+{
+    ipc_request_t req;
+    size_t len = offsetof(ipc_request_t, arg);
+    if (socket_fd < 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    /* Only the used part of the request is sent, the datagram keeps the boundary */
+    req.opcode = opcode;
+    req.mod_id = mod_id;
+    req.has_arg = (arg != NULL);
+    if (arg != NULL) {
+        if (arg_len == 0) {
+            arg_len = strnlen(arg, IPC_REQUEST_ARG_MAX - 1);
+        } else if (arg_len > IPC_REQUEST_ARG_MAX - 1) {
+            return STATUS_ERR_INVALID_ARG;     /* A truncated TLV argument would not decode */
+        }
+        memcpy(req.arg, arg, arg_len);
+        req.arg[arg_len] = '\0';
+        len += arg_len + 1;
+    }
+
+    if (send(socket_fd, &req, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        return STATUS_ERR_IPC_SEND;
+    }
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus ipc_receive_request(int socket_fd, ipc_request_t* req)
+{
+    ssize_t len = 0;
+    if (socket_fd < 0 || req == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    do {
+        len = recv(socket_fd, req, sizeof(*req) - 1, 0);
+    } while (len < 0 && errno == EINTR);
+
+    if (len < (ssize_t)offsetof(ipc_request_t, arg)) {
+        return STATUS_ERR_IPC_RECV;
+    }
+    ((char*)req)[len] = '\0';
+    if (!req->has_arg || len == (ssize_t)offsetof(ipc_request_t, arg)) {
+        req->has_arg = 0;
+        req->arg[0] = '\0';
+    }
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "latency.h"
+#include "modules.h"
+#include "file_utils.h"
+
+#define LATENCY_MAGIC   0x4C415448u     /* "LATH" */
+#define LATENCY_VERSION 1
+
+static const char* const g_phase_names[LAT_PHASE_COUNT] = {
+    [LAT_PHASE_DISPATCH] = "dispatch",
+    [LAT_PHASE_SANDBOX]  = "sandbox",
+    [LAT_PHASE_BODY]     = "body",
+    [LAT_PHASE_IPC]      = "ipc",
+    [LAT_PHASE_REAP]     = "reap",
+    [LAT_PHASE_TOTAL]    = "total",
+};
+
+const char* latency_phase_name(latency_phase_e phase)
+{
+    return (phase < LAT_PHASE_COUNT) ? g_phase_names[phase] : "?";
+}
+
+static uint32_t latency_bucket(uint64_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS) {
+        return (uint32_t)value;
+    }
+    if (value >= (1ull << LATENCY_MAX_BITS)) {
+        return LATENCY_BUCKETS - 1;
+    }
+    /* Top LATENCY_SUB_BITS bits below the leading one select the linear sub-bucket */
+    uint32_t msb = 63u - (uint32_t)__builtin_clzll(value);
+    uint32_t shift = msb - LATENCY_SUB_BITS;
+    uint32_t sub = (uint32_t)(value >> shift) - LATENCY_SUB_BUCKETS;
+    return LATENCY_SUB_BUCKETS * (shift + 1) + sub;
+}
+
+/* Highest value that lands in 'bucket' */
+static uint64_t latency_bucket_max(uint32_t bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    uint32_t shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void latency_init(latency_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->magic = LATENCY_MAGIC;
+    stats->version = LATENCY_VERSION;
+}
+
+void latency_record(latency_stats_t* stats, int mod_id, latency_phase_e phase, uint64_t value_us)
+{
+    if (stats == NULL || mod_id < 0 || mod_id >= MODULE_COUNT || phase >= LAT_PHASE_COUNT) {
+        return;
+    }
+
+    latency_hist_t* hist = &stats->hist[mod_id][phase];
+    if (hist->count == 0 || value_us < hist->min_us) {
+        hist->min_us = value_us;
+    }
+    if (value_us > hist->max_us) {
+        hist->max_us = value_us;
+    }
+    hist->count++;
+    hist->sum_us += value_us;
+    hist->buckets[latency_bucket(value_us)]++;
+}
+
+uint64_t latency_percentile(const latency_hist_t* hist, double pct)
+{
+    if (hist == NULL || hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)((pct / 100.0) * (double)hist->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > hist->count) rank = hist->count;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = latency_bucket_max(i);
+            return (value < hist->max_us) ? value : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
+
+uint64_t latency_response_bound_us(const latency_stats_t* stats, int mod_id, double pct, uint64_t min_samples)
+{
+    static const latency_phase_e response_phases[] = {
+        LAT_PHASE_DISPATCH, LAT_PHASE_SANDBOX, LAT_PHASE_BODY, LAT_PHASE_IPC
+    };
+    uint64_t bound = 0;
+
+    if (stats == NULL || mod_id < 0 || mod_id >= MODULE_COUNT) {
+        return 0;
+    }
+    /* Only stages that answered record a body: timeouts don't feed back into the deadline */
+    if (stats->hist[mod_id][LAT_PHASE_BODY].count < min_samples) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(response_phases) / sizeof(response_phases[0]); i++) {
+        bound += latency_percentile(&stats->hist[mod_id][response_phases[i]], pct);
+    }
+    return bound;
+}
+
+void latency_load(latency_stats_t* stats, const char* path)
+{
+    latency_init(stats);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ssize_t got = read(fd, stats, sizeof(*stats));
+    close(fd);
+    if (got != (ssize_t)sizeof(*stats) || stats->magic != LATENCY_MAGIC || stats->version != LATENCY_VERSION) {
+        latency_init(stats);   /* Other layout (e.g. MODULE_COUNT changed): start over */
+    }
+}
+
+ProjectStatus latency_save(const latency_stats_t* stats, const char* path)
+{
+    if (stats == NULL || path == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    return write_file_atomic(path, stats, sizeof(*stats));
+}
+
+/* Exports go through a FILE*: they are small, human-facing and written at most once per run */
+typedef void (*latency_row_fn)(FILE* f, const char* module, const char* phase, const latency_hist_t* hist, int first);
+
+static void latency_csv_row(FILE* f, const char* module, const char* phase, const latency_hist_t* hist, int first)
+{
+    if (first) {
+        fprintf(f, "module,phase,count,mean_us,min_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+    }
+    fprintf(f, "%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", module, phase,
+            (unsigned long long)hist->count, (unsigned long long)(hist->sum_us / hist->count),
+            (unsigned long long)hist->min_us,
+            (unsigned long long)latency_percentile(hist, 50.0), (unsigned long long)latency_percentile(hist, 90.0),
+            (unsigned long long)latency_percentile(hist, 99.0), (unsigned long long)latency_percentile(hist, 99.9),
+            (unsigned long long)hist->max_us);
+}
+
+static void latency_json_row(FILE* f, const char* module, const char* phase, const latency_hist_t* hist, int first)
+{
+    fprintf(f, "%s\n  {\"module\": \"%s\", \"phase\": \"%s\", \"count\": %llu, \"mean_us\": %llu, \"min_us\": %llu, "
+            "\"p50_us\": %llu, \"p90_us\": %llu, \"p99_us\": %llu, \"p999_us\": %llu, \"max_us\": %llu}",
+            first ? "" : ",", module, phase,
+            (unsigned long long)hist->count, (unsigned long long)(hist->sum_us / hist->count),
+            (unsigned long long)hist->min_us,
+            (unsigned long long)latency_percentile(hist, 50.0), (unsigned long long)latency_percentile(hist, 90.0),
+            (unsigned long long)latency_percentile(hist, 99.0), (unsigned long long)latency_percentile(hist, 99.9),
+            (unsigned long long)hist->max_us);
+}
+
+static ProjectStatus latency_export(const latency_stats_t* stats, const char* path, latency_row_fn row,
+                                    const char* prologue, const char* epilogue)
+{
+    if (stats == NULL || path == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    FILE* f = fopen(path, "we");
+    if (f == NULL) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+
+    int first = 1;
+    fputs(prologue, f);
+    for (int mod_id = 0; mod_id < MODULE_COUNT; mod_id++) {
+        const module_config_t* config = get_module_config(mod_id);
+        for (int phase = 0; phase < LAT_PHASE_COUNT; phase++) {
+            const latency_hist_t* hist = &stats->hist[mod_id][phase];
+            if (config == NULL || hist->count == 0) continue;
+            row(f, config->name, g_phase_names[phase], hist, first);
+            first = 0;
+        }
+    }
+    fputs(epilogue, f);
+    return (fclose(f) == 0) ? STATUS_SUCCESS : STATUS_ERR_GENERIC;
+}
+
+ProjectStatus latency_export_csv(const latency_stats_t* stats, const char* path)
+{
+    return latency_export(stats, path, latency_csv_row, "", "");
+}
+
+ProjectStatus latency_export_json(const latency_stats_t* stats, const char* path)
+{
+    return latency_export(stats, path, latency_json_row, "[", "\n]\n");
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "log_ring.h"
+
+void log_ring_init(log_ring_t* ring)
+{
+    memset(ring, 0, sizeof(*ring));
+}
+
+uint64_t log_ring_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void log_ring_push(log_ring_t* ring, int stage, const char* fmt, ...)
+{
+    va_list args;
+    if (ring == NULL || fmt == NULL) {
+        return;
+    }
+
+    if (ring->count == LOG_RING_CAPACITY) {
+        ring->head = (ring->head + 1) % LOG_RING_CAPACITY;
+        ring->count--;
+        ring->dropped++;
+    }
+
+    log_record_t* rec = &ring->records[(ring->head + ring->count) % LOG_RING_CAPACITY];
+    rec->ts_ms = log_ring_now_ms();
+    rec->stage = (int16_t)stage;
+
+    va_start(args, fmt);
+    int len = vsnprintf(rec->msg, sizeof(rec->msg), fmt, args);
+    va_end(args);
+    if (len < 0) {
+        len = 0;
+        rec->msg[0] = '\0';
+    }
+    rec->len = (uint16_t)((len >= LOG_RING_MSG_MAX) ? LOG_RING_MSG_MAX - 1 : len);
+
+    /* One record is one line */
+    for (char* p = rec->msg; (p = memchr(p, '\n', (size_t)(rec->msg + rec->len - p))) != NULL; p++) {
+        *p = ' ';
+    }
+    ring->count++;
+}
+
+int log_ring_should_flush(const log_ring_t* ring, uint64_t now_ms)
+{
+    if (ring == NULL || ring->count == 0) {
+        return 0;
+    }
+    if (ring->count >= LOG_RING_FLUSH_RECORDS) {
+        return 1;
+    }
+    return now_ms >= ring->records[ring->head].ts_ms + LOG_RING_FLUSH_MS;
+}
+
+size_t log_ring_drain(log_ring_t* ring, char* out_buf, size_t max_len)
+{
+    size_t used = 0;
+    if (ring == NULL || out_buf == NULL || max_len == 0) {
+        return 0;
+    }
+
+    /* Records lost to overwrites are reported first, so the gap is visible on the server */
+    if (ring->dropped > 0) {
+        int len = snprintf(out_buf, max_len, "%llu - dropped %u records\n",
+                           (unsigned long long)log_ring_now_ms(), ring->dropped);
+        if (len > 0 && (size_t)len < max_len) {
+            used = (size_t)len;
+            ring->dropped = 0;
+        }
+    }
+
+    while (ring->count > 0) {
+        const log_record_t* rec = &ring->records[ring->head];
+        char prefix[40];
+        int prefix_len = (rec->stage == LOG_STAGE_NONE)
+            ? snprintf(prefix, sizeof(prefix), "%llu - ", (unsigned long long)rec->ts_ms)
+            : snprintf(prefix, sizeof(prefix), "%llu %d ", (unsigned long long)rec->ts_ms, rec->stage);
+
+        size_t line_len = (size_t)prefix_len + rec->len + 1;
+        if (used + line_len >= max_len) {
+            break;      /* Keep the terminator room, the rest goes with the next batch */
+        }
+        memcpy(out_buf + used, prefix, (size_t)prefix_len);
+        memcpy(out_buf + used + prefix_len, rec->msg, rec->len);
+        used += line_len;
+        out_buf[used - 1] = '\n';
+
+        ring->head = (ring->head + 1) % LOG_RING_CAPACITY;
+        ring->count--;
+    }
+
+    out_buf[used] = '\0';
+    return used;
+}
@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include "lz.h"
+
+#define LZ_LAST_LITERALS    5           /* A block always ends with at least this many literals */
+#define LZ_MATCH_LIMIT      12          /* No match starts in the last LZ_MATCH_LIMIT bytes */
+
+static uint32_t lz_read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Extra length bytes of a nibble that overflowed: 255 until the rest fits in one byte */
+static int lz_put_len(uint8_t** op, const uint8_t* end, size_t len)
+{
+    while (len >= 255) {
+        if (*op >= end) {
+            return 0;
+        }
+        *(*op)++ = 255;
+        len -= 255;
+    }
+    if (*op >= end) {
+        return 0;
+    }
+    *(*op)++ = (uint8_t)len;
+    return 1;
+}
+
+/* One sequence. 'match_len' 0 for the last one, which only carries literals */
+static int lz_put_sequence(uint8_t** op, const uint8_t* end, const uint8_t* lit, size_t lit_len,
+                           size_t offset, size_t match_len)
+{
+    if (*op >= end) {
+        return 0;
+    }
+    uint8_t* token = (*op)++;
+    *token = (uint8_t)(((lit_len >= 15) ? 15 : lit_len) << 4);
+    if (lit_len >= 15 && !lz_put_len(op, end, lit_len - 15)) {
+        return 0;
+    }
+    if ((size_t)(end - *op) < lit_len) {
+        return 0;
+    }
+    memcpy(*op, lit, lit_len);
+    *op += lit_len;
+    if (match_len == 0) {
+        return 1;
+    }
+
+    if (end - *op < 2) {
+        return 0;
+    }
+    *(*op)++ = (uint8_t)(offset & 0xFF);
+    *(*op)++ = (uint8_t)(offset >> 8);
+    size_t extra = match_len - LZ_MIN_MATCH;
+    *token |= (uint8_t)((extra >= 15) ? 15 : extra);
+    return (extra < 15) || lz_put_len(op, end, extra - 15);
+}
+
+size_t lz_compress(const void* src, size_t len, void* dst, size_t cap)
+{
+    const uint8_t* in = src;
+    uint8_t* op = dst;
+    const uint8_t* end = op + cap;
+    uint16_t table[1u << LZ_HASH_BITS];     /* Position + 1 of the last sequence with that hash, 0 if none */
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    if (len > LZ_MAX_INPUT) {
+        return 0;
+    }
+    memset(table, 0, sizeof(table));
+    if (len > LZ_MATCH_LIMIT) {
+        size_t limit = len - LZ_MATCH_LIMIT;
+        while (ip < limit) {
+            uint32_t seq = lz_read32(in + ip);
+            uint32_t h = lz_hash(seq);
+            size_t ref = table[h];
+            table[h] = (uint16_t)(ip + 1);
+            if (ref == 0 || lz_read32(in + ref - 1) != seq) {
+                ip++;
+                continue;
+            }
+            size_t match = ref - 1;
+            size_t match_len = LZ_MIN_MATCH;
+            size_t max_len = len - LZ_LAST_LITERALS - ip;
+            while (match_len < max_len && in[match + match_len] == in[ip + match_len]) {
+                match_len++;
+            }
+            if (!lz_put_sequence(&op, end, in + anchor, ip - anchor, ip - match, match_len)) {
+                return 0;
+            }
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+    if (!lz_put_sequence(&op, end, in + anchor, len - anchor, 0, 0)) {
+        return 0;
+    }
+    return (size_t)(op - (uint8_t*)dst);
+}
+
+/* Length nibble plus its extra bytes */
+static int lz_get_len(const uint8_t** ip, const uint8_t* end, size_t* len)
+{
+    if (*len != 15) {
+        return 1;
+    }
+    uint8_t b;
+    do {
+        if (*ip >= end) {
+            return 0;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 1;
+}
+
+ProjectStatus lz_decompress(const void* src, size_t len, void* dst, size_t cap, size_t* out_len)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = ip + len;
+    uint8_t* out = dst;
+    uint8_t* op = out;
+
+    if (src == NULL || dst == NULL || out_len == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4;
+        if (!lz_get_len(&ip, iend, &lit_len) || lit_len > (size_t)(iend - ip) || lit_len > cap - (size_t)(op - out)) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == iend) {
+            break;      /* Last sequence */
+        }
+
+        if (iend - ip < 2) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 0x0F;
+        if (offset == 0 || offset > (size_t)(op - out) || !lz_get_len(&ip, iend, &match_len)) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > cap - (size_t)(op - out)) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        /* Byte by byte: the match may overlap what it produces */
+        for (size_t i = 0; i < match_len; i++) {
+            op[i] = op[i - offset];
+        }
+        op += match_len;
+    }
+    *out_len = (size_t)(op - out);
+    return STATUS_SUCCESS;
+}
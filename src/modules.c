@@ -1,23 +1,52 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sched.h>
 
 #include "modules.h"
 #include "ipc.h"
 #include "symbol_resolver.h"
 #include "network_utils.h"
 #include "xml_utils.h"
+#include "db_cleaner.h"
+#include "tlv.h"
+#include "upload.h"
 
-static const char *db_path = "/data/data/com.android.phone/databases/test.db";
+#define PHONE_PREFS_PATH    "/data/local/tmp/prefs.xml"
+
+/* DBCleaner rewrites large tables: keep it from starving the foreground and from growing unbounded */
+static const module_cgroup_t CGROUP_DB_CLEANER = {
+    .cpu_weight = 20,
+    .memory_max = 64 * 1024 * 1024,
+    .io_weight = 20,
+};
 
-static const module_config_t MODULE_REGISTRY[] = {
-    { MOD_ID_IMEI,       "IMEI",      1001, 1001, "u:r:isolated_imei:s0", mod_imei       },
-    { MOD_ID_PHONE,      "Phone",     1002, 1002, "u:r:isolated_app:s0",  mod_phone      },
-    { MOD_ID_LOGGER,     "Logger",    1004, 1004, "u:r:isolated_net:s0",  mod_logger     },
-    { MOD_ID_SENDER,     "Sender",    1004, 1004, "u:r:isolated_net:s0",  mod_sender     },
-    { MOD_ID_DB_CLEANER, "DBCleaner", 1001, 1001, "u:r:isolated_app:s0",  mod_db_cleaner }, 
+/*
+ * ... and off the cores and disk queue the other stages need. Batch rather than idle, and
+ * best-effort I/O rather than idle: the cleaner holds the DB write lock while it runs.
+ */
+static const module_sched_t SCHED_DB_CLEANER = {
+    .cpu_mask = 0x0F,           /* Little cluster on the usual 4+4 / 4+3+1 layouts */
+    .policy = SCHED_BATCH,
+    .nice = 10,
+    .ioprio_class = IOPRIO_CLASS_BE,
+    .ioprio_level = 7,
 };
 
+/*
+ * Both only change on a reflash or a SIM / account change. ro.id.imei is set once per boot with the
+ * same serial every time, so its value is what tells boots apart. The TTL bounds what a missed
+ * signal costs.
+ */
+static const module_cache_t CACHE_IMEI = {
+    .ttl_ms = 24 * 60 * 60 * 1000, .signal = CACHE_SIGNAL_PROPERTY, .source = "ro.id.imei",
+};
+static const module_cache_t CACHE_PHONE = {
+    .ttl_ms = 24 * 60 * 60 * 1000, .signal = CACHE_SIGNAL_FILE, .source = PHONE_PREFS_PATH,
+};
+
+static const char *db_path = "/data/data/com.android.phone/databases/test.db";
 
 /*  */
 static void mod_imei(int fd, const char* arg)
@@ -25,7 +54,7 @@ static void mod_imei(int fd, const char* arg)
     UNUSED(arg);
     char val[256] = { 0 };
     ProjectStatus status = 0;
-    ipc_response_t resp = { 0 };
+    ipc_response_t resp;
 
     status = sal_get_property("ro.id.imei", val);
     if (status == STATUS_SUCCESS) {
@@ -46,9 +75,9 @@ static void mod_phone(int fd, const char* arg)
     UNUSED(arg);
     char val[256] = { 0 };
     ProjectStatus status = 0;
-    ipc_response_t resp = { 0 };
+    ipc_response_t resp;
 
-    status = xml_get_value("/data/local/tmp/prefs.xml", "number", val, sizeof(val));
+    status = xml_get_value(PHONE_PREFS_PATH, "number", val, sizeof(val));
     if (status == STATUS_SUCCESS) {
         ipc_set_data(&resp, val);
     } else {
@@ -60,11 +89,11 @@ static void mod_phone(int fd, const char* arg)
     }
 }
 
-/*  */
+/* 'arg' is a batch of "<ts_ms> <stage> <msg>" lines drained from the daemon's log ring */
 static void mod_logger(int fd, const char* arg)
 {
     UNUSED(fd);
-    ipc_response_t resp = { 0 };
+    ipc_response_t resp;
 
     if (arg != NULL) {
         network_send_log(arg);
@@ -78,20 +107,60 @@ static void mod_logger(int fd, const char* arg)
     }
 }
 
-/*  */
+/*
+ * 'arg' is a RESULT_TAG_BATCH record: spooled uploads from earlier runs, then this run's, see
+ * prepare_upload(). They go out as one frame of deltas against what the server acknowledged
+ * last (upload.h), so the batch is delivered as a whole or not at all.
+ */
 static void mod_sender(int fd, const char* arg)
 {
-    ipc_response_t resp = { 0 };
+    ipc_response_t resp;
     char server_response[128] = { 0 };
+    char payload[UPLOAD_TEXT_MAX];
+    tlv_field_t batch;
+    tlv_writer_t w;
+    size_t len = 0;
+    uint32_t records = 0;
+    uint64_t version = 0;
+    int resync = 0;
+    ProjectStatus status = STATUS_ERR_INVALID_ARG;
 
-    if (arg != NULL) {
-        if (network_send_payload(arg, server_response, sizeof(server_response)) == STATUS_SUCCESS) {
-            ipc_set_data(&resp, server_response);
-        } else {
-            ipc_set_error(&resp, STATUS_ERR_NETWORK_FAILURE, NULL);
+    size_t arg_len = (arg != NULL) ? tlv_field_size(arg, IPC_REQUEST_ARG_MAX) : 0;
+    if (arg_len > 0 && tlv_find(arg, arg_len, RESULT_TAG_BATCH, &batch)) {
+        status = upload_encode_frame(&batch, 0, payload, sizeof(payload), &records, &version);
+        if (status == STATUS_SUCCESS) {
+            status = network_send_payload(payload, server_response, sizeof(server_response));
+        }
+        /* The server's state is not the one the deltas are against: send everything, once */
+        if (status == STATUS_SUCCESS && strcmp(server_response, UPLOAD_RESYNC_REPLY) == 0) {
+            resync = 1;
+            status = upload_encode_frame(&batch, 1, payload, sizeof(payload), &records, &version);
+            if (status == STATUS_SUCCESS) {
+                status = network_send_payload(payload, server_response, sizeof(server_response));
+            }
         }
+        /* Anything but the acknowledgement of exactly this frame leaves the records spooled */
+        if (status == STATUS_SUCCESS && !upload_reply_acked(server_response, version)) {
+            ERROR("[SENDER] Upload not acknowledged by the server");
+            status = STATUS_ERR_NETWORK_FAILURE;
+        }
+        if (status != STATUS_SUCCESS && status != STATUS_ERR_INVALID_ARG) {
+            status = STATUS_ERR_NETWORK_FAILURE;
+        }
+    }
+
+    if (status == STATUS_SUCCESS) {
+        tlv_writer_init(&w, resp.payload, IPC_TLV_MAX);
+        tlv_put_uint(&w, RESULT_TAG_SENT, records);
+        if (resync) {
+            tlv_put_uint(&w, RESULT_TAG_RESYNC, 1);
+        }
+        status = tlv_finish(&w, &len);
+    }
+    if (status == STATUS_SUCCESS) {
+        ipc_set_tlv(&resp, len);
     } else {
-        ipc_set_error(&resp, STATUS_ERR_INVALID_ARG, NULL);
+        ipc_set_error(&resp, status, NULL);
     }
 
     if (ipc_send_packet(fd, &resp) != STATUS_SUCCESS) {
@@ -103,58 +172,39 @@ static void mod_sender(int fd, const char* arg)
 static void mod_db_cleaner(int fd, const char* arg)
 {
     UNUSED(arg);
-    int rc = 0;
-    char* err_msg = NULL;
+    char state_path[256];
+    tlv_writer_t w;
+    size_t len = 0;
     struct sqlite3* db = NULL;
-    ipc_response_t resp = { 0 };
+    ipc_response_t resp;
+    db_clean_report_t report;
     ProjectStatus status = STATUS_SUCCESS;
 
     /* Open the DB file */
     if (sal_sqlite_open(db_path, &db) != SQLITE_OK) {
-        if (db != NULL) {
-            sal_sqlite_close(db);
-            db = NULL;
-        }
         status = STATUS_ERR_DB_LOAD;
         goto cleanup;
     }
 
-    /* Start the transaction to delete our entries */
-    const char* txn_sql = 
-        "BEGIN IMMEDIATE;" \
-        "DELETE FROM ... WHERE ...='...';" \
-        "COMMIT;";
+    /* Delete + reclaim in bounded steps, whatever is left is picked up by the next run */
+    snprintf(state_path, sizeof(state_path), "%s-cleaner", db_path);
+    status = db_clean_run(db, state_path, DB_CLEAN_BUDGET_MS, &report);
 
-    rc = sal_sqlite_exec(db, txn_sql, &err_msg);
-    if (rc != SQLITE_OK) {
-        if (err_msg != NULL) {
-            sal_sqlite_free(err_msg);
-        }
-        if (db != NULL) {
-            sal_sqlite_close(db);
-            db = NULL;
-        }
-        status = STATUS_ERR_DB_EXEC;
-        goto cleanup;
+cleanup:
+    if (db != NULL) {
+        sal_sqlite_close(db);
+        db = NULL;
     }
 
-    /* Call VACUUM in order to reduce DB size + clear journal */
-    rc = sal_sqlite_exec(db, "VACUUM;", &err_msg);
-    if (rc != SQLITE_OK) {
-        if (err_msg != NULL) {
-            sal_sqlite_free(err_msg);
-        }
-        if (db != NULL) {
-            sal_sqlite_close(db);
-            db = NULL;
-        }
-        status = STATUS_ERR_DB_EXEC;
-        goto cleanup;
+    if (status == STATUS_SUCCESS) {
+        tlv_writer_init(&w, resp.payload, IPC_TLV_MAX);
+        tlv_put_uint(&w, RESULT_TAG_ROWS_DELETED, (uint64_t)report.rows_deleted);
+        tlv_put_uint(&w, RESULT_TAG_PAGES_FREED, (uint64_t)report.pages_freed);
+        tlv_put_uint(&w, RESULT_TAG_CLEAN_COMPLETE, (uint64_t)report.complete);
+        status = tlv_finish(&w, &len);
     }
-
-cleanup:
     if (status == STATUS_SUCCESS) {
-        ipc_set_data(&resp, NULL);
+        ipc_set_tlv(&resp, len);
     }
     else {
         ipc_set_error(&resp, status, NULL); 
@@ -166,12 +216,59 @@ cleanup:
 }
 
 /*  */
-const module_config_t* get_module_config(int module_id) {
-    size_t count = sizeof(MODULE_REGISTRY) / sizeof(module_config_t);  // TODO: Convert to compile-time macro
-    for (size_t i = 0; i < count; i++) {
-        if (MODULE_REGISTRY[i].id == module_id) {
-            return &MODULE_REGISTRY[i];
-        }
+/*
+ * Indexed by module ID. Timeouts left at 0 fall back to TIMEOUT_IPC_MS / TIMEOUT_EXIT_MS.
+ * Cheap modules get tight budgets so a hang fails fast; see CONFIG_ADAPTIVE_DEADLINE.
+ */
+static const module_config_t MODULE_REGISTRY[MODULE_COUNT] = {
+    [MOD_ID_IMEI] = {
+        .id = MOD_ID_IMEI, .name = "IMEI", .uid = 1001, .gid = 1001,
+        .selinux_context = "u:r:isolated_imei:s0", .entry_point = mod_imei,
+        .timeout_ms = 250, .timeout_max_ms = 1000, .exit_timeout_ms = 250, .retries = 1,
+        .cache = &CACHE_IMEI,
+    },
+    [MOD_ID_PHONE] = {
+        .id = MOD_ID_PHONE, .name = "Phone", .uid = 1002, .gid = 1002,
+        .selinux_context = "u:r:isolated_app:s0", .entry_point = mod_phone,
+        .timeout_ms = 500, .timeout_max_ms = 2000, .exit_timeout_ms = 250, .retries = 1,
+        .cache = &CACHE_PHONE,
+    },
+    [MOD_ID_LOGGER] = {
+        .id = MOD_ID_LOGGER, .name = "Logger", .uid = 1004, .gid = 1004,
+        .selinux_context = "u:r:isolated_net:s0", .entry_point = mod_logger,
+        .timeout_ms = 5000, .timeout_max_ms = 10000,
+    },
+    /* The upload is what the run is for */
+    [MOD_ID_SENDER] = {
+        .id = MOD_ID_SENDER, .name = "Sender", .uid = 1004, .gid = 1004,
+        .selinux_context = "u:r:isolated_net:s0", .entry_point = mod_sender,
+        .timeout_ms = 5000, .timeout_max_ms = 10000, .retries = 1, .critical = 1,
+    },
+    /* Resumable: a timed out run is picked up by the next one rather than retried */
+    [MOD_ID_DB_CLEANER] = {
+        .id = MOD_ID_DB_CLEANER, .name = "DBCleaner", .uid = 1001, .gid = 1001,
+        .selinux_context = "u:r:isolated_app:s0", .entry_point = mod_db_cleaner,
+        .cgroup = &CGROUP_DB_CLEANER, .sched = &SCHED_DB_CLEANER,
+        .timeout_ms = 2 * DB_CLEAN_BUDGET_MS, .timeout_max_ms = 4 * DB_CLEAN_BUDGET_MS,
+    },
+};
+
+const module_config_t* get_module_config(int module_id)
+{
+    /* Out of range, or an ID without a module (MOD_ID_MAC) */
+    if (module_id < 0 || module_id >= MODULE_COUNT || MODULE_REGISTRY[module_id].entry_point == NULL) {
+        return NULL;
     }
-    return NULL;
-}
\ No newline at end of file
+    return &MODULE_REGISTRY[module_id];
+}
+
+int module_same_domain(const module_config_t* a, const module_config_t* b)
+{
+    if (a == NULL || b == NULL) {
+        return 0;
+    }
+    /* A cgroup is per module name, so a module with one never shares its process */
+    return a->uid == b->uid && a->gid == b->gid && a->cgroup == NULL && b->cgroup == NULL && a->sched == b->sched
+        && a->selinux_context != NULL && b->selinux_context != NULL
+        && strcmp(a->selinux_context, b->selinux_context) == 0;
+}
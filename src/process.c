@@ -0,0 +1,322 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <dirent.h>
+
+#include "process.h"
+#include "ipc.h"
+#include "cgroup.h"
+#include "symbol_resolver.h"
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434     /* Same number on every architecture */
+#endif
+#ifndef __NR_close_range
+#define __NR_close_range 436
+#endif
+
+#define MODULE_SOCKET_FD 3      /* Where the child's end of the socketpair lives after close_inherited_fds() */
+
+#define IOPRIO_WHO_PROCESS          1
+#define IOPRIO_CLASS_SHIFT          13
+#define IOPRIO_PRIO_VALUE(cls, lvl) (((cls) << IOPRIO_CLASS_SHIFT) | (lvl))
+
+/*
+ * Child side: affinity, policy, nice and I/O priority. Done before the privileges are dropped,
+ * as SELinux or a missing CAP_SYS_NICE may refuse some of it later. Failures are not fatal.
+ */
+static void apply_module_sched(const module_config_t* config)
+{
+    const module_sched_t* sched = config->sched;
+
+    if (sched->cpu_mask != 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (sched->cpu_mask & (1ull << cpu)) CPU_SET(cpu, &set);
+        }
+        /* EINVAL if none of the CPUs exist on this device: keep the inherited mask */
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            ERROR("Module %s: sched_setaffinity failed (errno %d)", config->name, errno);
+        }
+    }
+
+    struct sched_param param = { .sched_priority = 0 };
+    if (sched_setscheduler(0, sched->policy, &param) < 0) {
+        ERROR("Module %s: sched_setscheduler(%d) failed (errno %d)", config->name, sched->policy, errno);
+    }
+    if (setpriority(PRIO_PROCESS, 0, sched->nice) < 0) {
+        ERROR("Module %s: setpriority(%d) failed (errno %d)", config->name, sched->nice, errno);
+    }
+
+    if (sched->ioprio_class != 0
+        && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                   IOPRIO_PRIO_VALUE(sched->ioprio_class, sched->ioprio_level)) < 0) {
+        ERROR("Module %s: ioprio_set failed (errno %d)", config->name, errno);
+    }
+}
+
+static volatile sig_atomic_t g_cancel_requested;
+
+static void on_cancel_signal(int sig)
+{
+    UNUSED(sig);
+    g_cancel_requested = 1;
+}
+
+int module_cancel_requested(void)
+{
+    return g_cancel_requested;
+}
+
+/*
+ * Child side, right after fork: the daemon's fds (other modules' and workers' sockets, files,
+ * pidfds) must not leak into the sandbox, and CLOEXEC does not help as modules never exec.
+ * Keeps stdio and 'child_fd', moved to MODULE_SOCKET_FD, and returns the new socket fd.
+ */
+static int close_inherited_fds(int child_fd)
+{
+    if (child_fd != MODULE_SOCKET_FD) {
+        if (dup2(child_fd, MODULE_SOCKET_FD) < 0) _exit(EXIT_FAILURE);
+        close(child_fd);
+    }
+    if (syscall(__NR_close_range, MODULE_SOCKET_FD + 1, ~0U, 0) == 0) {
+        return MODULE_SOCKET_FD;
+    }
+
+    // Pre-5.9 kernels: walk the table
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == NULL) _exit(EXIT_FAILURE);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int fd = atoi(entry->d_name);
+        if (fd > MODULE_SOCKET_FD && fd != dirfd(dir)) {
+            close(fd);
+        }
+    }
+    closedir(dir);
+    return MODULE_SOCKET_FD;
+}
+
+/* Child side: drops into the module's security domain, or dies trying */
+static void enter_module_sandbox(const module_config_t* config)
+{
+    // Die if daemon dies
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    // Cooperative cancel: SIGTERM only raises a flag, see module_cancel_requested()
+    struct sigaction sa = { .sa_handler = on_cancel_signal, .sa_flags = SA_RESTART };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigset_t term;
+    sigemptyset(&term);
+    sigaddset(&term, SIGTERM);
+    sigprocmask(SIG_UNBLOCK, &term, NULL);  // Blocked in a resident daemon, which reads it from a signalfd
+
+    // Resource limits, while we still have the rights to move ourselves
+    if (config->cgroup != NULL && cgroup_enter(config->name) != STATUS_SUCCESS) {
+        ERROR("Module %s runs outside of its cgroup", config->name);
+    }
+    if (config->sched != NULL) {
+        apply_module_sched(config);
+    }
+
+    // Security Context
+    sal_set_selinux_context(config->selinux_context);
+    if (setresgid(config->gid, config->gid, config->gid) < 0) _exit(EXIT_FAILURE);
+    if (setresuid(config->uid, config->uid, config->uid) < 0) _exit(EXIT_FAILURE);
+}
+
+int open_process_fd(pid_t pid)
+{
+    int pidfd = (int)syscall(__NR_pidfd_open, pid, 0);
+    return (pidfd < 0) ? -1 : pidfd;
+}
+
+static uint64_t timeval_to_us(struct timeval tv)
+{
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+ProjectStatus reap_process(pid_t pid, process_usage_t* usage)
+{
+    int status;
+    pid_t result;
+    struct rusage ru;
+
+    do {
+        result = wait4(pid, &status, WNOHANG, &ru);
+    } while (result == -1 && errno == EINTR);
+
+    if (result > 0 && usage != NULL) {
+        usage->valid = 1;
+        usage->utime_us = timeval_to_us(ru.ru_utime);
+        usage->stime_us = timeval_to_us(ru.ru_stime);
+        usage->maxrss_kb = ru.ru_maxrss;
+        usage->minflt = ru.ru_minflt;
+        usage->majflt = ru.ru_majflt;
+        usage->nvcsw = ru.ru_nvcsw;
+        usage->nivcsw = ru.ru_nivcsw;
+    }
+
+    /* ECHILD: already reaped, nothing left to wait for */
+    if (result > 0 || (result == -1 && errno == ECHILD)) {
+        return STATUS_SUCCESS;
+    }
+    return STATUS_ERR_GENERIC;
+}
+
+/* Blocks on the pidfd until 'pid' exits or 'timeout_ms' passes */
+static ProjectStatus wait_on_process_fd(int pidfd, pid_t pid, int timeout_ms, process_usage_t* usage)
+{
+    struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+    int poll_res;
+
+    do {
+        poll_res = poll(&pfd, 1, timeout_ms);
+    } while (poll_res < 0 && errno == EINTR);
+
+    if (poll_res > 0) {
+        return reap_process(pid, usage);
+    }
+    return STATUS_ERR_TIMEOUT;
+}
+
+/* Pre-pidfd kernels: poll waitpid until 'pid' exits or 'timeout_ms' passes */
+static ProjectStatus wait_polling(pid_t pid, int timeout_ms, process_usage_t* usage)
+{
+    int elapsed_ms = 0;
+
+    while (elapsed_ms < timeout_ms) {
+        if (reap_process(pid, usage) == STATUS_SUCCESS) return STATUS_SUCCESS;
+        usleep(POLL_INTERVAL_MS * 1000);
+        elapsed_ms += POLL_INTERVAL_MS;
+    }
+    return STATUS_ERR_TIMEOUT;
+}
+
+ProjectStatus wait_for_process_exit(pid_t pid, process_usage_t* usage)
+{
+    ProjectStatus status = STATUS_ERR_TIMEOUT;
+    int pidfd = open_process_fd(pid);
+
+    /* Phase 1: Natural Exit */
+    status = (pidfd >= 0) ? wait_on_process_fd(pidfd, pid, TIMEOUT_EXIT_MS, usage)
+                              : wait_polling(pid, TIMEOUT_EXIT_MS, usage);
+
+    // Phase 2: Force Kill
+    if (status != STATUS_SUCCESS) {
+        ERROR("PID %d timed out. Sending SIGKILL.", pid);
+        kill(pid, SIGKILL);
+        status = (pidfd >= 0) ? wait_on_process_fd(pidfd, pid, TIMEOUT_EXIT_MS, usage)
+                              : wait_polling(pid, TIMEOUT_EXIT_MS, usage);
+    }
+
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+    if (status != STATUS_SUCCESS) {
+        ERROR("CRITICAL: PID %d is a Zombie.", pid);
+        return STATUS_ERR_ZOMBIE;
+    }
+    return STATUS_SUCCESS;
+}
+
+pid_t spawn_module_process(const module_config_t* config, int* parent_fd, const char* arg)
+{
+    int sv[2] = { 0 };
+    if (config->cgroup != NULL) {
+        cgroup_prepare(config->name, config->cgroup);
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(sv[0]); close(sv[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        // --- Child ---
+        ipc_mark(IPC_MARK_START);
+        close(sv[0]);
+        int child_fd = close_inherited_fds(sv[1]);
+
+        trace_reset();
+        enter_module_sandbox(config);
+        ipc_mark(IPC_MARK_READY);
+        ipc_set_module(config->id);
+        INFO("Module %s started (pid %d)", config->name, getpid());
+        if (config->entry_point) config->entry_point(child_fd, arg);
+        trace_dump_if(TRACE_LEVEL_ERROR);
+        _exit(EXIT_SUCCESS);
+    }
+
+    // --- Parent ---
+    close(sv[1]);
+    *parent_fd = sv[0];
+    return pid;
+}
+
+pid_t spawn_module_worker(const module_config_t* config, int* parent_fd)
+{
+    int sv[2] = { 0 };
+    if (config->cgroup != NULL) {
+        cgroup_prepare(config->name, config->cgroup);
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(sv[0]); close(sv[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        // --- Worker ---
+        close(sv[0]);
+        int child_fd = close_inherited_fds(sv[1]);
+        ipc_request_t req;
+
+        trace_reset();
+        enter_module_sandbox(config);
+        INFO("Worker %s started (pid %d)", config->name, getpid());
+
+        /* Serve requests until told to stop or the daemon side goes away */
+        while (ipc_receive_request(child_fd, &req) == STATUS_SUCCESS && req.opcode == IPC_OP_RUN) {
+            const module_config_t* target = get_module_config(req.mod_id);
+            ipc_mark(IPC_MARK_START);   /* No fork nor sandbox per request: ready right away */
+            ipc_set_module(req.mod_id);
+            g_cancel_requested = 0;
+            if (!module_same_domain(config, target) && target != config) {
+                /* Never runs a module under credentials other than its own */
+                ipc_response_t resp;
+                ipc_set_error(&resp, STATUS_ERR_INVALID_ARG, "Module outside of the worker's domain");
+                ipc_send_packet(child_fd, &resp);
+                continue;
+            }
+            if (target->entry_point) target->entry_point(child_fd, req.has_arg ? req.arg : NULL);
+        }
+        trace_dump_if(TRACE_LEVEL_ERROR);
+        _exit(EXIT_SUCCESS);
+    }
+
+    // --- Parent ---
+    close(sv[1]);
+    *parent_fd = sv[0];
+    return pid;
+}
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "props.h"
+#include "symbol_resolver.h"
+
+static void props_read_cb(void* cookie, const char* name, const char* value, uint32_t serial)
+{
+    props_entry_t* entry = cookie;
+    UNUSED(name);
+    strncpy(entry->value, value, PROPS_VALUE_MAX - 1);
+    entry->value[PROPS_VALUE_MAX - 1] = '\0';
+    entry->serial = serial;
+}
+
+ProjectStatus props_snapshot_init(props_snapshot_t* snap, props_entry_t* entries, size_t count)
+{
+    if (snap == NULL || entries == NULL || count == 0 || count > PROPS_SNAPSHOT_MAX) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    memset(snap, 0, sizeof(*snap));
+    snap->entries = entries;
+    snap->count = count;
+    for (size_t i = 0; i < count; i++) {
+        entries[i].pi = NULL;
+        entries[i].serial = 0;
+        entries[i].value[0] = '\0';
+    }
+    return STATUS_SUCCESS;
+}
+
+int props_snapshot_refresh(props_snapshot_t* snap)
+{
+    int changed = 0;
+    snap->changed = 0;
+
+    /* Read before the entries: a write racing with the refresh shows up in the next one */
+    uint32_t area_serial = sal_property_area_serial();
+    if (snap->primed && area_serial == snap->area_serial) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < snap->count; i++) {
+        props_entry_t* entry = &snap->entries[i];
+        if (entry->pi == NULL) {
+            /* Missing so far: properties can be created at any time */
+            entry->pi = sal_property_find(entry->name);
+            if (entry->pi == NULL) continue;
+        } else if (sal_property_serial(entry->pi) == entry->serial) {
+            continue;
+        }
+        if (sal_property_read(entry->pi, props_read_cb, entry) == 0) {
+            snap->changed |= 1ull << i;
+            changed++;
+        }
+    }
+    snap->area_serial = area_serial;
+    snap->primed = 1;
+    return changed;
+}
+
+const props_entry_t* props_snapshot_find(const props_snapshot_t* snap, const char* name)
+{
+    for (size_t i = 0; i < snap->count; i++) {
+        if (strcmp(snap->entries[i].name, name) == 0) {
+            return &snap->entries[i];
+        }
+    }
+    return NULL;
+}
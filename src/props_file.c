@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "props_file.h"
+
+#define PROPS_FILE_MAGIC    0x50525053u     /* "PRPS" */
+
+/* Serials move by 2 per write; an odd serial marks a write in progress */
+struct prop_info {
+    _Atomic uint32_t serial;
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+};
+
+typedef struct props_area_s {
+    uint32_t magic;
+    _Atomic uint32_t serial;
+    _Atomic uint32_t count;
+    uint32_t reserved;
+    struct prop_info props[PROPS_FILE_MAX];
+} props_area_t;
+
+static props_area_t* g_area;
+static int g_area_writable;
+
+static const char* props_file_path(void)
+{
+    const char* path = getenv("PROPS_FILE");
+    return (path != NULL && path[0] != '\0') ? path : PROPS_FILE_PATH;
+}
+
+/* Maps the area on first use. Readers map it read-only, like apps do on Android */
+static props_area_t* props_file_area(int writable)
+{
+    if (g_area != NULL && (g_area_writable || !writable)) {
+        return g_area;
+    }
+
+    int fd = open(props_file_path(), (writable ? (O_RDWR | O_CREAT) : O_RDONLY) | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (writable && ftruncate(fd, sizeof(props_area_t)) < 0) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, sizeof(props_area_t), writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    props_area_t* area = map;
+    if (writable && area->magic != PROPS_FILE_MAGIC) {
+        area->magic = PROPS_FILE_MAGIC;     /* Fresh file, zero-filled by ftruncate */
+    }
+    if (area->magic != PROPS_FILE_MAGIC) {
+        munmap(map, sizeof(props_area_t));
+        return NULL;
+    }
+    /* A read-only mapping being upgraded stays mapped: prop_info pointers handed out remain valid */
+    g_area = area;
+    g_area_writable = writable;
+    return area;
+}
+
+const prop_info* props_file_find(const char* name)
+{
+    props_area_t* area = props_file_area(0);
+    if (area == NULL || name == NULL) {
+        return NULL;
+    }
+    uint32_t count = atomic_load_explicit(&area->count, memory_order_acquire);
+    for (uint32_t i = 0; i < count && i < PROPS_FILE_MAX; i++) {
+        if (strncmp(area->props[i].name, name, PROP_NAME_MAX) == 0) {
+            return &area->props[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t props_file_serial(const prop_info* pi)
+{
+    return (pi != NULL) ? atomic_load_explicit(&((struct prop_info*)pi)->serial, memory_order_acquire) : 0;
+}
+
+/* Seqlock read: retried until the serial is even and the same before and after the copy */
+static uint32_t props_file_copy(const prop_info* pi, char* value)
+{
+    struct prop_info* p = (struct prop_info*)pi;
+    for (;;) {
+        uint32_t before = atomic_load_explicit(&p->serial, memory_order_acquire);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(value, p->value, PROP_VALUE_MAX);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&p->serial, memory_order_relaxed) == before) {
+            value[PROP_VALUE_MAX - 1] = '\0';
+            return before;
+        }
+    }
+}
+
+int props_file_read(const prop_info* pi, prop_read_fn callback, void* cookie)
+{
+    char value[PROP_VALUE_MAX];
+    if (pi == NULL || callback == NULL) {
+        return -1;
+    }
+    uint32_t serial = props_file_copy(pi, value);
+    callback(cookie, pi->name, value, serial);
+    return 0;
+}
+
+int props_file_get(const char* name, char* value)
+{
+    const prop_info* pi = props_file_find(name);
+    if (pi == NULL) {
+        value[0] = '\0';
+        return 0;
+    }
+    props_file_copy(pi, value);
+    return (int)strlen(value);
+}
+
+uint32_t props_file_area_serial(void)
+{
+    props_area_t* area = props_file_area(0);
+    return (area != NULL) ? atomic_load_explicit(&area->serial, memory_order_acquire) : 0;
+}
+
+static long props_futex(_Atomic uint32_t* addr, int op, uint32_t val, const struct timespec* timeout)
+{
+    /* Not FUTEX_PRIVATE_FLAG: waiters and writers are different processes sharing the file */
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, timeout, NULL, 0);
+}
+
+int props_file_wait(const prop_info* pi, uint32_t old_serial, uint32_t* new_serial, uint32_t timeout_ms)
+{
+    props_area_t* area = props_file_area(0);
+    struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000 };
+    if (area == NULL) {
+        return 0;
+    }
+
+    _Atomic uint32_t* serial = (pi != NULL) ? &((struct prop_info*)pi)->serial : &area->serial;
+    for (;;) {
+        uint32_t current = atomic_load_explicit(serial, memory_order_acquire);
+        if (current != old_serial && !(current & 1)) {
+            if (new_serial != NULL) *new_serial = current;
+            return 1;
+        }
+        /* Relative timeout: restarted in full after a spurious wakeup, good enough for a stand-in */
+        if (props_futex(serial, FUTEX_WAIT, current, (timeout_ms != 0) ? &timeout : NULL) < 0
+            && errno == ETIMEDOUT) {
+            return 0;
+        }
+    }
+}
+
+int props_file_set(const char* name, const char* value)
+{
+    props_area_t* area = props_file_area(1);
+    if (area == NULL || name == NULL || value == NULL
+        || strlen(name) >= PROP_NAME_MAX || strlen(value) >= PROP_VALUE_MAX) {
+        return -1;
+    }
+
+    /* Writers serialize on the file, readers never take the lock */
+    int fd = open(props_file_path(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || flock(fd, LOCK_EX) < 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    int res = 0;
+    struct prop_info* p = (struct prop_info*)props_file_find(name);
+    if (p == NULL) {
+        uint32_t count = atomic_load_explicit(&area->count, memory_order_relaxed);
+        if (count >= PROPS_FILE_MAX) {
+            res = -1;
+            goto out;
+        }
+        p = &area->props[count];
+        memset(p, 0, sizeof(*p));
+        strncpy(p->name, name, PROP_NAME_MAX - 1);
+        strncpy(p->value, value, PROP_VALUE_MAX - 1);
+        atomic_store_explicit(&p->serial, 2, memory_order_relaxed);
+        atomic_store_explicit(&area->count, count + 1, memory_order_release);
+    } else {
+        uint32_t serial = atomic_load_explicit(&p->serial, memory_order_relaxed);
+        atomic_store_explicit(&p->serial, serial + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        memset(p->value, 0, PROP_VALUE_MAX);
+        strncpy(p->value, value, PROP_VALUE_MAX - 1);
+        atomic_store_explicit(&p->serial, serial + 2, memory_order_release);
+        props_futex(&p->serial, FUTEX_WAKE, INT_MAX, NULL);
+    }
+    atomic_fetch_add_explicit(&area->serial, 2, memory_order_release);
+    props_futex(&area->serial, FUTEX_WAKE, INT_MAX, NULL);
+
+out:
+    flock(fd, LOCK_UN);
+    close(fd);
+    return res;
+}
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "resident.h"
+
+#define RESIDENT_MAX_JOBS   16
+
+/* Counts through suspend, but doesn't wake the device for it: runs due while asleep happen on resume */
+#define RESIDENT_CLOCK      CLOCK_BOOTTIME
+
+static void resident_arm(resident_job_t* job, uint32_t delay_ms)
+{
+    struct itimerspec its = { 0 };
+    if (delay_ms == 0) {
+        delay_ms = 1;   /* A zero it_value would disarm the timer */
+    }
+    its.it_value.tv_sec = delay_ms / 1000;
+    its.it_value.tv_nsec = (long)(delay_ms % 1000) * 1000000;
+    timerfd_settime(job->fd, 0, &its, NULL);
+}
+
+static uint32_t resident_period_ms(const resident_job_t* job)
+{
+    uint32_t jitter = (job->jitter_ms != 0) ? (uint32_t)(random() % job->jitter_ms) : 0;
+    return job->interval_ms + jitter;
+}
+
+/* Time left before the job fires, UINT64_MAX if disarmed */
+static uint64_t resident_remaining_ms(const resident_job_t* job)
+{
+    struct itimerspec its;
+    if (timerfd_gettime(job->fd, &its) < 0 || (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)) {
+        return UINT64_MAX;
+    }
+    return (uint64_t)its.it_value.tv_sec * 1000 + (uint64_t)its.it_value.tv_nsec / 1000000;
+}
+
+static int resident_signal_fd(void)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    /* Blocked for the whole daemon; module children unblock SIGTERM again, see process.c */
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
+        return -1;
+    }
+    return signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+}
+
+ProjectStatus resident_loop(resident_job_t* jobs, size_t count, resident_run_fn run, void* cookie)
+{
+    struct pollfd pfds[RESIDENT_MAX_JOBS + 1];
+    ProjectStatus status = STATUS_SUCCESS;
+    size_t i = 0;
+
+    if (jobs == NULL || run == NULL || count == 0 || count > RESIDENT_MAX_JOBS) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    int sig_fd = resident_signal_fd();
+    if (sig_fd < 0) {
+        return STATUS_ERR_GENERIC;
+    }
+    srandom((unsigned)getpid() ^ (unsigned)time(NULL));
+    for (i = 0; i < count; i++) {
+        jobs[i].fd = timerfd_create(RESIDENT_CLOCK, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (jobs[i].fd < 0) {
+            status = STATUS_ERR_GENERIC;
+            goto out;
+        }
+        resident_arm(&jobs[i], jobs[i].first_run ? 0 : resident_period_ms(&jobs[i]));
+        pfds[i] = (struct pollfd){ .fd = jobs[i].fd, .events = POLLIN };
+    }
+    pfds[count] = (struct pollfd){ .fd = sig_fd, .events = POLLIN };
+
+    INFO("Resident mode: %d jobs", (int)count);
+    for (;;) {
+        if (poll(pfds, count + 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            status = STATUS_ERR_POLL;
+            break;
+        }
+        if (pfds[count].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(sig_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+                INFO("Resident mode: signal %d, stopping", (int)info.ssi_signo);
+            }
+            break;
+        }
+
+        /*
+         * Everything that fired (possibly several times during a long run: the expiration count
+         * is dropped, overlapping runs collapse into one) plus what would fire shortly.
+         */
+        uint32_t due = 0;
+        for (i = 0; i < count; i++) {
+            uint64_t expirations = 0;
+            int fired = (read(jobs[i].fd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations));
+            if (fired || resident_remaining_ms(&jobs[i]) <= RESIDENT_COALESCE_MS) {
+                due |= jobs[i].stages;
+                resident_arm(&jobs[i], resident_period_ms(&jobs[i]));
+            }
+        }
+        if (due == 0) {
+            continue;
+        }
+
+        /* Periods run from the start of a run: a slow run delays the next one, never doubles it */
+        DEBUG("Resident run: stages 0x%x", due);
+        if (run(due, cookie) != STATUS_SUCCESS) {
+            ERROR("Resident run failed (stages 0x%x)", due);
+        }
+    }
+
+out:
+    for (size_t j = 0; j < i && j < count; j++) {
+        close(jobs[j].fd);
+        jobs[j].fd = -1;
+    }
+    close(sig_fd);
+    return status;
+}
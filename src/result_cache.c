@@ -0,0 +1,206 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "result_cache.h"
+#include "file_utils.h"
+#include "symbol_resolver.h"
+
+#define RESULT_CACHE_MAGIC      0x52434348u     /* "RCCH" */
+#define RESULT_CACHE_VERSION    1
+
+#define SQLITE_HEADER_CHANGE_COUNTER    24      /* Big-endian u32, bumped by every commit outside WAL mode */
+
+/* Only the persisted part of result_cache_t goes to the file */
+#define RESULT_CACHE_FILE_SIZE  offsetof(result_cache_t, dirty)
+
+static uint64_t cache_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* FNV-1a, folding the fields of a change signal into one token */
+static uint64_t cache_mix(uint64_t hash, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t cache_mix_str(uint64_t hash, const char* str)
+{
+    for (; *str != '\0'; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t cache_mix_stat(uint64_t hash, const struct stat* st)
+{
+    hash = cache_mix(hash, (uint64_t)st->st_dev);
+    hash = cache_mix(hash, (uint64_t)st->st_ino);
+    hash = cache_mix(hash, (uint64_t)st->st_size);
+    hash = cache_mix(hash, (uint64_t)st->st_mtim.tv_sec);
+    return cache_mix(hash, (uint64_t)st->st_mtim.tv_nsec);
+}
+
+/*
+ * PRAGMA data_version would be the natural signal, but it is only comparable within a single
+ * connection. Across runs, the header's change counter covers rollback-journal commits and the
+ * WAL file's size and mtime cover commits not checkpointed yet.
+ */
+static ProjectStatus cache_sqlite_token(const char* path, uint64_t* token)
+{
+    unsigned char counter[4];
+    char wal_path[256];
+    struct stat st;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    ssize_t got = pread(fd, counter, sizeof(counter), SQLITE_HEADER_CHANGE_COUNTER);
+    close(fd);
+    if (got != (ssize_t)sizeof(counter)) {
+        return STATUS_ERR_READ_ERROR;
+    }
+    hash = cache_mix(hash, ((uint64_t)counter[0] << 24) | ((uint64_t)counter[1] << 16)
+                           | ((uint64_t)counter[2] << 8) | counter[3]);
+
+    snprintf(wal_path, sizeof(wal_path), "%s-wal", path);
+    if (stat(wal_path, &st) == 0) {
+        hash = cache_mix_stat(hash, &st);
+    }
+    *token = hash;
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus result_cache_token(const module_cache_t* policy, const props_snapshot_t* props, uint64_t* token)
+{
+    struct stat st;
+    uint32_t serial = 0;
+    char value[PROPS_VALUE_MAX] = "";
+    const props_entry_t* prop = NULL;
+
+    if (policy == NULL || token == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    switch (policy->signal) {
+    case CACHE_SIGNAL_NONE:
+        *token = 0;
+        return STATUS_SUCCESS;
+    case CACHE_SIGNAL_PROPERTY:
+        /*
+         * The serial alone repeats across boots for a property set once per boot (it starts from
+         * the value's length), so the value is part of the token too.
+         */
+        prop = (props != NULL) ? props_snapshot_find(props, policy->source) : NULL;
+        if (prop != NULL) {
+            if (prop->pi == NULL) {
+                return STATUS_ERR_GET_PROP;
+            }
+            serial = prop->serial;
+            strcpy(value, prop->value);
+        } else if (sal_get_property_serial(policy->source, &serial) != 0) {
+            return STATUS_ERR_GET_PROP;
+        } else {
+            sal_get_property(policy->source, value);
+        }
+        *token = cache_mix_str(cache_mix(0xcbf29ce484222325ull, serial), value);
+        return STATUS_SUCCESS;
+    case CACHE_SIGNAL_FILE:
+        if (stat(policy->source, &st) != 0) {
+            return STATUS_ERR_OPEN_ERROR;
+        }
+        *token = cache_mix_stat(0xcbf29ce484222325ull, &st);
+        return STATUS_SUCCESS;
+    case CACHE_SIGNAL_SQLITE:
+        return cache_sqlite_token(policy->source, token);
+    }
+    return STATUS_ERR_INVALID_ARG;
+}
+
+void result_cache_load(result_cache_t* cache, const char* path)
+{
+    memset(cache, 0, sizeof(*cache));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t got = read(fd, cache, RESULT_CACHE_FILE_SIZE);
+        close(fd);
+        if (got == (ssize_t)RESULT_CACHE_FILE_SIZE && cache->magic == RESULT_CACHE_MAGIC
+            && cache->version == RESULT_CACHE_VERSION) {
+            cache->dirty = 0;
+            return;
+        }
+    }
+    /* Missing, truncated, or another layout (e.g. MODULE_COUNT changed): start over */
+    memset(cache, 0, sizeof(*cache));
+    cache->magic = RESULT_CACHE_MAGIC;
+    cache->version = RESULT_CACHE_VERSION;
+}
+
+ProjectStatus result_cache_save(result_cache_t* cache, const char* path)
+{
+    if (cache == NULL || path == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (!cache->dirty) {
+        return STATUS_SUCCESS;
+    }
+
+    ProjectStatus status = write_file_atomic(path, cache, RESULT_CACHE_FILE_SIZE);
+    if (status == STATUS_SUCCESS) {
+        cache->dirty = 0;
+    }
+    return status;
+}
+
+int result_cache_lookup(const result_cache_t* cache, int mod_id, const module_cache_t* policy, uint64_t token,
+                        char* out, size_t out_size)
+{
+    if (cache == NULL || policy == NULL || out == NULL || mod_id < 0 || mod_id >= MODULE_COUNT) {
+        return 0;
+    }
+
+    const result_cache_entry_t* entry = &cache->entries[mod_id];
+    uint64_t now = cache_now_ms();
+    if (!entry->valid || entry->token != token || entry->len >= out_size
+        || now < entry->stored_ms || now - entry->stored_ms >= policy->ttl_ms) {
+        return 0;
+    }
+    memcpy(out, entry->data, entry->len);
+    out[entry->len] = '\0';
+    return 1;
+}
+
+void result_cache_store(result_cache_t* cache, int mod_id, uint64_t token, const char* data)
+{
+    if (cache == NULL || data == NULL || mod_id < 0 || mod_id >= MODULE_COUNT) {
+        return;
+    }
+
+    result_cache_entry_t* entry = &cache->entries[mod_id];
+    size_t len = strlen(data);
+    if (len >= RESULT_CACHE_DATA_MAX) {
+        entry->valid = 0;   /* Too large to cache: make sure a stale entry isn't served either */
+        cache->dirty = 1;
+        return;
+    }
+    entry->valid = 1;
+    entry->len = (uint32_t)len;
+    entry->stored_ms = cache_now_ms();
+    entry->token = token;
+    memcpy(entry->data, data, len + 1);
+    cache->dirty = 1;
+}
@@ -2,116 +2,371 @@
 #include <stddef.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 
+#include "common.h"
 #include "symbol_resolver.h"
+#if CONFIG_SAL_PROPS_FILE
+#include "props_file.h"
+#endif
 
 #define SQLITE_OPEN_READWRITE 0x00000002
+#define SQLITE_STATIC ((void(*)(void*))0)
 
-typedef struct {
-    void* h_log;
-    void* h_c;
-    void* h_sel;
-    void* h_sql;
-
-    // Function Pointers
-    pfn_android_log_print   log;
-    pfn_system_property_get prop;
-    pfn_setcon              setcon;
-    pfn_sqlite3_open_v2     sql_open;
-    pfn_sqlite3_exec        sql_exec;
-    pfn_sqlite3_close       sql_close;
-    pfn_sqlite3_free        sql_free;
-    
-    int init;
-} SalContext;
-
-static SalContext g_ctx = {0};
+// --- Symbol Table ---
+// X(library, symbol, signature, field): the only place a new symbol has to be added.
+#define SAL_SYMBOLS(X) \
+    X(SAL_LIB_LOG,     __android_log_print,    pfn_android_log_print,      log) \
+    X(SAL_LIB_C,       __system_property_get,  pfn_system_property_get,    prop) \
+    X(SAL_LIB_C,       __system_property_find, pfn_system_property_find,   prop_find) \
+    X(SAL_LIB_C,       __system_property_serial, pfn_system_property_serial, prop_serial) \
+    X(SAL_LIB_C,       __system_property_read_callback, pfn_system_property_read_callback, prop_read) \
+    X(SAL_LIB_C,       __system_property_wait, pfn_system_property_wait,   prop_wait) \
+    X(SAL_LIB_C,       __system_property_area_serial, pfn_system_property_area_serial, prop_area_serial) \
+    X(SAL_LIB_SELINUX, setcon,                 pfn_setcon,                 setcon) \
+    X(SAL_LIB_SQLITE,  sqlite3_open_v2,        pfn_sqlite3_open_v2,        sql_open) \
+    X(SAL_LIB_SQLITE,  sqlite3_exec,           pfn_sqlite3_exec,           sql_exec) \
+    X(SAL_LIB_SQLITE,  sqlite3_close,          pfn_sqlite3_close,          sql_close) \
+    X(SAL_LIB_SQLITE,  sqlite3_free,           pfn_sqlite3_free,           sql_free) \
+    X(SAL_LIB_SQLITE,  sqlite3_prepare_v2,     pfn_sqlite3_prepare_v2,     sql_prepare) \
+    X(SAL_LIB_SQLITE,  sqlite3_bind_int64,     pfn_sqlite3_bind_int64,     sql_bind_int64) \
+    X(SAL_LIB_SQLITE,  sqlite3_bind_text,      pfn_sqlite3_bind_text,      sql_bind_text) \
+    X(SAL_LIB_SQLITE,  sqlite3_bind_null,      pfn_sqlite3_bind_null,      sql_bind_null) \
+    X(SAL_LIB_SQLITE,  sqlite3_step,           pfn_sqlite3_step,           sql_step) \
+    X(SAL_LIB_SQLITE,  sqlite3_reset,          pfn_sqlite3_reset,          sql_reset) \
+    X(SAL_LIB_SQLITE,  sqlite3_clear_bindings, pfn_sqlite3_clear_bindings, sql_clear_bindings) \
+    X(SAL_LIB_SQLITE,  sqlite3_finalize,       pfn_sqlite3_finalize,       sql_finalize) \
+    X(SAL_LIB_SQLITE,  sqlite3_column_int64,   pfn_sqlite3_column_int64,   sql_column_int64) \
+    X(SAL_LIB_SQLITE,  sqlite3_column_text,    pfn_sqlite3_column_text,    sql_column_text) \
+    X(SAL_LIB_SQLITE,  sqlite3_busy_timeout,   pfn_sqlite3_busy_timeout,   sql_busy_timeout) \
+    X(SAL_LIB_SQLITE,  sqlite3_changes,        pfn_sqlite3_changes,        sql_changes)
 
-int sal_init(void) {
-    if (g_ctx.init) return 0;
-    
-    // 1. Logging
-    g_ctx.h_log = dlopen("liblog.so", RTLD_LAZY);
-    if (g_ctx.h_log) g_ctx.log = (pfn_android_log_print)dlsym(g_ctx.h_log, "__android_log_print");
-
-    // 2. Libc
-    g_ctx.h_c = dlopen("libc.so", RTLD_LAZY);
-    if (g_ctx.h_c) g_ctx.prop = (pfn_system_property_get)dlsym(g_ctx.h_c, "__system_property_get");
-
-    // 3. SELinux
-    g_ctx.h_sel = dlopen("libselinux.so", RTLD_LAZY);
-    if (g_ctx.h_sel) g_ctx.setcon = (pfn_setcon)dlsym(g_ctx.h_sel, "setcon");
-
-    // 4. SQLite
-    g_ctx.h_sql = dlopen("libsqlite.so", RTLD_LAZY);
-    if (!g_ctx.h_sql) g_ctx.h_sql = dlopen("libsqlite3.so", RTLD_LAZY); // Fallback
-    
-    if (g_ctx.h_sql) {
-        g_ctx.sql_open  = (pfn_sqlite3_open_v2)dlsym(g_ctx.h_sql, "sqlite3_open_v2");
-        g_ctx.sql_exec  = (pfn_sqlite3_exec)dlsym(g_ctx.h_sql, "sqlite3_exec");
-        g_ctx.sql_close = (pfn_sqlite3_close)dlsym(g_ctx.h_sql, "sqlite3_close");
-        g_ctx.sql_free  = (pfn_sqlite3_free)dlsym(g_ctx.h_sql, "sqlite3_free");
+typedef enum {
+#define SAL_SYM_ENUM(lib, sym, type, field) SAL_SYM_##field,
+    SAL_SYMBOLS(SAL_SYM_ENUM)
+#undef SAL_SYM_ENUM
+    SAL_SYM_COUNT
+} SalSymbol;
+
+// Resolved: function pointer. Not resolved yet: NULL. Looked up and not found: SAL_MISSING.
+#define SAL_MISSING ((void*)1)
+
+static _Atomic(void*) g_sym[SAL_SYM_COUNT];
+
+#if CONFIG_SAL_STATIC_LINK
+
+// Linked in directly: weak references are NULL for whatever the target does not provide.
+#define SAL_SYM_EXTERN(lib, sym, type, field) extern __typeof__(*(type)0) sym __attribute__((weak));
+SAL_SYMBOLS(SAL_SYM_EXTERN)
+#undef SAL_SYM_EXTERN
+
+static void* sal_lookup(SalSymbol id) {
+    static void* const table[SAL_SYM_COUNT] = {
+#define SAL_SYM_ADDR(lib, sym, type, field) [SAL_SYM_##field] = (void*)sym,
+        SAL_SYMBOLS(SAL_SYM_ADDR)
+#undef SAL_SYM_ADDR
+    };
+    return table[id];
+}
+
+#else
+
+typedef enum {
+    SAL_LIB_LOG = 0,
+    SAL_LIB_C,
+    SAL_LIB_SELINUX,
+    SAL_LIB_SQLITE,
+    SAL_LIB_COUNT
+} SalLibrary;
+
+// Candidates are tried in order
+static const char* const g_lib_names[SAL_LIB_COUNT][2] = {
+    [SAL_LIB_LOG]     = { "liblog.so",     NULL },
+    [SAL_LIB_C]       = { "libc.so",       NULL },
+    [SAL_LIB_SELINUX] = { "libselinux.so", NULL },
+    [SAL_LIB_SQLITE]  = { "libsqlite.so",  "libsqlite3.so" },
+};
+
+static const struct {
+    SalLibrary lib;
+    const char* name;
+} g_sym_info[SAL_SYM_COUNT] = {
+#define SAL_SYM_INFO(lib, sym, type, field) [SAL_SYM_##field] = { lib, #sym },
+    SAL_SYMBOLS(SAL_SYM_INFO)
+#undef SAL_SYM_INFO
+};
+
+static _Atomic(void*) g_lib[SAL_LIB_COUNT];
+
+static void* sal_library(SalLibrary lib) {
+    void* handle = atomic_load_explicit(&g_lib[lib], memory_order_acquire);
+    if (handle != NULL) return (handle != SAL_MISSING) ? handle : NULL;
+
+    handle = NULL;
+    for (size_t i = 0; i < 2 && handle == NULL && g_lib_names[lib][i] != NULL; i++) {
+        handle = dlopen(g_lib_names[lib][i], RTLD_LAZY);
+    }
+
+    // A concurrent opener may have won: dlopen is refcounted and nothing is dlclose()d, so just use theirs
+    void* expected = NULL;
+    void* published = (handle != NULL) ? handle : SAL_MISSING;
+    if (!atomic_compare_exchange_strong_explicit(&g_lib[lib], &expected, published,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        published = expected;
+    }
+    return (published != SAL_MISSING) ? published : NULL;
+}
+
+static void* sal_lookup(SalSymbol id) {
+    void* handle = sal_library(g_sym_info[id].lib);
+    return (handle != NULL) ? dlsym(handle, g_sym_info[id].name) : NULL;
+}
+
+#endif // CONFIG_SAL_STATIC_LINK
+
+// Resolves a symbol on first use and publishes it once, later calls are a single acquire load
+static void* sal_resolve(SalSymbol id) {
+    void* fn = atomic_load_explicit(&g_sym[id], memory_order_acquire);
+    if (fn == NULL) {
+        void* expected = NULL;
+        void* found = sal_lookup(id);
+        fn = (found != NULL) ? found : SAL_MISSING;
+        if (!atomic_compare_exchange_strong_explicit(&g_sym[id], &expected, fn,
+                                                     memory_order_acq_rel, memory_order_acquire)) {
+            fn = expected;
+        }
     }
+    return (fn != SAL_MISSING) ? fn : NULL;
+}
+
+// Typed accessors: sal_fn_sql_exec() etc. Return NULL if the symbol is not available.
+#define SAL_SYM_ACCESSOR(lib, sym, type, field) \
+    static inline type sal_fn_##field(void) { return (type)sal_resolve(SAL_SYM_##field); }
+SAL_SYMBOLS(SAL_SYM_ACCESSOR)
+#undef SAL_SYM_ACCESSOR
 
-    g_ctx.init = 1;
+int sal_init(void) {
+    // Nothing is loaded up front: each library is opened by the first call that needs it,
+    // so forked children only map what their module actually uses.
     return 0;
 }
 
 void sal_cleanup(void) {
     // Note: System libraries are NOT dlclose()d to prevent crashes
     // involving atexit handlers in unmapped memory.
-    g_ctx.init = 0;
 }
 
 // --- System Wrappers ---
 
 void sal_log_info(const char* fmt, ...) {
+    pfn_android_log_print log = sal_fn_log();
     char buf[1024];
     va_list args;
     va_start(args, fmt);
     vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
 
-    if (g_ctx.log) g_ctx.log(4, "LOGGER", "%s", buf);
+    if (log) log(4, "LOGGER", "%s", buf);
     else printf("[INFO] %s\n", buf);
 }
 
 void sal_log_error(const char* fmt, ...) {
+    pfn_android_log_print log = sal_fn_log();
     char buf[1024];
     va_list args;
     va_start(args, fmt);
     vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
 
-    if (g_ctx.log) g_ctx.log(6, "LOGGER", "%s", buf);
+    if (log) log(6, "LOGGER", "%s", buf);
     else fprintf(stderr, "[ERROR] %s\n", buf);
 }
 
 int sal_get_property(const char* key, char* value) {
-    return (g_ctx.prop) ? g_ctx.prop(key, value) : 0;
+#if CONFIG_SAL_PROPS_FILE
+    return props_file_get(key, value);
+#else
+    pfn_system_property_get prop = sal_fn_prop();
+    return (prop) ? prop(key, value) : 0;
+#endif
+}
+
+int sal_get_property_serial(const char* key, uint32_t* serial) {
+    const prop_info* pi = sal_property_find(key);
+    if (pi == NULL) return -1;
+    *serial = sal_property_serial(pi);
+    return 0;
+}
+
+// --- Property Wrappers ---
+
+#if CONFIG_SAL_PROPS_FILE
+
+const prop_info* sal_property_find(const char* name) {
+    return props_file_find(name);
+}
+
+uint32_t sal_property_serial(const prop_info* pi) {
+    return props_file_serial(pi);
+}
+
+int sal_property_read(const prop_info* pi, prop_read_fn callback, void* cookie) {
+    return props_file_read(pi, callback, cookie);
 }
 
+uint32_t sal_property_area_serial(void) {
+    return props_file_area_serial();
+}
+
+int sal_property_wait(const prop_info* pi, uint32_t old_serial, uint32_t* new_serial, uint32_t timeout_ms) {
+    return props_file_wait(pi, old_serial, new_serial, timeout_ms);
+}
+
+#else
+
+const prop_info* sal_property_find(const char* name) {
+    pfn_system_property_find find = sal_fn_prop_find();
+    return (find) ? find(name) : NULL;
+}
+
+uint32_t sal_property_serial(const prop_info* pi) {
+    pfn_system_property_serial get_serial = sal_fn_prop_serial();
+    return (get_serial && pi) ? get_serial(pi) : 0;
+}
+
+int sal_property_read(const prop_info* pi, prop_read_fn callback, void* cookie) {
+    pfn_system_property_read_callback read_cb = sal_fn_prop_read();
+    if (!read_cb || !pi) return -1;
+    read_cb(pi, callback, cookie);
+    return 0;
+}
+
+uint32_t sal_property_area_serial(void) {
+    pfn_system_property_area_serial area_serial = sal_fn_prop_area_serial();
+    return (area_serial) ? area_serial() : 0;
+}
+
+int sal_property_wait(const prop_info* pi, uint32_t old_serial, uint32_t* new_serial, uint32_t timeout_ms) {
+    pfn_system_property_wait wait = sal_fn_prop_wait();
+    struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000 };
+    if (!wait) return 0;
+    return wait(pi, old_serial, new_serial, (timeout_ms != 0) ? &timeout : NULL) ? 1 : 0;
+}
+
+#endif // CONFIG_SAL_PROPS_FILE
+
 int sal_set_selinux_context(const char* context) {
-    return (g_ctx.setcon) ? g_ctx.setcon(context) : -1;
+    pfn_setcon setcon = sal_fn_setcon();
+    return (setcon) ? setcon(context) : -1;
 }
 
 // --- SQLite Wrappers ---
 
 int sal_sqlite_open(const char* path, sqlite3** ppDb) {
-    if (g_ctx.sql_open) return g_ctx.sql_open(path, ppDb, SQLITE_OPEN_READWRITE, NULL);
+    pfn_sqlite3_open_v2 sql_open = sal_fn_sql_open();
+    if (sql_open) return sql_open(path, ppDb, SQLITE_OPEN_READWRITE, NULL);
     return -1;
 }
 
 int sal_sqlite_exec(sqlite3* db, const char* sql, char** errmsg) {
-    if (g_ctx.sql_exec) return g_ctx.sql_exec(db, sql, NULL, NULL, errmsg);
+    pfn_sqlite3_exec sql_exec = sal_fn_sql_exec();
+    if (sql_exec) return sql_exec(db, sql, NULL, NULL, errmsg);
     return -1;
 }
 
+static int sal_first_column_cb(void* out, int argc, char** argv, char** cols) {
+    (void)cols;
+    if (argc > 0 && argv[0] != NULL) *(long long*)out = strtoll(argv[0], NULL, 10);
+    return 0;
+}
+
+// Runs a single-value query (PRAGMA, SELECT changes(), ...) and returns its first column
+int sal_sqlite_query_int(sqlite3* db, const char* sql, long long* out) {
+    pfn_sqlite3_exec sql_exec = sal_fn_sql_exec();
+    if (!sql_exec || out == NULL) return -1;
+    *out = 0;
+    return sql_exec(db, sql, sal_first_column_cb, out, NULL);
+}
+
 int sal_sqlite_close(sqlite3* db) {
-    if (g_ctx.sql_close) return g_ctx.sql_close(db);
+    pfn_sqlite3_close sql_close = sal_fn_sql_close();
+    if (sql_close) return sql_close(db);
     return -1;
 }
 
 void sal_sqlite_free(void* ptr) {
-    if (g_ctx.sql_free) g_ctx.sql_free(ptr);
-}
\ No newline at end of file
+    pfn_sqlite3_free sql_free = sal_fn_sql_free();
+    if (sql_free) sql_free(ptr);
+}
+
+// --- SQLite Prepared Statements ---
+
+int sal_sqlite_prepare(sqlite3* db, const char* sql, sqlite3_stmt** ppStmt) {
+    pfn_sqlite3_prepare_v2 sql_prepare = sal_fn_sql_prepare();
+    if (sql_prepare) return sql_prepare(db, sql, -1, ppStmt, NULL);
+    return -1;
+}
+
+int sal_sqlite_bind_int64(sqlite3_stmt* stmt, int idx, long long value) {
+    pfn_sqlite3_bind_int64 sql_bind_int64 = sal_fn_sql_bind_int64();
+    if (sql_bind_int64) return sql_bind_int64(stmt, idx, value);
+    return -1;
+}
+
+int sal_sqlite_bind_text(sqlite3_stmt* stmt, int idx, const char* value, int len) {
+    pfn_sqlite3_bind_text sql_bind_text = sal_fn_sql_bind_text();
+    if (sql_bind_text) return sql_bind_text(stmt, idx, value, len, SQLITE_STATIC);
+    return -1;
+}
+
+int sal_sqlite_bind_null(sqlite3_stmt* stmt, int idx) {
+    pfn_sqlite3_bind_null sql_bind_null = sal_fn_sql_bind_null();
+    if (sql_bind_null) return sql_bind_null(stmt, idx);
+    return -1;
+}
+
+int sal_sqlite_step(sqlite3_stmt* stmt) {
+    pfn_sqlite3_step sql_step = sal_fn_sql_step();
+    if (sql_step) return sql_step(stmt);
+    return -1;
+}
+
+int sal_sqlite_reset(sqlite3_stmt* stmt) {
+    pfn_sqlite3_reset sql_reset = sal_fn_sql_reset();
+    if (sql_reset) return sql_reset(stmt);
+    return -1;
+}
+
+int sal_sqlite_clear_bindings(sqlite3_stmt* stmt) {
+    pfn_sqlite3_clear_bindings sql_clear_bindings = sal_fn_sql_clear_bindings();
+    if (sql_clear_bindings) return sql_clear_bindings(stmt);
+    return -1;
+}
+
+int sal_sqlite_finalize(sqlite3_stmt* stmt) {
+    pfn_sqlite3_finalize sql_finalize = sal_fn_sql_finalize();
+    if (sql_finalize) return sql_finalize(stmt);
+    return -1;
+}
+
+long long sal_sqlite_column_int64(sqlite3_stmt* stmt, int col) {
+    pfn_sqlite3_column_int64 sql_column_int64 = sal_fn_sql_column_int64();
+    return (sql_column_int64) ? sql_column_int64(stmt, col) : 0;
+}
+
+const char* sal_sqlite_column_text(sqlite3_stmt* stmt, int col) {
+    pfn_sqlite3_column_text sql_column_text = sal_fn_sql_column_text();
+    return (sql_column_text) ? (const char*)sql_column_text(stmt, col) : NULL;
+}
+
+int sal_sqlite_busy_timeout(sqlite3* db, int ms) {
+    pfn_sqlite3_busy_timeout sql_busy_timeout = sal_fn_sql_busy_timeout();
+    if (sql_busy_timeout) return sql_busy_timeout(db, ms);
+    return -1;
+}
+
+int sal_sqlite_changes(sqlite3* db) {
+    pfn_sqlite3_changes sql_changes = sal_fn_sql_changes();
+    return (sql_changes) ? sql_changes(db) : 0;
+}
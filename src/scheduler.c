@@ -0,0 +1,759 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+
+#include "scheduler.h"
+#include "process.h"
+#include "modules.h"
+#include "ipc.h"
+#include "worker_pool.h"
+#include "latency.h"
+#include "result_cache.h"
+
+/* Every in-flight stage contributes at most two fds (IPC channel, pidfd), every exiting domain process one */
+#define SCHED_MAX_FDS   (SCHED_MAX_STAGES * 3)
+
+/*
+ * Process serving every stage of the run whose module shares its security domain, one at a time.
+ * Lives from the first of those stages to the last: spawned, credentialed and reaped only once.
+ */
+typedef struct sched_domain_s {
+    const module_config_t* config;  /* Module the process was sandboxed as */
+    pid_t pid;                      /* -1 once reaped */
+    int pidfd;
+    int fd;                         /* -1 once closed, the process exits on EOF */
+    int busy;                       /* Index of the stage in flight, -1 when idle */
+    int killed;
+    uint64_t deadline_ms;           /* Exit deadline, once closed */
+    process_usage_t usage;
+} sched_domain_t;
+
+typedef struct sched_run_s {
+    sched_stage_t* stages;
+    size_t count;
+    daemon_context_t* ctx;
+    worker_pool_t* pool;
+    uint32_t done_mask;
+    int critical_failed;            /* A stage of a 'critical' module ended in failure */
+    uint64_t collect_deadline_ms;   /* Stages not flagged 'always' are cancelled from then on */
+    sched_domain_t domains[SCHED_MAX_STAGES];
+    size_t domain_count;
+} sched_run_t;
+
+static uint64_t sched_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t sched_now_ms(void)
+{
+    return sched_now_ns() / 1000000;
+}
+
+uint64_t sched_clock_ms(void)
+{
+    return sched_now_ms();
+}
+
+static void sched_record_phase(latency_stats_t* stats, int mod_id, latency_phase_e phase, uint64_t from_ns,
+                               uint64_t to_ns)
+{
+    if (from_ns != 0 && to_ns >= from_ns) {
+        latency_record(stats, mod_id, phase, (to_ns - from_ns) / 1000);
+    }
+}
+
+/* Splits the stage's wall time into phases. Phases a failed stage never reached are skipped */
+static void sched_record_latency(sched_run_t* run, const sched_stage_t* stage, uint64_t done_ns)
+{
+    latency_stats_t* stats = run->ctx->latency;
+    const ipc_timing_t* t = &stage->timing;
+    if (stats == NULL || stage->t_start_ns == 0) {
+        return;
+    }
+
+    if (stage->t_response_ns != 0) {
+        sched_record_phase(stats, stage->mod_id, LAT_PHASE_DISPATCH, stage->t_start_ns, t->start_ns);
+        if (t->ready_ns != t->start_ns) {
+            /* Warm workers are sandboxed once, at pre-fork: nothing to record per request */
+            sched_record_phase(stats, stage->mod_id, LAT_PHASE_SANDBOX, t->start_ns, t->ready_ns);
+        }
+        sched_record_phase(stats, stage->mod_id, LAT_PHASE_BODY, t->ready_ns, t->sent_ns);
+        sched_record_phase(stats, stage->mod_id, LAT_PHASE_IPC, t->sent_ns, stage->t_response_ns);
+        sched_record_phase(stats, stage->mod_id, LAT_PHASE_REAP, stage->t_response_ns, done_ns);
+    }
+    sched_record_phase(stats, stage->mod_id, LAT_PHASE_TOTAL, stage->t_start_ns, done_ns);
+}
+
+static uint32_t sched_exit_timeout_ms(const module_config_t* config)
+{
+    return (config != NULL && config->exit_timeout_ms != 0) ? config->exit_timeout_ms : TIMEOUT_EXIT_MS;
+}
+
+/* Response budget of one attempt: the module's declared timeout, or one derived from its history */
+static uint32_t sched_response_timeout_ms(const sched_run_t* run, const module_config_t* config)
+{
+    uint32_t timeout = (config->timeout_ms != 0) ? config->timeout_ms : TIMEOUT_IPC_MS;
+    if (!CONFIG_ADAPTIVE_DEADLINE) {
+        return timeout;
+    }
+
+    uint64_t bound_us = latency_response_bound_us(run->ctx->latency, config->id, ADAPTIVE_DEADLINE_PCT,
+                                                  ADAPTIVE_MIN_SAMPLES);
+    if (bound_us == 0) {
+        return timeout;     /* Not enough history yet */
+    }
+    uint64_t ceiling = (config->timeout_max_ms != 0) ? config->timeout_max_ms : timeout;
+    uint64_t adaptive = bound_us * ADAPTIVE_DEADLINE_FACTOR / 1000;
+    if (adaptive < ADAPTIVE_DEADLINE_MIN_MS) adaptive = ADAPTIVE_DEADLINE_MIN_MS;
+    if (adaptive > ceiling) adaptive = ceiling;
+    return (uint32_t)adaptive;
+}
+
+/* Declared worst case of a stage: response plus exit budget of its module */
+static uint64_t sched_stage_cost_ms(const sched_stage_t* stage)
+{
+    const module_config_t* config = get_module_config(stage->mod_id);
+    if (config == NULL) {
+        return 0;
+    }
+    return ((config->timeout_ms != 0) ? config->timeout_ms : TIMEOUT_IPC_MS) + sched_exit_timeout_ms(config);
+}
+
+/* Longest declared cost from stage 'idx' down its pending dependents, counting stages whose 'always' matches */
+static uint64_t sched_chain_ms(const sched_run_t* run, size_t idx, int always)
+{
+    uint64_t tail = 0;
+    for (size_t j = 0; j < run->count; j++) {
+        if ((run->stages[j].deps & STAGE_BIT(idx)) && run->stages[j].state == STAGE_PENDING) {
+            uint64_t chain = sched_chain_ms(run, j, always);
+            if (chain > tail) tail = chain;
+        }
+    }
+    return ((!!run->stages[idx].always == always) ? sched_stage_cost_ms(&run->stages[idx]) : 0) + tail;
+}
+
+/*
+ * Response deadline of an attempt. Under a run deadline, a collection stage gets at most its share
+ * of the time left before the collection deadline, in proportion of its cost along the longest
+ * chain of pending stages through it. 'always' stages are only bounded by the run deadline, and
+ * are cancelled like the others when they reach it.
+ */
+static uint64_t sched_attempt_deadline_ms(const sched_run_t* run, sched_stage_t* stage,
+                                          const module_config_t* config, uint64_t now)
+{
+    uint64_t deadline = now + sched_response_timeout_ms(run, config);
+    if (run->ctx->deadline_ms == 0) {
+        return deadline;
+    }
+
+    if (stage->always) {
+        if (run->ctx->deadline_ms < deadline) {
+            stage->cut_short = 1;
+            deadline = run->ctx->deadline_ms;
+        }
+        return deadline;
+    }
+    uint64_t left = (run->collect_deadline_ms > now) ? run->collect_deadline_ms - now : 0;
+    uint64_t chain = sched_chain_ms(run, (size_t)(stage - run->stages), 0);
+    uint64_t share = (chain != 0) ? left * sched_stage_cost_ms(stage) / chain : left;
+    if (now + share < deadline) {
+        /* Running out of run time is not the module's fault: it is cancelled, not timed out */
+        stage->cut_short = 1;
+        deadline = now + share;
+    }
+    return deadline;
+}
+
+/* Failures a fresh process may not run into again. Errors the module reported are final */
+static int sched_is_transient(ProjectStatus status)
+{
+    return status == STATUS_ERR_TIMEOUT || status == STATUS_ERR_IPC_RECV || status == STATUS_ERR_FORK;
+}
+
+/* Per-attempt state, cleared before the first attempt and before every retry */
+static void sched_reset_attempt(sched_stage_t* stage)
+{
+    stage->pid = -1;
+    stage->pidfd = -1;
+    stage->fd = -1;
+    stage->pooled = 0;
+    stage->domain = -1;
+    stage->killed = 0;
+    stage->cut_short = 0;
+    stage->cancelling = 0;
+    stage->t_start_ns = 0;
+    stage->t_response_ns = 0;
+    stage->timing = (ipc_timing_t){ 0 };
+    stage->usage = (process_usage_t){ 0 };
+    stage->cache = STAGE_CACHE_NONE;
+    stage->out_len = 0;
+}
+
+/* Non-zero if a stage other than 'skip' still has to run in the domain of 'config' */
+static int sched_domain_wanted(const sched_run_t* run, const module_config_t* config, const sched_stage_t* skip)
+{
+    for (size_t i = 0; i < run->count; i++) {
+        const sched_stage_t* other = &run->stages[i];
+        if (other != skip && other->state != STAGE_DONE && module_same_domain(config, get_module_config(other->mod_id))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Live (not closed) process of the domain of 'config', NULL if there is none */
+static sched_domain_t* sched_find_domain(sched_run_t* run, const module_config_t* config)
+{
+    for (size_t i = 0; i < run->domain_count; i++) {
+        sched_domain_t* domain = &run->domains[i];
+        if (domain->pid > 0 && domain->fd >= 0 && module_same_domain(domain->config, config)) {
+            return domain;
+        }
+    }
+    return NULL;
+}
+
+static void sched_domain_reaped(sched_domain_t* domain)
+{
+    if (domain->pidfd >= 0) {
+        close(domain->pidfd);
+        domain->pidfd = -1;
+    }
+    if (domain->usage.valid) {
+        INFO("Domain process %d (%s) usage: cpu %llu us, maxrss %ld KiB", domain->pid, domain->config->name,
+             (unsigned long long)(domain->usage.utime_us + domain->usage.stime_us), domain->usage.maxrss_kb);
+    }
+    domain->pid = -1;
+}
+
+/*
+ * An idle process is told to exit (IPC_OP_EXIT), it does not wait for EOF on its socket. One in
+ * an unknown state is killed.
+ */
+static void sched_close_domain(sched_domain_t* domain, int force)
+{
+    if (domain->fd >= 0) {
+        if (!force && ipc_send_request(domain->fd, IPC_OP_EXIT, -1, NULL, 0) != STATUS_SUCCESS) {
+            force = 1;
+        }
+        close(domain->fd);
+        domain->fd = -1;
+    }
+    domain->busy = -1;
+    if (force && !domain->killed) {
+        kill(domain->pid, SIGKILL);
+        domain->killed = 1;
+    }
+    domain->deadline_ms = sched_now_ms() + sched_exit_timeout_ms(domain->config);
+    if (domain->pidfd < 0) {
+        /* No pidfd on this kernel: reap synchronously */
+        wait_for_process_exit(domain->pid, &domain->usage);
+        sched_domain_reaped(domain);
+    }
+}
+
+/* Called when the pidfd of a closed domain process fired or its exit deadline passed */
+static void sched_handle_domain_exit(sched_domain_t* domain, int exited, uint64_t now)
+{
+    if (exited && reap_process(domain->pid, &domain->usage) == STATUS_SUCCESS) {
+        sched_domain_reaped(domain);
+        return;
+    }
+    if (now < domain->deadline_ms) {
+        return;
+    }
+    if (!domain->killed) {
+        ERROR("Domain process %d timed out. Sending SIGKILL.", domain->pid);
+        kill(domain->pid, SIGKILL);
+        domain->killed = 1;
+        domain->deadline_ms = now + sched_exit_timeout_ms(domain->config);
+        return;
+    }
+    ERROR("CRITICAL: Domain process %d (%s) is a Zombie.", domain->pid, domain->config->name);
+    sched_domain_reaped(domain);
+}
+
+/* Idle processes no pending stage will use anymore are closed, so they exit while the run goes on */
+static void sched_retire_domains(sched_run_t* run)
+{
+    for (size_t i = 0; i < run->domain_count; i++) {
+        sched_domain_t* domain = &run->domains[i];
+        if (domain->pid > 0 && domain->fd >= 0 && domain->busy < 0 && !sched_domain_wanted(run, domain->config, NULL)) {
+            sched_close_domain(domain, 0);
+        }
+    }
+}
+
+static int sched_domains_alive(const sched_run_t* run)
+{
+    for (size_t i = 0; i < run->domain_count; i++) {
+        if (run->domains[i].pid > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* A ready stage whose domain process is serving another stage waits for its turn */
+static int sched_domain_busy(sched_run_t* run, const sched_stage_t* stage)
+{
+    const sched_domain_t* domain = CONFIG_STAGE_FUSION ? sched_find_domain(run, get_module_config(stage->mod_id)) : NULL;
+    return domain != NULL && domain->busy >= 0;
+}
+
+/*
+ * Hands the stage to its domain's process. The process is forked on the first stage of a domain
+ * that has more stages left in the run; a domain with a single stage forks per stage as usual.
+ */
+static int sched_dispatch_fused(sched_run_t* run, sched_stage_t* stage, const module_config_t* config)
+{
+    if (!CONFIG_STAGE_FUSION) {
+        return 0;
+    }
+
+    sched_domain_t* domain = sched_find_domain(run, config);
+    if (domain == NULL) {
+        if (run->domain_count >= SCHED_MAX_STAGES || !sched_domain_wanted(run, config, stage)) {
+            return 0;
+        }
+        domain = &run->domains[run->domain_count];
+        domain->pid = spawn_module_worker(config, &domain->fd);
+        if (domain->pid < 0) {
+            return 0;
+        }
+        run->domain_count++;
+        domain->config = config;
+        domain->pidfd = open_process_fd(domain->pid);
+        domain->busy = -1;
+        domain->killed = 0;
+        domain->usage = (process_usage_t){ 0 };
+        INFO("Domain process for %s started (pid %d)", config->name, domain->pid);
+    }
+
+    if (ipc_send_request(domain->fd, IPC_OP_RUN, stage->mod_id, stage->arg, stage->arg_len) != STATUS_SUCCESS) {
+        ERROR("Domain process %d lost, forking stage %d", domain->pid, (int)(stage - run->stages));
+        sched_close_domain(domain, 1);
+        return 0;
+    }
+    domain->busy = (int)(stage - run->stages);
+    stage->domain = (int)(domain - run->domains);
+    stage->fd = domain->fd;
+    INFO("Stage %d handed to domain process %d", domain->busy, domain->pid);
+    return 1;
+}
+
+/* Final step of every stage: hands the result over to the caller and unblocks dependents */
+static void sched_complete_stage(sched_run_t* run, sched_stage_t* stage)
+{
+    const module_config_t* config = get_module_config(stage->mod_id);
+
+    if (stage->pidfd >= 0) {
+        close(stage->pidfd);
+        stage->pidfd = -1;
+    }
+    sched_record_latency(run, stage, sched_now_ns());
+    stage->pid = -1;
+
+    /* No retry once the run deadline has passed: the new attempt would be killed right away */
+    if (config != NULL && stage->status != STATUS_SUCCESS && sched_is_transient(stage->status)
+        && stage->attempt < config->retries
+        && (run->ctx->deadline_ms == 0 || sched_now_ms() < run->ctx->deadline_ms)) {
+        stage->attempt++;
+        INFO("Stage %d failed (status %d), attempt %d of %d", (int)(stage - run->stages), stage->status,
+             stage->attempt + 1, config->retries + 1);
+        ipc_release_blob(&stage->blob);
+        sched_reset_attempt(stage);
+        stage->state = STAGE_PENDING;   /* Picked up again by the next round of sched_run() */
+        return;
+    }
+
+    if (stage->status == STATUS_SUCCESS && stage->cache == STAGE_CACHE_MISS) {
+        result_cache_store(run->ctx->results, stage->mod_id, stage->cache_token, stage->out_buf);
+    }
+    if (stage->status == STATUS_ERR_CANCELLED) {
+        run->ctx->partial = 1;
+    }
+    if (config != NULL && config->critical && stage->status != STATUS_SUCCESS) {
+        ERROR("Critical module %s failed (status %d)", config->name, stage->status);
+        run->critical_failed = 1;
+    }
+    stage->state = STAGE_DONE;
+    run->done_mask |= STAGE_BIT(stage - run->stages);
+    INFO("Stage %d done (module %d, status %d)", (int)(stage - run->stages), stage->mod_id, stage->status);
+    if (stage->usage.valid) {
+        INFO("Stage %d usage: cpu %llu us, maxrss %ld KiB, majflt %ld",
+             (int)(stage - run->stages), (unsigned long long)(stage->usage.utime_us + stage->usage.stime_us),
+             stage->usage.maxrss_kb, stage->usage.majflt);
+    }
+    if (stage->complete) {
+        stage->complete(stage, run->ctx);
+    }
+    ipc_release_blob(&stage->blob);
+}
+
+/* The IPC exchange is over (response, error or timeout). Closes the channel and starts reaping. */
+static void sched_end_exchange(sched_run_t* run, sched_stage_t* stage, ProjectStatus status)
+{
+    stage->status = status;
+
+    if (stage->pooled) {
+        /* The channel belongs to the worker, which outlives the stage */
+        pool_release(run->pool, stage->mod_id, status == STATUS_SUCCESS);
+        stage->pooled = 0;
+        stage->fd = -1;
+    }
+    if (stage->domain >= 0) {
+        /* Same, the channel belongs to the domain process. It only serves on if it answered properly */
+        sched_domain_t* domain = &run->domains[stage->domain];
+        domain->busy = -1;
+        if (status != STATUS_SUCCESS && status != STATUS_ERR_MODULE_FAIL) {
+            sched_close_domain(domain, 1);
+        }
+        stage->fd = -1;
+    }
+    if (stage->fd >= 0) {
+        close(stage->fd);
+        stage->fd = -1;
+    }
+
+    if (stage->pid <= 0) {
+        sched_complete_stage(run, stage);
+        return;
+    }
+
+    if (stage->pidfd < 0) {
+        /* No pidfd on this kernel: reap synchronously */
+        ProjectStatus reap_status = wait_for_process_exit(stage->pid, &stage->usage);
+        if (reap_status != STATUS_SUCCESS) {
+            stage->status = reap_status;
+        }
+        sched_complete_stage(run, stage);
+        return;
+    }
+
+    /* A module that timed out, or ignored the cancel request, is not going to exit on its own */
+    stage->killed = (status == STATUS_ERR_TIMEOUT || status == STATUS_ERR_CANCELLED);
+    if (stage->killed) {
+        kill(stage->pid, SIGKILL);
+    }
+    stage->state = STAGE_EXITING;
+    stage->deadline_ms = sched_now_ms() + sched_exit_timeout_ms(get_module_config(stage->mod_id));
+}
+
+/* Called when the pidfd fired or the exit deadline passed */
+static void sched_handle_exit(sched_run_t* run, sched_stage_t* stage, int exited, uint64_t now)
+{
+    const module_config_t* config = get_module_config(stage->mod_id);
+
+    if (exited && reap_process(stage->pid, &stage->usage) == STATUS_SUCCESS) {
+        sched_complete_stage(run, stage);
+        return;
+    }
+    if (now < stage->deadline_ms) {
+        return;
+    }
+
+    if (!stage->killed) {
+        ERROR("PID %d timed out. Sending SIGKILL.", stage->pid);
+        kill(stage->pid, SIGKILL);
+        stage->killed = 1;
+        stage->deadline_ms = now + sched_exit_timeout_ms(config);
+        return;
+    }
+
+    ERROR("CRITICAL: Module %s (PID %d) is a Zombie.", config->name, stage->pid);
+    stage->status = STATUS_ERR_ZOMBIE;
+    sched_complete_stage(run, stage);
+}
+
+/* Result cache lookup. A hit completes the stage on the spot, without spawning anything */
+static int sched_serve_cached(sched_run_t* run, sched_stage_t* stage, const module_config_t* config)
+{
+    if (run->ctx->results == NULL || config->cache == NULL || stage->arg != NULL
+        || stage->out_buf == NULL || stage->out_size == 0) {
+        return 0;
+    }
+    /* Read before the module runs: a change racing with it invalidates the stored result */
+    if (result_cache_token(config->cache, run->ctx->props, &stage->cache_token) != STATUS_SUCCESS) {
+        return 0;
+    }
+    if (!result_cache_lookup(run->ctx->results, stage->mod_id, config->cache, stage->cache_token,
+                             stage->out_buf, stage->out_size)) {
+        stage->cache = STAGE_CACHE_MISS;
+        return 0;
+    }
+
+    INFO("Stage %d served from the result cache (module %s)", (int)(stage - run->stages), config->name);
+    stage->cache = STAGE_CACHE_HIT;
+    stage->out_len = strlen(stage->out_buf);
+    sched_end_exchange(run, stage, STATUS_SUCCESS);
+    return 1;
+}
+
+static void sched_start_stage(sched_run_t* run, sched_stage_t* stage)
+{
+    const module_config_t* config = get_module_config(stage->mod_id);
+    if (config == NULL) {
+        sched_end_exchange(run, stage, STATUS_ERR_INVALID_ARG);
+        return;
+    }
+
+    if (stage->prepare) {
+        stage->prepare(stage, run->ctx);
+    }
+
+    if (sched_serve_cached(run, stage, config)) {
+        return;
+    }
+
+    stage->t_start_ns = sched_now_ns();
+    /* Prefer a warm worker, fall back to a fresh fork if none is idle */
+    if (run->pool != NULL && pool_dispatch(run->pool, stage->mod_id, stage->arg, stage->arg_len, &stage->fd) == STATUS_SUCCESS) {
+        stage->pooled = 1;
+    } else if (!sched_dispatch_fused(run, stage, config)) {
+        stage->pid = spawn_module_process(config, &stage->fd, stage->arg);
+        if (stage->pid < 0) {
+            stage->fd = -1;
+            sched_end_exchange(run, stage, STATUS_ERR_FORK);
+            return;
+        }
+        stage->pidfd = open_process_fd(stage->pid);
+    }
+
+    stage->deadline_ms = sched_attempt_deadline_ms(run, stage, config, sched_now_ms());
+    stage->state = STAGE_RUNNING;
+    INFO("Stage %d started (module %s, pid %d, pooled %d)", (int)(stage - run->stages), config->name,
+         stage->pid, stage->pooled);
+}
+
+static ProjectStatus sched_read_response(sched_stage_t* stage)
+{
+    ipc_response_t resp;
+    const module_config_t* config = get_module_config(stage->mod_id);
+
+    ProjectStatus ipc_res = ipc_receive_packet(stage->fd, &resp);
+    if (ipc_res == STATUS_SUCCESS) {
+        stage->t_response_ns = sched_now_ns();
+        stage->timing = resp.timing;
+    }
+    if (ipc_res == STATUS_SUCCESS && resp.mod_id != stage->mod_id) {
+        /* A fused process answers for several modules: never credit one with another's result */
+        ERROR("Module %s: response tagged for module %d", config->name, resp.mod_id);
+        if (resp.blob_fd >= 0) {
+            close(resp.blob_fd);
+        }
+        return STATUS_ERR_IPC_PROTO;
+    }
+    if (ipc_res == STATUS_SUCCESS && (resp.flags & IPC_FLAG_BLOB)) {
+        /* Large result: map it in place, it is released after the complete callback */
+        ipc_res = ipc_map_blob(&resp, config->max_blob_size, &stage->blob);
+    }
+    if (ipc_res == STATUS_SUCCESS && resp.status_code == 0 && (resp.flags & IPC_FLAG_TLV)) {
+        /* Typed fields: copied as they are, a truncated buffer would not decode */
+        if (stage->out_buf && stage->out_size > 0) {
+            if (resp.data_len > stage->out_size) {
+                ERROR("Module %s: %u byte TLV result, room for %zu", config->name, resp.data_len, stage->out_size);
+                return STATUS_ERR_IPC_PROTO;
+            }
+            memcpy(stage->out_buf, resp.payload, resp.data_len);
+            stage->out_len = resp.data_len;
+        }
+        return STATUS_SUCCESS;
+    }
+    if (ipc_res == STATUS_SUCCESS && resp.status_code == 0) {
+        if (stage->out_buf && stage->out_size > 0 && resp.data_len > 0) {
+            strncpy(stage->out_buf, resp.payload, stage->out_size - 1);
+            stage->out_buf[stage->out_size - 1] = '\0';
+            stage->out_len = strlen(stage->out_buf);
+        }
+        return STATUS_SUCCESS;
+    }
+
+    ERROR("Module %s IPC/Logic Error: %d", config->name, ipc_res);
+    return (ipc_res != STATUS_SUCCESS) ? ipc_res : STATUS_ERR_MODULE_FAIL;
+}
+
+/* Out of run time: ask the module to wrap up, it may still answer within the grace period */
+static void sched_cancel_stage(sched_run_t* run, sched_stage_t* stage, uint64_t now)
+{
+    pid_t pid = (stage->domain >= 0) ? run->domains[stage->domain].pid : stage->pid;
+    if (pid <= 0) {
+        /* Pooled: the worker outlives the stage, it is recycled instead */
+        sched_end_exchange(run, stage, STATUS_ERR_CANCELLED);
+        return;
+    }
+    INFO("Run deadline: cancelling stage %d (pid %d)", (int)(stage - run->stages), pid);
+    kill(pid, SIGTERM);
+    stage->cancelling = 1;
+    stage->deadline_ms = now + RUN_CANCEL_GRACE_MS;
+}
+
+/* IPC channel and/or pidfd of a running stage fired */
+static void sched_handle_running(sched_run_t* run, sched_stage_t* stage, short ipc_events, int exited,
+                                 uint64_t now)
+{
+    const module_config_t* config = get_module_config(stage->mod_id);
+
+    if (exited && !(ipc_events & POLLIN)) {
+        /* The response is queued before the child exits, so re-check the channel once */
+        struct pollfd pfd = { .fd = stage->fd, .events = POLLIN };
+        if (poll(&pfd, 1, 0) > 0) {
+            ipc_events = pfd.revents;
+        }
+    }
+
+    if (ipc_events & POLLIN) {
+        sched_end_exchange(run, stage, sched_read_response(stage));
+    } else if (exited || (ipc_events & (POLLHUP | POLLERR | POLLNVAL))) {
+        ERROR("Module %s exited without a response", config->name);
+        sched_end_exchange(run, stage, STATUS_ERR_IPC_RECV);
+    } else if (now >= stage->deadline_ms && stage->cancelling) {
+        ERROR("Module %s ignored the cancel request", config->name);
+        sched_end_exchange(run, stage, STATUS_ERR_CANCELLED);
+    } else if (now >= stage->deadline_ms && stage->cut_short) {
+        sched_cancel_stage(run, stage, now);
+    } else if (now >= stage->deadline_ms) {
+        ERROR("Module %s Timeout", config->name);
+        sched_end_exchange(run, stage, STATUS_ERR_TIMEOUT);
+    }
+}
+
+ProjectStatus sched_run(sched_stage_t* stages, size_t count, daemon_context_t* ctx, worker_pool_t* pool)
+{
+    struct pollfd pfds[SCHED_MAX_FDS];
+    int ipc_slot[SCHED_MAX_STAGES];
+    int pid_slot[SCHED_MAX_STAGES];
+    int domain_slot[SCHED_MAX_STAGES];
+    sched_run_t run = { .stages = stages, .count = count, .ctx = ctx, .pool = pool, .collect_deadline_ms = UINT64_MAX };
+    uint32_t all_mask = 0;
+    size_t i = 0;
+
+    if (stages == NULL || ctx == NULL || count == 0 || count > SCHED_MAX_STAGES) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    all_mask = STAGE_BIT(count) - 1;
+    for (i = 0; i < count; i++) {
+        if ((stages[i].deps & ~all_mask) != 0 || (stages[i].deps & STAGE_BIT(i)) != 0) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        stages[i].state = STAGE_PENDING;
+        stages[i].status = STATUS_ERR_GENERIC;
+        stages[i].attempt = 0;
+        sched_reset_attempt(&stages[i]);
+        stages[i].blob = (ipc_blob_t){ .data = NULL, .size = 0, .fd = -1 };
+    }
+
+    if (ctx->deadline_ms != 0) {
+        /* Collection ends early enough for the 'always' stages to run on their full budgets */
+        uint64_t reserve = RUN_CANCEL_GRACE_MS;
+        for (i = 0; i < count; i++) {
+            uint64_t chain = sched_chain_ms(&run, i, 1);
+            if (chain + RUN_CANCEL_GRACE_MS > reserve) reserve = chain + RUN_CANCEL_GRACE_MS;
+        }
+        run.collect_deadline_ms = (ctx->deadline_ms > reserve) ? ctx->deadline_ms - reserve : 0;
+    }
+
+    while (run.done_mask != all_mask || sched_domains_alive(&run)) {
+        /*
+         * Start everything whose dependencies are satisfied. A stage failing right away (fork)
+         * may come back as pending for a retry; 'retries' bounds the loop.
+         */
+        for (i = 0; i < count; i++) {
+            while (stages[i].state == STAGE_PENDING && (stages[i].deps & ~run.done_mask) == 0) {
+                if (!stages[i].always && sched_now_ms() >= run.collect_deadline_ms) {
+                    INFO("Run deadline: skipping stage %zu (module %d)", i, stages[i].mod_id);
+                    sched_end_exchange(&run, &stages[i], STATUS_ERR_CANCELLED);
+                    continue;
+                }
+                if (sched_domain_busy(&run, &stages[i])) {
+                    break;
+                }
+                DEBUG("Starting stage %zu (module %d)", i, stages[i].mod_id);
+                sched_start_stage(&run, &stages[i]);
+            }
+        }
+        sched_retire_domains(&run);
+
+        /* Build the poll set: IPC channels of running stages, pidfds of running and exiting ones */
+        nfds_t nfds = 0;
+        uint64_t now = sched_now_ms();
+        uint64_t next_deadline = UINT64_MAX;
+        for (i = 0; i < count; i++) {
+            ipc_slot[i] = -1;
+            pid_slot[i] = -1;
+            if (stages[i].state != STAGE_RUNNING && stages[i].state != STAGE_EXITING) continue;
+
+            if (stages[i].state == STAGE_RUNNING) {
+                ipc_slot[i] = (int)nfds;
+                pfds[nfds++] = (struct pollfd){ .fd = stages[i].fd, .events = POLLIN };
+            }
+            if (stages[i].pidfd >= 0) {
+                pid_slot[i] = (int)nfds;
+                pfds[nfds++] = (struct pollfd){ .fd = stages[i].pidfd, .events = POLLIN };
+            }
+            if (stages[i].deadline_ms < next_deadline) {
+                next_deadline = stages[i].deadline_ms;
+            }
+        }
+        for (i = 0; i < run.domain_count; i++) {
+            /* Closed domain processes: only their exit is left to wait for */
+            domain_slot[i] = -1;
+            if (run.domains[i].pid <= 0 || run.domains[i].fd >= 0) continue;
+            domain_slot[i] = (int)nfds;
+            pfds[nfds++] = (struct pollfd){ .fd = run.domains[i].pidfd, .events = POLLIN };
+            if (run.domains[i].deadline_ms < next_deadline) {
+                next_deadline = run.domains[i].deadline_ms;
+            }
+        }
+
+        if (nfds == 0) {
+            if (run.done_mask == all_mask) break;
+            /* Nothing running and nothing startable: the dependency graph has a cycle */
+            ERROR("Scheduler stalled, dependency cycle in stage graph");
+            for (i = 0; i < run.domain_count; i++) {
+                if (run.domains[i].pid > 0) sched_close_domain(&run.domains[i], 1);
+            }
+            return STATUS_ERR_INVALID_ARG;
+        }
+
+        int timeout_ms = (next_deadline > now) ? (int)(next_deadline - now) : 0;
+        int poll_res = poll(pfds, nfds, timeout_ms);
+        if (poll_res < 0) {
+            if (errno == EINTR) continue;
+            ERROR("Scheduler Poll Error");
+            for (i = 0; i < count; i++) {
+                if (stages[i].state == STAGE_RUNNING) {
+                    sched_end_exchange(&run, &stages[i], STATUS_ERR_POLL);
+                }
+            }
+            continue;
+        }
+
+        now = sched_now_ms();
+        for (i = 0; i < count; i++) {
+            short ipc_events = (ipc_slot[i] >= 0) ? pfds[ipc_slot[i]].revents : 0;
+            int exited = (pid_slot[i] >= 0) && (pfds[pid_slot[i]].revents & POLLIN);
+
+            if (stages[i].state == STAGE_RUNNING) {
+                sched_handle_running(&run, &stages[i], ipc_events, exited, now);
+            } else if (stages[i].state == STAGE_EXITING) {
+                sched_handle_exit(&run, &stages[i], exited, now);
+            }
+        }
+        for (i = 0; i < run.domain_count; i++) {
+            if (domain_slot[i] >= 0 && run.domains[i].pid > 0) {
+                sched_handle_domain_exit(&run.domains[i], pfds[domain_slot[i]].revents & POLLIN, now);
+            }
+        }
+    }
+
+    return run.critical_failed ? STATUS_ERR_MODULE_FAIL : STATUS_SUCCESS;
+}
@@ -0,0 +1,373 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "spool.h"
+
+#define SPOOL_MAGIC         0x53504F4Cu     /* "SPOL" */
+#define SPOOL_VERSION       1
+#define SPOOL_SLOT_SIZE     64
+#define SPOOL_DATA_OFF      4096            /* Header slots get a page of their own */
+#define SPOOL_WRAP          0xFFFFFFFFu     /* Record length of a wrap marker: continue at offset 0 */
+
+_Static_assert(SPOOL_CAPACITY % 8 == 0, "SPOOL_CAPACITY must keep records 8-byte aligned");
+
+typedef struct spool_header_s {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t gen;                   /* The valid slot with the highest generation wins */
+    uint32_t capacity;
+    uint32_t head_off;
+    uint32_t reserved2;
+    uint64_t head_seq;
+    uint32_t crc;                   /* Over everything above */
+} spool_header_t;
+
+typedef struct spool_rec_s {
+    uint32_t len;                   /* Payload bytes, or SPOOL_WRAP */
+    uint32_t crc;                   /* Over len, seq and the payload */
+    uint64_t seq;
+} spool_rec_t;
+
+_Static_assert(sizeof(spool_header_t) <= SPOOL_SLOT_SIZE, "spool header slot too small");
+
+static uint32_t g_crc_table[256];
+
+static uint32_t spool_crc_update(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* p = data;
+    if (g_crc_table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            g_crc_table[i] = c;
+        }
+    }
+    while (len-- > 0) {
+        crc = g_crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t spool_rec_crc(uint32_t len, uint64_t seq, const void* payload, size_t payload_len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    crc = spool_crc_update(crc, &len, sizeof(len));
+    crc = spool_crc_update(crc, &seq, sizeof(seq));
+    crc = spool_crc_update(crc, payload, payload_len);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static uint32_t spool_rec_size(uint32_t len)
+{
+    return (uint32_t)((sizeof(spool_rec_t) + len + 7) & ~(size_t)7);
+}
+
+/*
+ * Record number 'seq' at or after 'off' (following a wrap marker, or the implicit wrap when less
+ * than a record header is left). On success, 'off' is moved to the record itself.
+ */
+static const spool_rec_t* spool_rec_at(const spool_t* spool, uint32_t* off, uint64_t seq)
+{
+    uint32_t at = *off;
+    if (SPOOL_CAPACITY - at < sizeof(spool_rec_t)) {
+        at = 0;
+    }
+    const spool_rec_t* rec = (const spool_rec_t*)(spool->data + at);
+    if (rec->len == SPOOL_WRAP) {
+        if (rec->seq != seq || rec->crc != spool_rec_crc(SPOOL_WRAP, seq, NULL, 0)) {
+            return NULL;
+        }
+        at = 0;
+        rec = (const spool_rec_t*)spool->data;
+    }
+    /* Torn, from an older lap, or never written */
+    if (rec->len > SPOOL_RECORD_MAX || rec->seq != seq || at + spool_rec_size(rec->len) > SPOOL_CAPACITY
+        || rec->crc != spool_rec_crc(rec->len, seq, rec + 1, rec->len)) {
+        return NULL;
+    }
+    *off = at;
+    return rec;
+}
+
+static void spool_write_header(spool_t* spool)
+{
+    spool_header_t hdr = {
+        .magic = SPOOL_MAGIC,
+        .version = SPOOL_VERSION,
+        .gen = spool->gen + 1,
+        .capacity = SPOOL_CAPACITY,
+        .head_off = spool->head_off,
+        .head_seq = spool->head_seq,
+    };
+    hdr.crc = spool_crc_update(0xFFFFFFFFu, &hdr, offsetof(spool_header_t, crc)) ^ 0xFFFFFFFFu;
+    /* The other slot: if this write tears, the previous header is still intact */
+    memcpy(spool->map + (hdr.gen & 1) * SPOOL_SLOT_SIZE, &hdr, sizeof(hdr));
+    spool->gen = hdr.gen;
+}
+
+static int spool_read_header(const spool_t* spool, spool_header_t* out)
+{
+    int found = 0;
+    for (int slot = 0; slot < 2; slot++) {
+        spool_header_t hdr;
+        memcpy(&hdr, spool->map + slot * SPOOL_SLOT_SIZE, sizeof(hdr));
+        uint32_t crc = spool_crc_update(0xFFFFFFFFu, &hdr, offsetof(spool_header_t, crc)) ^ 0xFFFFFFFFu;
+        if (hdr.magic != SPOOL_MAGIC || hdr.version != SPOOL_VERSION || hdr.capacity != SPOOL_CAPACITY
+            || hdr.crc != crc || hdr.head_off >= SPOOL_CAPACITY || (hdr.head_off & 7) != 0) {
+            continue;
+        }
+        if (!found || hdr.gen > out->gen) {
+            *out = hdr;
+            found = 1;
+        }
+    }
+    return found;
+}
+
+/*
+ * The persisted head is not a record: the header came from the fallback slot (the newer one was
+ * torn) and the ring moved on since. Restart at the oldest intact record that was not consumed yet.
+ */
+static void spool_recover_head(spool_t* spool)
+{
+    uint64_t best_seq = UINT64_MAX;
+    uint32_t best_off = 0;
+
+    for (uint32_t off = 0; off + sizeof(spool_rec_t) <= SPOOL_CAPACITY; off += 8) {
+        const spool_rec_t* rec = (const spool_rec_t*)(spool->data + off);
+        uint32_t at = off;
+        if (rec->len <= SPOOL_RECORD_MAX && rec->seq >= spool->head_seq && rec->seq < best_seq
+            && spool_rec_at(spool, &at, rec->seq) != NULL && at == off) {
+            best_seq = rec->seq;
+            best_off = off;
+        }
+    }
+    if (best_seq != UINT64_MAX) {
+        ERROR("Spool: head %llu lost, resuming at %llu", (unsigned long long)spool->head_seq, (unsigned long long)best_seq);
+        spool->head_off = best_off;
+        spool->head_seq = best_seq;
+        spool->header_dirty = 1;
+    }
+}
+
+ProjectStatus spool_open(spool_t* spool, const char* path)
+{
+    struct stat st;
+    spool_header_t hdr;
+
+    memset(spool, 0, sizeof(*spool));
+    spool->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (spool->fd < 0) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    spool->map_size = SPOOL_DATA_OFF + SPOOL_CAPACITY;
+    if (fstat(spool->fd, &st) < 0) {
+        goto fail;
+    }
+    if ((size_t)st.st_size != spool->map_size) {
+        /* New, or another layout: start over from zeroes */
+        if (ftruncate(spool->fd, 0) < 0 || ftruncate(spool->fd, (off_t)spool->map_size) < 0) {
+            goto fail;
+        }
+    }
+    void* map = mmap(NULL, spool->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, spool->fd, 0);
+    if (map == MAP_FAILED) {
+        goto fail;
+    }
+    /* Module children must not see it: their fds are closed, but a shared mapping survives fork */
+    if (madvise(map, spool->map_size, MADV_DONTFORK) < 0) {
+        munmap(map, spool->map_size);
+        goto fail;
+    }
+    spool->map = map;
+    spool->data = spool->map + SPOOL_DATA_OFF;
+
+    if (spool_read_header(spool, &hdr)) {
+        spool->gen = hdr.gen;
+        spool->head_off = hdr.head_off;
+        spool->head_seq = hdr.head_seq;
+    } else {
+        spool->head_off = 0;
+        spool->head_seq = 1;
+        spool_write_header(spool);
+        spool->header_dirty = 1;
+    }
+
+    uint32_t off = spool->head_off;
+    if (spool_rec_at(spool, &off, spool->head_seq) == NULL) {
+        spool_recover_head(spool);
+    }
+
+    /* Everything from the head on that is intact and in sequence is still queued */
+    off = spool->head_off;
+    uint64_t seq = spool->head_seq;
+    const spool_rec_t* rec;
+    while (spool->count < SPOOL_CAPACITY / sizeof(spool_rec_t) && (rec = spool_rec_at(spool, &off, seq)) != NULL) {
+        if (spool->count == 0) {
+            spool->head_off = off;
+        }
+        off += spool_rec_size(rec->len);
+        seq++;
+        spool->count++;
+    }
+    spool->tail_off = off;
+    spool->tail_seq = seq;
+    if (spool->count == 0) {
+        spool->head_off = off;
+    }
+    if (spool->count > 0) {
+        INFO("Spool: %u records queued", spool->count);
+    }
+    return STATUS_SUCCESS;
+
+fail:
+    close(spool->fd);
+    spool->fd = -1;
+    return STATUS_ERR_OPEN_ERROR;
+}
+
+ProjectStatus spool_sync(spool_t* spool)
+{
+    if (spool->map == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (spool->header_dirty) {
+        spool_write_header(spool);
+    }
+    /* Only dirty pages are written back: a few records, at most the header page */
+    if (msync(spool->map, spool->map_size, MS_SYNC) < 0) {
+        return STATUS_ERR_GENERIC;
+    }
+    spool->header_dirty = 0;
+    spool->unsynced = 0;
+    return STATUS_SUCCESS;
+}
+
+void spool_close(spool_t* spool)
+{
+    if (spool->map != NULL) {
+        spool_sync(spool);
+        munmap(spool->map, spool->map_size);
+        spool->map = NULL;
+    }
+    if (spool->fd >= 0) {
+        close(spool->fd);
+        spool->fd = -1;
+    }
+}
+
+void spool_consume(spool_t* spool, uint32_t n)
+{
+    while (n-- > 0 && spool->count > 0) {
+        uint32_t off = spool->head_off;
+        const spool_rec_t* rec = spool_rec_at(spool, &off, spool->head_seq);
+        if (rec == NULL) {
+            /* Cannot happen short of a scribbled mapping: drop the whole queue rather than loop */
+            ERROR("Spool: record %llu unreadable, dropping %u", (unsigned long long)spool->head_seq, spool->count);
+            spool->count = 0;
+            break;
+        }
+        spool->head_off = off + spool_rec_size(rec->len);
+        spool->head_seq++;
+        spool->count--;
+    }
+    if (spool->count == 0) {
+        spool->head_off = spool->tail_off;
+        spool->head_seq = spool->tail_seq;
+    } else {
+        uint32_t off = spool->head_off;
+        if (spool_rec_at(spool, &off, spool->head_seq) != NULL) {
+            spool->head_off = off;
+        }
+    }
+    spool->header_dirty = 1;
+}
+
+ProjectStatus spool_append(spool_t* spool, const void* data, size_t len)
+{
+    uint32_t dropped = 0;
+    uint32_t start;
+    int wrap;
+
+    if (spool->map == NULL || data == NULL || len == 0 || len > SPOOL_RECORD_MAX) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    uint32_t need = spool_rec_size((uint32_t)len);
+
+    for (;;) {
+        wrap = (SPOOL_CAPACITY - spool->tail_off < need);
+        start = wrap ? 0 : spool->tail_off;
+        if (spool->count == 0) {
+            break;
+        }
+        int fits = (spool->tail_off > spool->head_off)
+            ? (!wrap || need <= spool->head_off)                        /* Free: [tail, end) and [0, head) */
+            : (!wrap && spool->tail_off + need <= spool->head_off);     /* Free: [tail, head) */
+        if (fits) {
+            break;
+        }
+        spool_consume(spool, 1);
+        dropped++;
+    }
+    if (dropped > 0) {
+        ERROR("Spool full: dropped the %u oldest records", dropped);
+    }
+    /* The head must be on disk before the space it released is reused */
+    if (spool->header_dirty && spool_sync(spool) != STATUS_SUCCESS) {
+        return STATUS_ERR_GENERIC;
+    }
+
+    if (wrap && SPOOL_CAPACITY - spool->tail_off >= sizeof(spool_rec_t)) {
+        spool_rec_t marker = { .len = SPOOL_WRAP, .seq = spool->tail_seq };
+        marker.crc = spool_rec_crc(SPOOL_WRAP, marker.seq, NULL, 0);
+        memcpy(spool->data + spool->tail_off, &marker, sizeof(marker));
+    }
+    spool_rec_t rec = { .len = (uint32_t)len, .seq = spool->tail_seq };
+    rec.crc = spool_rec_crc(rec.len, rec.seq, data, len);
+    memcpy(spool->data + start, &rec, sizeof(rec));
+    memcpy(spool->data + start + sizeof(rec), data, len);
+
+    if (spool->count == 0) {
+        spool->head_off = start;
+        spool->head_seq = spool->tail_seq;
+    }
+    spool->tail_off = start + need;
+    spool->tail_seq++;
+    spool->count++;
+
+    if (++spool->unsynced >= SPOOL_SYNC_RECORDS) {
+        return spool_sync(spool);
+    }
+    return STATUS_SUCCESS;
+}
+
+void spool_iter_init(const spool_t* spool, spool_iter_t* it)
+{
+    it->off = spool->head_off;
+    it->seq = spool->head_seq;
+    it->left = spool->count;
+}
+
+int spool_iter_next(const spool_t* spool, spool_iter_t* it, const void** data, size_t* len)
+{
+    if (it->left == 0) {
+        return 0;
+    }
+    const spool_rec_t* rec = spool_rec_at(spool, &it->off, it->seq);
+    if (rec == NULL) {
+        it->left = 0;
+        return 0;
+    }
+    *data = rec + 1;
+    *len = rec->len;
+    it->off += spool_rec_size(rec->len);
+    it->seq++;
+    it->left--;
+    return 1;
+}
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "stmt_cache.h"
+#include "symbol_resolver.h"
+
+void stmt_cache_init(stmt_cache_t* cache, sqlite3* db)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->db = db;
+}
+
+static stmt_cache_entry_t* stmt_cache_lookup(stmt_cache_t* cache, const char* sql)
+{
+    for (size_t i = 0; i < cache->count; i++) {
+        /* Same literal almost always means the same pointer, strcmp only catches copies */
+        if (cache->entries[i].sql == sql || strcmp(cache->entries[i].sql, sql) == 0) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static stmt_cache_entry_t* stmt_cache_slot(stmt_cache_t* cache)
+{
+    if (cache->count < STMT_CACHE_SLOTS) {
+        return &cache->entries[cache->count++];
+    }
+
+    stmt_cache_entry_t* victim = &cache->entries[0];
+    for (size_t i = 1; i < STMT_CACHE_SLOTS; i++) {
+        if (cache->entries[i].last_used < victim->last_used) {
+            victim = &cache->entries[i];
+        }
+    }
+    sal_sqlite_finalize(victim->stmt);
+    victim->stmt = NULL;
+    return victim;
+}
+
+sqlite3_stmt* stmt_cache_get(stmt_cache_t* cache, const char* sql)
+{
+    if (cache == NULL || cache->db == NULL || sql == NULL) {
+        return NULL;
+    }
+
+    stmt_cache_entry_t* entry = stmt_cache_lookup(cache, sql);
+    if (entry != NULL) {
+        sal_sqlite_reset(entry->stmt);
+        sal_sqlite_clear_bindings(entry->stmt);
+        entry->last_used = ++cache->clock;
+        return entry->stmt;
+    }
+
+    sqlite3_stmt* stmt = NULL;
+    if (sal_sqlite_prepare(cache->db, sql, &stmt) != SQLITE_OK || stmt == NULL) {
+        if (stmt != NULL) {
+            sal_sqlite_finalize(stmt);
+        }
+        return NULL;
+    }
+
+    entry = stmt_cache_slot(cache);
+    entry->sql = sql;
+    entry->stmt = stmt;
+    entry->last_used = ++cache->clock;
+    return stmt;
+}
+
+ProjectStatus stmt_cache_exec(sqlite3_stmt* stmt)
+{
+    if (stmt == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    int rc = sal_sqlite_step(stmt);
+    while (rc == SQLITE_ROW) {
+        rc = sal_sqlite_step(stmt);     /* e.g. PRAGMAs echoing their new value */
+    }
+    sal_sqlite_reset(stmt);
+    return (rc == SQLITE_DONE) ? STATUS_SUCCESS : STATUS_ERR_DB_EXEC;
+}
+
+void stmt_cache_destroy(stmt_cache_t* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cache->count; i++) {
+        sal_sqlite_finalize(cache->entries[i].stmt);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
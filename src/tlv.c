@@ -0,0 +1,232 @@
+#include <string.h>
+
+#include "tlv.h"
+
+#define TLV_KEY(tag, type)  (((uint64_t)(tag) << 2) | (uint64_t)(type))
+
+void tlv_put_raw(tlv_writer_t* w, const void* data, size_t len)
+{
+    if (w->overflow || len > w->cap - w->len) {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void tlv_put_varint(tlv_writer_t* w, uint64_t value)
+{
+    uint8_t tmp[10];
+    size_t n = 0;
+    while (value >= 0x80) {
+        tmp[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    tmp[n++] = (uint8_t)value;
+    tlv_put_raw(w, tmp, n);
+}
+
+void tlv_writer_init(tlv_writer_t* w, void* buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = (buf != NULL) ? cap : 0;
+    w->len = 0;
+    w->overflow = 0;
+    w->depth = 0;
+}
+
+void tlv_put_uint(tlv_writer_t* w, uint32_t tag, uint64_t value)
+{
+    tlv_put_varint(w, TLV_KEY(tag, TLV_UINT));
+    tlv_put_varint(w, value);
+}
+
+void tlv_put_sint(tlv_writer_t* w, uint32_t tag, int64_t value)
+{
+    /* Zigzag: small negative numbers stay short */
+    tlv_put_varint(w, TLV_KEY(tag, TLV_SINT));
+    tlv_put_varint(w, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void tlv_put_bytes(tlv_writer_t* w, uint32_t tag, const void* data, size_t len)
+{
+    tlv_put_varint(w, TLV_KEY(tag, TLV_BYTES));
+    tlv_put_varint(w, len);
+    tlv_put_raw(w, data, len);
+}
+
+void tlv_put_str(tlv_writer_t* w, uint32_t tag, const char* str)
+{
+    tlv_put_bytes(w, tag, str, (str != NULL) ? strlen(str) : 0);
+}
+
+void tlv_begin_record(tlv_writer_t* w, uint32_t tag)
+{
+    static const uint8_t reserved[2] = { 0x80, 0x00 };
+    if (w->depth >= TLV_MAX_DEPTH) {
+        w->overflow = 1;
+        return;
+    }
+    tlv_put_varint(w, TLV_KEY(tag, TLV_RECORD));
+    w->open[w->depth++] = w->len;
+    tlv_put_raw(w, reserved, sizeof(reserved));
+}
+
+void tlv_end_record(tlv_writer_t* w)
+{
+    if (w->depth == 0) {
+        w->overflow = 1;
+        return;
+    }
+    size_t at = w->open[--w->depth];
+    if (w->overflow) {
+        return;
+    }
+    size_t body = w->len - at - 2;
+    if (body > TLV_RECORD_MAX) {
+        w->overflow = 1;
+        return;
+    }
+    /* Non-minimal but valid varint: low 7 bits with the continuation bit, then the high 7 */
+    w->buf[at] = (uint8_t)(0x80 | (body & 0x7F));
+    w->buf[at + 1] = (uint8_t)(body >> 7);
+}
+
+void tlv_put_field(tlv_writer_t* w, const tlv_field_t* field)
+{
+    switch (field->type) {
+    case TLV_UINT:
+        tlv_put_uint(w, field->tag, field->u);
+        break;
+    case TLV_SINT:
+        tlv_put_sint(w, field->tag, field->i);
+        break;
+    case TLV_BYTES:
+        tlv_put_bytes(w, field->tag, field->data, field->len);
+        break;
+    case TLV_RECORD:
+        tlv_begin_record(w, field->tag);
+        tlv_put_raw(w, field->data, field->len);
+        tlv_end_record(w);
+        break;
+    }
+}
+
+ProjectStatus tlv_finish(const tlv_writer_t* w, size_t* len)
+{
+    if (w->overflow || w->depth != 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (len != NULL) {
+        *len = w->len;
+    }
+    return STATUS_SUCCESS;
+}
+
+void tlv_reader_init(tlv_reader_t* r, const void* data, size_t len)
+{
+    r->p = data;
+    r->end = (data != NULL) ? r->p + len : NULL;
+}
+
+static int tlv_get_varint(const uint8_t** p, const uint8_t* end, uint64_t* value)
+{
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *value = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int tlv_next(tlv_reader_t* r, tlv_field_t* field)
+{
+    uint64_t key = 0;
+    uint64_t value = 0;
+    const uint8_t* p = r->p;
+
+    if (p == r->end) {
+        return 0;
+    }
+    if (!tlv_get_varint(&p, r->end, &key) || (key >> 2) > TLV_TAG_MAX || !tlv_get_varint(&p, r->end, &value)) {
+        return -1;
+    }
+
+    field->tag = (uint32_t)(key >> 2);
+    field->type = (tlv_type_e)(key & 3);
+    field->u = 0;
+    field->i = 0;
+    field->data = NULL;
+    field->len = 0;
+    switch (field->type) {
+    case TLV_UINT:
+        field->u = value;
+        break;
+    case TLV_SINT:
+        field->i = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        break;
+    case TLV_BYTES:
+    case TLV_RECORD:
+        if (value > (uint64_t)(r->end - p)) {
+            return -1;
+        }
+        field->data = p;
+        field->len = (size_t)value;
+        p += value;
+        break;
+    }
+    r->p = p;
+    return 1;
+}
+
+void tlv_open_record(const tlv_field_t* field, tlv_reader_t* r)
+{
+    if (field->type != TLV_RECORD) {
+        tlv_reader_init(r, NULL, 0);
+        return;
+    }
+    tlv_reader_init(r, field->data, field->len);
+}
+
+int tlv_find(const void* data, size_t len, uint32_t tag, tlv_field_t* field)
+{
+    tlv_reader_t r;
+    tlv_reader_init(&r, data, len);
+    while (tlv_next(&r, field) == 1) {
+        if (field->tag == tag) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+size_t tlv_copy_str(const tlv_field_t* field, char* out, size_t size)
+{
+    if (out == NULL || size == 0) {
+        return 0;
+    }
+    size_t len = (field->type == TLV_BYTES) ? field->len : 0;
+    if (len > size - 1) {
+        len = size - 1;
+    }
+    if (len > 0) {
+        memcpy(out, field->data, len);
+    }
+    out[len] = '\0';
+    return len;
+}
+
+size_t tlv_field_size(const void* data, size_t max)
+{
+    tlv_reader_t r;
+    tlv_field_t field;
+    tlv_reader_init(&r, data, max);
+    if (tlv_next(&r, &field) != 1) {
+        return 0;
+    }
+    return (size_t)(r.p - (const uint8_t*)data);
+}
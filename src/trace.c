@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+#define TRACE_RING_MASK (TRACE_RING_EVENTS - 1)
+
+_Static_assert((TRACE_RING_EVENTS & TRACE_RING_MASK) == 0, "TRACE_RING_EVENTS must be a power of two");
+
+/* Provided by the linker for the "trace_sites" section, weak so a binary without sites still links */
+extern const trace_site_t* __start_trace_sites[] __attribute__((weak));
+extern const trace_site_t* __stop_trace_sites[] __attribute__((weak));
+
+static trace_event_t g_ring[TRACE_RING_EVENTS] __attribute__((aligned(64)));
+static atomic_uint_fast64_t g_head;
+static int g_max_level = -1;           /* Highest level recorded since the last reset */
+
+/* Calibration points: events carry raw ticks, converted to CLOCK_MONOTONIC ns when decoding */
+static uint64_t g_base_ticks;
+static uint64_t g_base_ns;
+
+static inline uint64_t trace_mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Free-running counter, a few cycles instead of a full clock_gettime() */
+static inline uint64_t trace_ticks(void)
+{
+#if defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return trace_mono_ns();
+#endif
+}
+
+static void trace_calibrate(void)
+{
+    g_base_ns = trace_mono_ns();
+    g_base_ticks = trace_ticks();
+}
+
+trace_event_t* trace_begin(const trace_site_t* const* site_ref)
+{
+    const trace_site_t* site = *site_ref;
+    uint64_t pos = atomic_fetch_add_explicit(&g_head, 1, memory_order_relaxed);
+    trace_event_t* ev = &g_ring[pos & TRACE_RING_MASK];
+
+    /* Marks the slot in-flight: 'seq' only matches the position once trace_commit() ran */
+    ev->seq = ~(uint32_t)pos;
+    ev->ticks = trace_ticks();
+    ev->site_id = (uint16_t)(site_ref - (const trace_site_t* const*)__start_trace_sites);
+    ev->nargs = site->nargs;
+    ev->str_len = 0;
+    if (__builtin_expect(g_base_ticks == 0, 0)) {
+        trace_calibrate();
+    }
+    if (site->level > g_max_level) {
+        g_max_level = site->level;      /* Racy by design, only used as a dump hint */
+    }
+    return ev;
+}
+
+void trace_commit(trace_event_t* ev)
+{
+    __atomic_store_n(&ev->seq, ~ev->seq, __ATOMIC_RELEASE);
+}
+
+void trace_put_u64(trace_event_t* ev, int idx, uint64_t value)
+{
+    ev->args[idx] = value;
+}
+
+void trace_put_f64(trace_event_t* ev, int idx, double value)
+{
+    memcpy(&ev->args[idx], &value, sizeof(value));
+}
+
+void trace_put_ptr(trace_event_t* ev, int idx, const void* value)
+{
+    ev->args[idx] = (uint64_t)(uintptr_t)value;
+}
+
+void trace_put_str(trace_event_t* ev, int idx, const char* value)
+{
+    ev->args[idx] = (uint64_t)(uintptr_t)value;
+    if (ev->str_len != 0 || value == NULL) {
+        return;     /* Only the first string is kept, later ones decode as their address */
+    }
+    size_t len = strnlen(value, TRACE_STR_INLINE);
+    memcpy(ev->str, value, len);
+    ev->str_len = (uint8_t)(len + 1);
+}
+
+void trace_reset(void)
+{
+    atomic_store_explicit(&g_head, 0, memory_order_relaxed);
+    g_max_level = -1;
+    g_base_ticks = 0;
+}
+
+static int trace_write_all(int fd, const void* buf, size_t len)
+{
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+static int trace_write_sites(int fd, size_t site_count)
+{
+    for (size_t i = 0; i < site_count; i++) {
+        const trace_site_t* site = __start_trace_sites[i];
+        trace_dump_site_t rec = {
+            .line = site->line,
+            .level = site->level,
+            .nargs = site->nargs,
+            .fmt_len = (uint16_t)strlen(site->fmt),
+            .file_len = (uint16_t)strlen(site->file),
+        };
+        if (trace_write_all(fd, &rec, sizeof(rec)) < 0 || trace_write_all(fd, site->fmt, rec.fmt_len) < 0
+            || trace_write_all(fd, site->file, rec.file_len) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int trace_dump(void)
+{
+    char path[128];
+    struct timespec mono, real;
+    uint64_t head = atomic_load_explicit(&g_head, memory_order_acquire);
+    uint64_t first = (head > TRACE_RING_EVENTS) ? head - TRACE_RING_EVENTS : 0;
+    size_t site_count = (size_t)(__stop_trace_sites - __start_trace_sites);
+    if (head == 0) {
+        return 0;   /* Nothing recorded, e.g. a module that ran without errors */
+    }
+
+    uint64_t dump_ticks = trace_ticks();
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    trace_dump_header_t hdr = {
+        .magic = TRACE_DUMP_MAGIC,
+        .version = TRACE_DUMP_VERSION,
+        .event_size = sizeof(trace_event_t),
+        .pid = (int32_t)getpid(),
+        .site_count = (uint32_t)site_count,
+        .lost = (uint32_t)first,
+        .mono_to_real_ns = ((uint64_t)real.tv_sec - (uint64_t)mono.tv_sec) * 1000000000ull
+                           + (uint64_t)real.tv_nsec - (uint64_t)mono.tv_nsec,
+        .base_ticks = g_base_ticks,
+        .base_ns = g_base_ns,
+        .dump_ticks = dump_ticks,
+        .dump_ns = (uint64_t)mono.tv_sec * 1000000000ull + (uint64_t)mono.tv_nsec,
+    };
+
+    /* Only committed events whose slot was not reused since: a copy, the ring keeps moving */
+    static trace_event_t snapshot[TRACE_RING_EVENTS];
+    for (uint64_t pos = first; pos < head; pos++) {
+        const trace_event_t* ev = &g_ring[pos & TRACE_RING_MASK];
+        uint32_t seq = __atomic_load_n(&ev->seq, __ATOMIC_ACQUIRE);
+        if (seq == (uint32_t)pos) {
+            snapshot[hdr.event_count++] = *ev;
+        } else {
+            hdr.lost++;
+        }
+    }
+
+    /* Sticky and world-writable like /tmp: sandboxed modules dump under their own uid */
+    struct stat st;
+    if (mkdir(TRACE_DUMP_DIR, 01733) == 0) {
+        chmod(TRACE_DUMP_DIR, 01733);   /* Not filtered by the umask */
+    }
+    if (lstat(TRACE_DUMP_DIR, &st) < 0 || !S_ISDIR(st.st_mode) || (st.st_uid != 0 && st.st_uid != geteuid())) {
+        return -1;  /* Replaced by a symlink, or planted by another uid */
+    }
+
+    /*
+     * The file name is predictable and anyone can create entries here: never follow or reuse
+     * what is there. A stale dump of a recycled pid (or a planted link) is removed, not opened.
+     */
+    snprintf(path, sizeof(path), "%s/trace.%d", TRACE_DUMP_DIR, hdr.pid);
+    unlink(path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int res = 0;
+    if (trace_write_all(fd, &hdr, sizeof(hdr)) < 0 || trace_write_sites(fd, site_count) < 0
+        || trace_write_all(fd, snapshot, hdr.event_count * sizeof(trace_event_t)) < 0) {
+        res = -1;
+    }
+    close(fd);
+    return res;
+}
+
+int trace_dump_if(int min_level)
+{
+    return (g_max_level >= min_level) ? trace_dump() : 0;
+}
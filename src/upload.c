@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "upload.h"
+#include "modules.h"
+#include "lz.h"
+#include "file_utils.h"
+
+#define UPLOAD_STATE_MAGIC      0x55504C44u     /* "UPLD" */
+#define UPLOAD_STATE_VERSION    1
+#define UPLOAD_CLEARED_TAGS     64              /* Tags that fit in the CLEARED mask */
+
+static const char g_base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void upload_state_load(upload_state_t* state, const char* path)
+{
+    memset(state, 0, sizeof(*state));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t got = read(fd, state, sizeof(*state));
+        close(fd);
+        if (got == (ssize_t)sizeof(*state) && state->magic == UPLOAD_STATE_MAGIC
+            && state->version == UPLOAD_STATE_VERSION && state->len <= sizeof(state->fields)) {
+            return;
+        }
+    }
+    /* Nothing acknowledged yet: the next upload is full */
+    memset(state, 0, sizeof(*state));
+    state->magic = UPLOAD_STATE_MAGIC;
+    state->version = UPLOAD_STATE_VERSION;
+}
+
+ProjectStatus upload_state_save(const upload_state_t* state, const char* path)
+{
+    if (state == NULL || path == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    return write_file_atomic(path, state, sizeof(*state));
+}
+
+static int upload_same_field(const tlv_field_t* a, const tlv_field_t* b)
+{
+    if (a->type != b->type) {
+        return 0;
+    }
+    switch (a->type) {
+    case TLV_UINT:  return a->u == b->u;
+    case TLV_SINT:  return a->i == b->i;
+    default:        return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+    }
+}
+
+/* The fields of record 'cur' that are not in record 'base' as they are. No 'base': all of them */
+static void upload_put_delta(tlv_writer_t* w, const tlv_field_t* base, const tlv_field_t* cur)
+{
+    tlv_reader_t r;
+    tlv_field_t field, other;
+    uint64_t cleared = 0;
+
+    tlv_begin_record(w, RESULT_TAG_DELTA);
+    tlv_open_record(cur, &r);
+    while (tlv_next(&r, &field) == 1) {
+        if (base == NULL || !tlv_find(base->data, base->len, field.tag, &other) || !upload_same_field(&field, &other)) {
+            tlv_put_field(w, &field);
+        }
+    }
+    if (base != NULL) {
+        tlv_open_record(base, &r);
+        while (tlv_next(&r, &field) == 1) {
+            if (field.tag < UPLOAD_CLEARED_TAGS && !tlv_find(cur->data, cur->len, field.tag, &other)) {
+                cleared |= 1ull << field.tag;
+            }
+        }
+    }
+    if (cleared != 0) {
+        tlv_put_uint(w, RESULT_TAG_CLEARED, cleared);
+    }
+    tlv_end_record(w);
+}
+
+static size_t upload_base64(const uint8_t* in, size_t len, char* out, size_t size)
+{
+    size_t need = (len + 2) / 3 * 4;
+    if (need >= size) {
+        return 0;
+    }
+    char* p = out;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        *p++ = g_base64[(v >> 18) & 0x3F];
+        *p++ = g_base64[(v >> 12) & 0x3F];
+        *p++ = (i + 1 < len) ? g_base64[(v >> 6) & 0x3F] : '=';
+        *p++ = (i + 2 < len) ? g_base64[v & 0x3F] : '=';
+    }
+    *p = '\0';
+    return need;
+}
+
+ProjectStatus upload_encode_frame(const tlv_field_t* batch, int full, char* text, size_t size, uint32_t* records,
+                                  uint64_t* version_out)
+{
+    uint8_t frame[UPLOAD_FRAME_MAX];
+    uint8_t packed[3 + LZ_BOUND(UPLOAD_FRAME_MAX)];
+    tlv_writer_t w;
+    tlv_reader_t r;
+    tlv_field_t field, version, base;
+    size_t len = 0;
+    int has_base;
+
+    *records = 0;
+    if (batch == NULL || batch->type != TLV_RECORD) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (!tlv_find(batch->data, batch->len, RESULT_TAG_BASE_VERSION, &version) || version.type != TLV_UINT) {
+        version.u = 0;
+        full = 1;
+    }
+    has_base = !full && tlv_find(batch->data, batch->len, RESULT_TAG_BASELINE, &base) && base.type == TLV_RECORD;
+
+    tlv_writer_init(&w, frame + 1, sizeof(frame) - 1);
+    tlv_put_uint(&w, RESULT_TAG_BASE_VERSION, version.u);
+    if (!has_base) {
+        tlv_put_uint(&w, RESULT_TAG_FULL, 1);
+    }
+    /* Each record is a delta against the one before it, the first against the baseline */
+    tlv_open_record(batch, &r);
+    while (tlv_next(&r, &field) == 1) {
+        if (field.tag != RESULT_TAG_UPLOAD || field.type != TLV_RECORD) {
+            continue;
+        }
+        upload_put_delta(&w, has_base ? &base : NULL, &field);
+        base = field;
+        has_base = 1;
+        (*records)++;
+    }
+    if (tlv_finish(&w, &len) != STATUS_SUCCESS || *records == 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    *version_out = version.u + *records;
+
+    const uint8_t* out = frame;
+    size_t out_len = len + 1;
+    frame[0] = 0;
+    if (len >= UPLOAD_LZ_MIN) {
+        size_t packed_len = lz_compress(frame + 1, len, packed + 3, sizeof(packed) - 3);
+        if (packed_len > 0 && packed_len + 3 < out_len) {
+            packed[0] = UPLOAD_FRAME_LZ;
+            packed[1] = (uint8_t)(len & 0xFF);
+            packed[2] = (uint8_t)(len >> 8);
+            out = packed;
+            out_len = packed_len + 3;
+        }
+    }
+    return (upload_base64(out, out_len, text, size) > 0) ? STATUS_SUCCESS : STATUS_ERR_INVALID_ARG;
+}
+
+int upload_reply_acked(const char* reply, uint64_t version)
+{
+    size_t prefix = strlen(UPLOAD_ACK_REPLY);
+    char* end = NULL;
+
+    if (reply == NULL || strncmp(reply, UPLOAD_ACK_REPLY, prefix) != 0 || reply[prefix] != ' ') {
+        return 0;
+    }
+    errno = 0;
+    unsigned long long acked = strtoull(reply + prefix + 1, &end, 10);
+    return errno == 0 && end != reply + prefix + 1 && *end == '\0' && acked == version;
+}
+
+static int upload_base64_value(char c)
+{
+    const char* p = (c != '\0') ? strchr(g_base64, c) : NULL;
+    return (p != NULL) ? (int)(p - g_base64) : -1;
+}
+
+ProjectStatus upload_decode_frame(const char* text, uint8_t* out, size_t cap, size_t* len)
+{
+    uint8_t frame[3 + LZ_BOUND(UPLOAD_FRAME_MAX)];
+    size_t frame_len = 0;
+    size_t text_len = strlen(text);
+
+    if (text_len == 0 || text_len % 4 != 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < text_len; i += 4) {
+        int v[4];
+        int bytes = 3;
+        for (int k = 0; k < 4; k++) {
+            v[k] = upload_base64_value(text[i + k]);
+            if (v[k] >= 0 && bytes < 3) {
+                return STATUS_ERR_INVALID_ARG;      /* Data after padding */
+            }
+            if (v[k] < 0) {
+                if (text[i + k] != '=' || k < 2 || i + 4 != text_len) {
+                    return STATUS_ERR_INVALID_ARG;
+                }
+                v[k] = 0;
+                if (bytes == 3) {
+                    bytes = k - 1;
+                }
+            }
+        }
+        uint32_t word = ((uint32_t)v[0] << 18) | ((uint32_t)v[1] << 12) | ((uint32_t)v[2] << 6) | (uint32_t)v[3];
+        for (int k = 0; k < bytes; k++) {
+            if (frame_len >= sizeof(frame)) {
+                return STATUS_ERR_INVALID_ARG;
+            }
+            frame[frame_len++] = (uint8_t)(word >> (16 - 8 * k));
+        }
+    }
+    if (frame_len < 1) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    if (frame[0] & UPLOAD_FRAME_LZ) {
+        size_t raw_len = 0;
+        if (frame_len < 3 || lz_decompress(frame + 3, frame_len - 3, out, cap, &raw_len) != STATUS_SUCCESS
+            || raw_len != ((size_t)frame[1] | ((size_t)frame[2] << 8))) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        *len = raw_len;
+        return STATUS_SUCCESS;
+    }
+    if (frame_len - 1 > cap) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    memcpy(out, frame + 1, frame_len - 1);
+    *len = frame_len - 1;
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus upload_apply_delta(upload_state_t* state, const tlv_field_t* delta)
+{
+    uint8_t fields[sizeof(state->fields)];
+    tlv_writer_t w;
+    tlv_reader_t r;
+    tlv_field_t field, other;
+    uint64_t cleared = 0;
+    size_t len = 0;
+
+    if (delta == NULL || delta->type != TLV_RECORD) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (tlv_find(delta->data, delta->len, RESULT_TAG_CLEARED, &field)) {
+        cleared = field.u;
+    }
+
+    /* Kept fields first, then the delta's, so every tag appears once */
+    tlv_writer_init(&w, fields, sizeof(fields));
+    tlv_reader_init(&r, state->fields, state->len);
+    while (tlv_next(&r, &field) == 1) {
+        int dropped = (field.tag < UPLOAD_CLEARED_TAGS) && (cleared & (1ull << field.tag));
+        if (!dropped && !tlv_find(delta->data, delta->len, field.tag, &other)) {
+            tlv_put_field(&w, &field);
+        }
+    }
+    tlv_open_record(delta, &r);
+    while (tlv_next(&r, &field) == 1) {
+        if (field.tag != RESULT_TAG_CLEARED) {
+            tlv_put_field(&w, &field);
+        }
+    }
+    if (tlv_finish(&w, &len) != STATUS_SUCCESS) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    memcpy(state->fields, fields, len);
+    state->len = (uint32_t)len;
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "worker_pool.h"
+#include "process.h"
+#include "modules.h"
+#include "ipc.h"
+
+static ProjectStatus pool_fork_worker(pool_worker_t* worker, const module_config_t* config)
+{
+    worker->fd = -1;
+    worker->served = 0;
+    worker->busy = 0;
+    worker->pid = spawn_module_worker(config, &worker->fd);
+    if (worker->pid < 0) {
+        worker->fd = -1;
+        return STATUS_ERR_FORK;
+    }
+    return STATUS_SUCCESS;
+}
+
+static void pool_stop_worker(pool_worker_t* worker, int graceful)
+{
+    if (worker->pid < 0) {
+        return;
+    }
+
+    /* A busy or broken worker can't be trusted to read the exit request */
+    if (graceful) {
+        if (ipc_send_request(worker->fd, IPC_OP_EXIT, -1, NULL, 0) != STATUS_SUCCESS) {
+            kill(worker->pid, SIGKILL);
+        }
+    } else {
+        kill(worker->pid, SIGKILL);
+    }
+
+    close(worker->fd);
+    wait_for_process_exit(worker->pid, NULL);
+    worker->pid = -1;
+    worker->fd = -1;
+    worker->busy = 0;
+}
+
+ProjectStatus pool_init(worker_pool_t* pool, uint32_t max_requests)
+{
+    if (pool == NULL || max_requests == 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pool->max_requests = max_requests;
+    for (int i = 0; i < MODULE_COUNT; i++) {
+        pool->workers[i].pid = -1;
+        pool->workers[i].fd = -1;
+    }
+
+    for (int i = 0; i < MODULE_COUNT; i++) {
+        const module_config_t* config = get_module_config(i);
+        if (config == NULL) {
+            continue;
+        }
+        if (pool_fork_worker(&pool->workers[i], config) != STATUS_SUCCESS) {
+            ERROR("Failed to pre-fork worker for %s", config->name);
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus pool_dispatch(worker_pool_t* pool, int mod_id, const char* arg, size_t arg_len, int* out_fd)
+{
+    if (pool == NULL || out_fd == NULL || mod_id < 0 || mod_id >= MODULE_COUNT) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    pool_worker_t* worker = &pool->workers[mod_id];
+    if (worker->pid < 0 || worker->busy) {
+        return STATUS_ERR_GENERIC;
+    }
+
+    if (ipc_send_request(worker->fd, IPC_OP_RUN, mod_id, arg, arg_len) != STATUS_SUCCESS) {
+        pool_stop_worker(worker, 0);
+        return STATUS_ERR_IPC_SEND;
+    }
+
+    worker->busy = 1;
+    worker->served++;
+    *out_fd = worker->fd;
+    return STATUS_SUCCESS;
+}
+
+void pool_release(worker_pool_t* pool, int mod_id, int healthy)
+{
+    if (pool == NULL || mod_id < 0 || mod_id >= MODULE_COUNT) {
+        return;
+    }
+
+    pool_worker_t* worker = &pool->workers[mod_id];
+    if (worker->pid < 0) {
+        return;
+    }
+    worker->busy = 0;
+    if (healthy && worker->served < pool->max_requests) {
+        return;
+    }
+
+    /* Recycle: an unhealthy worker may still be mid-request, so it is killed rather than asked */
+    pool_stop_worker(worker, healthy);
+    const module_config_t* config = get_module_config(mod_id);
+    if (config != NULL && pool_fork_worker(worker, config) != STATUS_SUCCESS) {
+        ERROR("Failed to recycle worker for %s", config->name);
+    }
+}
+
+void pool_destroy(worker_pool_t* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    for (int i = 0; i < MODULE_COUNT; i++) {
+        pool_stop_worker(&pool->workers[i], !pool->workers[i].busy);
+    }
+}
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "xml_abx.h"
+
+/* Token byte: low nibble is the command, high nibble the value type */
+#define ABX_START_DOCUMENT          0
+#define ABX_END_DOCUMENT            1
+#define ABX_START_TAG               2
+#define ABX_END_TAG                 3
+#define ABX_TEXT                    4
+#define ABX_CDSECT                  5
+#define ABX_ENTITY_REF              6
+#define ABX_IGNORABLE_WHITESPACE    7
+#define ABX_PROCESSING_INSTRUCTION  8
+#define ABX_COMMENT                 9
+#define ABX_DOCDECL                 10
+#define ABX_ATTRIBUTE               15
+
+#define ABX_TYPE_NULL               (1 << 4)
+#define ABX_TYPE_STRING             (2 << 4)
+#define ABX_TYPE_STRING_INTERNED    (3 << 4)
+#define ABX_TYPE_BYTES_HEX          (4 << 4)
+#define ABX_TYPE_BYTES_BASE64       (5 << 4)
+#define ABX_TYPE_INT                (6 << 4)
+#define ABX_TYPE_INT_HEX            (7 << 4)
+#define ABX_TYPE_LONG               (8 << 4)
+#define ABX_TYPE_LONG_HEX           (9 << 4)
+#define ABX_TYPE_FLOAT              (10 << 4)
+#define ABX_TYPE_DOUBLE             (11 << 4)
+#define ABX_TYPE_BOOLEAN_TRUE       (12 << 4)
+#define ABX_TYPE_BOOLEAN_FALSE      (13 << 4)
+
+#define ABX_INTERN_NEW              0xFFFF
+#define ABX_VALUE_TEXT_MAX          32      /* Longest text form of a typed value */
+
+static const uint8_t ABX_MAGIC[ABX_MAGIC_SIZE] = { 'A', 'B', 'X', 0x00 };
+
+typedef struct abx_reader_s {
+    const uint8_t* base;
+    const uint8_t* p;
+    const uint8_t* end;
+
+    /* Interned strings point into the document, nothing is copied */
+    xml_span_t* interned;
+    size_t interned_count;
+    size_t interned_cap;
+} abx_reader_t;
+
+/* An attribute value as found in the stream */
+typedef struct abx_value_s {
+    xml_value_type_e type;
+    xml_span_t text;
+    uint64_t raw;
+    int present;
+} abx_value_t;
+
+int xml_is_abx(const void* data, size_t size)
+{
+    return data != NULL && size >= ABX_MAGIC_SIZE && memcmp(data, ABX_MAGIC, ABX_MAGIC_SIZE) == 0;
+}
+
+static int abx_read_u16(abx_reader_t* r, uint16_t* out)
+{
+    if (r->end - r->p < 2) return -1;
+    *out = (uint16_t)((r->p[0] << 8) | r->p[1]);
+    r->p += 2;
+    return 0;
+}
+
+/* Big endian, as written by DataOutputStream */
+static int abx_read_be(abx_reader_t* r, size_t bytes, uint64_t* out)
+{
+    if ((size_t)(r->end - r->p) < bytes) return -1;
+    uint64_t v = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        v = (v << 8) | r->p[i];
+    }
+    r->p += bytes;
+    *out = v;
+    return 0;
+}
+
+/* Length-prefixed (modified) UTF-8, referenced in place */
+static int abx_read_utf(abx_reader_t* r, xml_span_t* out)
+{
+    uint16_t len;
+    if (abx_read_u16(r, &len) < 0 || (size_t)(r->end - r->p) < len) return -1;
+    out->ptr = (const char*)r->p;
+    out->len = len;
+    r->p += len;
+    return 0;
+}
+
+static int abx_read_interned(abx_reader_t* r, xml_span_t* out)
+{
+    uint16_t ref;
+    if (abx_read_u16(r, &ref) < 0) return -1;
+
+    if (ref != ABX_INTERN_NEW) {
+        if (ref >= r->interned_count) return -1;
+        *out = r->interned[ref];
+        return 0;
+    }
+
+    /* First occurrence: the string follows and gets the next table slot */
+    if (abx_read_utf(r, out) < 0) return -1;
+    if (r->interned_count == r->interned_cap) {
+        size_t cap = r->interned_cap ? r->interned_cap * 2 : 64;
+        xml_span_t* table = realloc(r->interned, cap * sizeof(*table));
+        if (table == NULL) return -1;
+        r->interned = table;
+        r->interned_cap = cap;
+    }
+    r->interned[r->interned_count++] = *out;
+    return 0;
+}
+
+/* Reads the payload that follows a token of the given type */
+static int abx_read_value(abx_reader_t* r, int type, abx_value_t* value)
+{
+    uint16_t len;
+    value->present = 1;
+    value->type = XML_VALUE_TEXT;
+    value->text.ptr = NULL;
+    value->text.len = 0;
+    value->raw = 0;
+
+    switch (type) {
+    case ABX_TYPE_NULL:
+        value->present = 0;
+        return 0;
+    case ABX_TYPE_STRING:
+        return abx_read_utf(r, &value->text);
+    case ABX_TYPE_STRING_INTERNED:
+        return abx_read_interned(r, &value->text);
+    case ABX_TYPE_BYTES_HEX:
+    case ABX_TYPE_BYTES_BASE64:
+        /* Not used by shared prefs: skipped, reported as absent */
+        if (abx_read_u16(r, &len) < 0 || (size_t)(r->end - r->p) < len) return -1;
+        r->p += len;
+        value->present = 0;
+        return 0;
+    case ABX_TYPE_INT:
+        value->type = XML_VALUE_INT;
+        return abx_read_be(r, 4, &value->raw);
+    case ABX_TYPE_INT_HEX:
+        value->type = XML_VALUE_INT_HEX;
+        return abx_read_be(r, 4, &value->raw);
+    case ABX_TYPE_LONG:
+        value->type = XML_VALUE_LONG;
+        return abx_read_be(r, 8, &value->raw);
+    case ABX_TYPE_LONG_HEX:
+        value->type = XML_VALUE_LONG_HEX;
+        return abx_read_be(r, 8, &value->raw);
+    case ABX_TYPE_FLOAT:
+        value->type = XML_VALUE_FLOAT;
+        return abx_read_be(r, 4, &value->raw);
+    case ABX_TYPE_DOUBLE:
+        value->type = XML_VALUE_DOUBLE;
+        return abx_read_be(r, 8, &value->raw);
+    case ABX_TYPE_BOOLEAN_TRUE:
+    case ABX_TYPE_BOOLEAN_FALSE:
+        value->type = XML_VALUE_BOOL;
+        value->raw = (type == ABX_TYPE_BOOLEAN_TRUE);
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Float.toString / Double.toString: the shortest digits that read back to the same value, in
+ * plain notation for 1e-3 <= |v| < 1e7 ("100.0", "0.001") and as "d.dddE<n>" otherwise ("1.0E10",
+ * "1.0E-4"). At least one digit follows the point. "NaN", "Infinity" and "-0.0" as Java writes them.
+ */
+static size_t xml_format_real(double v, int max_digits, int is_float, char* out_buf, size_t max_len)
+{
+    char tmp[ABX_VALUE_TEXT_MAX];
+    char digits[ABX_VALUE_TEXT_MAX];
+    char text[ABX_VALUE_TEXT_MAX + 8];
+    size_t n = 0;
+    size_t len = 0;
+
+    if (isnan(v)) {
+        return (size_t)snprintf(out_buf, max_len, "NaN");
+    }
+    if (isinf(v)) {
+        return (size_t)snprintf(out_buf, max_len, "%sInfinity", (v < 0) ? "-" : "");
+    }
+    if (v == 0) {
+        return (size_t)snprintf(out_buf, max_len, "%s0.0", signbit(v) ? "-" : "");
+    }
+
+    /* "-d.ddde[+-]x" with the fewest digits that round-trip, two at least: Java picks "1.4E-45" over "1.0E-45" */
+    for (int precision = 1; precision < max_digits; precision++) {
+        snprintf(tmp, sizeof(tmp), "%.*e", precision, v);
+        double back = strtod(tmp, NULL);
+        if (is_float ? ((float)back == (float)v) : (back == v)) {
+            break;
+        }
+    }
+    const char* exp_pos = strchr(tmp, 'e');
+    int exponent = (exp_pos != NULL) ? atoi(exp_pos + 1) : 0;
+    for (const char* p = tmp; p < exp_pos; p++) {
+        if (*p >= '0' && *p <= '9') digits[n++] = *p;
+    }
+    while (n > 1 && digits[n - 1] == '0') n--;
+
+    if (v < 0) text[len++] = '-';
+    double magnitude = fabs(v);
+    if (magnitude >= 1e-3 && magnitude < 1e7) {
+        if (exponent < 0) {
+            /* 0.000ddd */
+            text[len++] = '0';
+            text[len++] = '.';
+            for (int i = -1; i > exponent; i--) text[len++] = '0';
+            for (size_t i = 0; i < n; i++) text[len++] = digits[i];
+        } else {
+            /* ddd.ddd, padded with zeros on either side of the point */
+            for (int i = 0; i <= exponent; i++) text[len++] = ((size_t)i < n) ? digits[i] : '0';
+            text[len++] = '.';
+            if ((size_t)exponent + 1 >= n) {
+                text[len++] = '0';
+            }
+            for (size_t i = (size_t)exponent + 1; i < n; i++) text[len++] = digits[i];
+        }
+        text[len] = '\0';
+    } else {
+        text[len++] = digits[0];
+        text[len++] = '.';
+        if (n == 1) {
+            text[len++] = '0';
+        }
+        for (size_t i = 1; i < n; i++) text[len++] = digits[i];
+        snprintf(text + len, sizeof(text) - len, "E%d", exponent);
+    }
+    return (size_t)snprintf(out_buf, max_len, "%s", text);
+}
+
+static size_t xml_format_hex(int64_t v, char* out_buf, size_t max_len)
+{
+    /* Integer.toString(v, 16): signed, lower case */
+    if (v < 0) {
+        return (size_t)snprintf(out_buf, max_len, "-%llx", (unsigned long long)(-(uint64_t)v));
+    }
+    return (size_t)snprintf(out_buf, max_len, "%llx", (unsigned long long)v);
+}
+
+size_t xml_format_value(xml_value_type_e type, uint64_t raw, char* out_buf, size_t max_len)
+{
+    union { uint32_t u; float f; } f32;
+    union { uint64_t u; double d; } f64;
+    if (out_buf == NULL || max_len == 0) {
+        return 0;
+    }
+
+    switch (type) {
+    case XML_VALUE_INT:
+        return (size_t)snprintf(out_buf, max_len, "%d", (int32_t)(uint32_t)raw);
+    case XML_VALUE_INT_HEX:
+        return xml_format_hex((int32_t)(uint32_t)raw, out_buf, max_len);
+    case XML_VALUE_LONG:
+        return (size_t)snprintf(out_buf, max_len, "%lld", (long long)(int64_t)raw);
+    case XML_VALUE_LONG_HEX:
+        return xml_format_hex((int64_t)raw, out_buf, max_len);
+    case XML_VALUE_FLOAT:
+        f32.u = (uint32_t)raw;
+        return xml_format_real(f32.f, 9, 1, out_buf, max_len);
+    case XML_VALUE_DOUBLE:
+        f64.u = raw;
+        return xml_format_real(f64.d, 17, 0, out_buf, max_len);
+    case XML_VALUE_BOOL:
+        return (size_t)snprintf(out_buf, max_len, "%s", raw ? "true" : "false");
+    default:
+        out_buf[0] = '\0';
+        return 0;
+    }
+}
+
+/* Hands the element collected so far to the visitor. Returns non-zero if it asked to stop */
+static int abx_emit(const abx_reader_t* r, xml_span_t name, const abx_value_t* value,
+                    xml_entry_fn fn, void* user)
+{
+    xml_entry_t entry;
+
+    entry.name = name;
+    entry.name_offset = (uint64_t)((const uint8_t*)name.ptr - r->base);
+    entry.value.ptr = NULL;
+    entry.value.len = 0;
+    entry.value_offset = 0;
+    entry.type = XML_VALUE_TEXT;
+    entry.raw = 0;
+
+    if (value->present && value->type == XML_VALUE_TEXT) {
+        entry.value = value->text;
+        entry.value_offset = (uint64_t)((const uint8_t*)value->text.ptr - r->base);
+    } else if (value->present) {
+        entry.type = value->type;
+        entry.raw = value->raw;
+        entry.value.ptr = "";     /* Present, rendered only by visitors that want the text */
+    }
+    return fn(user, &entry);
+}
+
+ProjectStatus abx_for_each_entry(const uint8_t* data, size_t size, xml_entry_fn fn, void* user)
+{
+    abx_reader_t r = { data, data + ABX_MAGIC_SIZE, data + size, NULL, 0, 0 };
+    ProjectStatus status = STATUS_SUCCESS;
+    if (!xml_is_abx(data, size) || fn == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    /* Element being collected: its name attribute and value (attribute or following text) */
+    xml_span_t name = { NULL, 0 };
+    abx_value_t value = { XML_VALUE_TEXT, { NULL, 0 }, 0, 0 };
+    int in_element = 0;
+
+    while (r.p < r.end) {
+        uint8_t token = *r.p++;
+        int command = token & 0x0F;
+        int type = token & 0xF0;
+
+        if (command == ABX_ATTRIBUTE) {
+            xml_span_t attr_name;
+            abx_value_t attr_value;
+            if (abx_read_interned(&r, &attr_name) < 0 || abx_read_value(&r, type, &attr_value) < 0) {
+                status = STATUS_ERR_XML_PARSER;
+                break;
+            }
+            if (!in_element) continue;
+            if (attr_name.len == 4 && memcmp(attr_name.ptr, "name", 4) == 0 && attr_value.type == XML_VALUE_TEXT) {
+                name = attr_value.text;
+            } else if (attr_name.len == 5 && memcmp(attr_name.ptr, "value", 5) == 0) {
+                value = attr_value;
+            }
+            continue;
+        }
+
+        /* Any other token ends the attribute list of the current element */
+        abx_value_t token_value;
+        if (command == ABX_START_TAG || command == ABX_END_TAG) {
+            xml_span_t tag;
+            if (abx_read_interned(&r, &tag) < 0) {
+                status = STATUS_ERR_XML_PARSER;
+                break;
+            }
+            token_value.present = 0;
+        } else if (command <= ABX_DOCDECL) {
+            if (abx_read_value(&r, type, &token_value) < 0) {
+                status = STATUS_ERR_XML_PARSER;
+                break;
+            }
+        } else {
+            status = STATUS_ERR_XML_PARSER;
+            break;
+        }
+
+        if (in_element && name.ptr != NULL) {
+            /* Option 2: '<string name="key">value</string>' */
+            if (!value.present && (command == ABX_TEXT || command == ABX_CDSECT)
+                && token_value.present && token_value.text.len > 0) {
+                value = token_value;
+            }
+            if (abx_emit(&r, name, &value, fn, user)) break;
+        }
+
+        in_element = (command == ABX_START_TAG);
+        name.ptr = NULL;
+        name.len = 0;
+        value.present = 0;
+        if (command == ABX_END_DOCUMENT) break;
+    }
+
+    free(r.interned);
+    return status;
+}
@@ -0,0 +1,368 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "xml_index.h"
+#include "xml_utils.h"
+
+#define XML_INDEX_MAGIC     0x58444958u     /* "XIDX" */
+#define XML_INDEX_VERSION   2
+#define XML_INDEX_MAX_KEYS  (1u << 20)
+
+/* On-disk layout: this header, then 'count' entries, then 'names_len' bytes of names */
+typedef struct xml_index_file_s {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t count;
+    uint32_t names_len;
+} xml_index_file_t;
+
+typedef struct xml_index_slot_s {
+    char* path;
+    xml_index_t* idx;
+} xml_index_slot_t;
+
+static xml_index_slot_t g_slots[XML_INDEX_CACHE_SLOTS];
+static size_t g_next_slot = 0;
+
+static uint32_t xml_index_hash(const char* s, size_t len)
+{
+    uint32_t h = 2166136261u;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static int xml_index_matches(const xml_index_t* idx, const struct stat* st)
+{
+    return idx->dev == (uint64_t)st->st_dev && idx->ino == (uint64_t)st->st_ino
+        && idx->size == (uint64_t)st->st_size
+        && idx->mtime_sec == (int64_t)st->st_mtim.tv_sec && idx->mtime_nsec == (int64_t)st->st_mtim.tv_nsec;
+}
+
+static int xml_index_entry_cmp(const void* a, const void* b)
+{
+    const xml_index_entry_t* ea = a;
+    const xml_index_entry_t* eb = b;
+    if (ea->hash != eb->hash) return (ea->hash < eb->hash) ? -1 : 1;
+    /* Document order for equal hashes, so duplicates resolve to the first occurrence */
+    if (ea->name_off != eb->name_off) return (ea->name_off < eb->name_off) ? -1 : 1;
+    return 0;
+}
+
+void xml_index_free(xml_index_t* idx)
+{
+    if (idx == NULL) {
+        return;
+    }
+    free(idx->entries);
+    free(idx->names);
+    free(idx);
+}
+
+/* Build visitor: records every entry that carries a value */
+typedef struct xml_index_builder_s {
+    xml_index_t* idx;
+    uint32_t entries_cap;
+    uint32_t names_cap;
+    int failed;
+} xml_index_builder_t;
+
+static int xml_index_visit(void* user, const xml_entry_t* entry)
+{
+    xml_index_builder_t* b = user;
+    xml_index_t* idx = b->idx;
+    if (entry->value.ptr == NULL) {
+        return 0;
+    }
+    if (idx->count >= XML_INDEX_MAX_KEYS || entry->value.len > UINT32_MAX
+        || entry->name.len > UINT32_MAX - idx->names_len) {
+        b->failed = 1;
+        return 1;
+    }
+
+    if (idx->count == b->entries_cap) {
+        uint32_t cap = b->entries_cap ? b->entries_cap * 2 : 64;
+        xml_index_entry_t* entries = realloc(idx->entries, cap * sizeof(*entries));
+        if (entries == NULL) { b->failed = 1; return 1; }
+        idx->entries = entries;
+        b->entries_cap = cap;
+    }
+    while (idx->names_len + entry->name.len > b->names_cap) {
+        uint32_t cap = b->names_cap ? b->names_cap * 2 : 1024;
+        char* names = realloc(idx->names, cap);
+        if (names == NULL) { b->failed = 1; return 1; }
+        idx->names = names;
+        b->names_cap = cap;
+    }
+
+    xml_index_entry_t* e = &idx->entries[idx->count++];
+    e->hash = xml_index_hash(entry->name.ptr, entry->name.len);
+    e->name_off = idx->names_len;
+    e->name_len = (uint32_t)entry->name.len;
+    e->type = (uint32_t)entry->type;
+    e->reserved = 0;
+    if (entry->type == XML_VALUE_TEXT) {
+        e->value_len = (uint32_t)entry->value.len;
+        e->value_off = entry->value_offset;
+    } else {
+        e->value_len = 0;
+        e->value_off = entry->raw;
+    }
+    memcpy(idx->names + idx->names_len, entry->name.ptr, entry->name.len);
+    idx->names_len += (uint32_t)entry->name.len;
+    return 0;
+}
+
+xml_index_t* xml_index_build(int fd, const struct stat* st)
+{
+    if (fd < 0 || st == NULL || st->st_size < 0) {
+        return NULL;
+    }
+
+    xml_index_t* idx = calloc(1, sizeof(*idx));
+    if (idx == NULL) {
+        return NULL;
+    }
+    idx->dev = (uint64_t)st->st_dev;
+    idx->ino = (uint64_t)st->st_ino;
+    idx->size = (uint64_t)st->st_size;
+    idx->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    idx->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+
+    xml_index_builder_t builder = { idx, 0, 0, 0 };
+    if (xml_for_each_entry(fd, (size_t)st->st_size, xml_index_visit, &builder) != STATUS_SUCCESS
+        || builder.failed) {
+        xml_index_free(idx);
+        return NULL;
+    }
+
+    if (idx->count > 0) {
+        qsort(idx->entries, idx->count, sizeof(*idx->entries), xml_index_entry_cmp);
+    }
+    return idx;
+}
+
+const xml_index_entry_t* xml_index_find(const xml_index_t* idx, const char* key, size_t key_len)
+{
+    if (idx == NULL || key == NULL) {
+        return NULL;
+    }
+
+    /* Lower bound on the hash, then compare names among the (rare) collisions */
+    uint32_t hash = xml_index_hash(key, key_len);
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->entries[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    for (; lo < idx->count && idx->entries[lo].hash == hash; lo++) {
+        const xml_index_entry_t* e = &idx->entries[lo];
+        if (e->name_len == key_len && memcmp(idx->names + e->name_off, key, key_len) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static int xml_write_all(int fd, const void* buf, size_t len)
+{
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int xml_read_all(int fd, void* buf, size_t len)
+{
+    char* p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+ProjectStatus xml_index_save(const xml_index_t* idx, const char* cache_path)
+{
+    char tmp_path[256];
+    if (idx == NULL || cache_path == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    xml_index_file_t hdr = {
+        .magic = XML_INDEX_MAGIC, .version = XML_INDEX_VERSION,
+        .dev = idx->dev, .ino = idx->ino, .size = idx->size,
+        .mtime_sec = idx->mtime_sec, .mtime_nsec = idx->mtime_nsec,
+        .count = idx->count, .names_len = idx->names_len
+    };
+
+    /* Written aside and renamed, so a concurrent reader never sees a partial index */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", cache_path, (int)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    if (xml_write_all(fd, &hdr, sizeof(hdr)) < 0
+        || xml_write_all(fd, idx->entries, idx->count * sizeof(*idx->entries)) < 0
+        || xml_write_all(fd, idx->names, idx->names_len) < 0) {
+        close(fd);
+        unlink(tmp_path);
+        return STATUS_ERR_GENERIC;
+    }
+    close(fd);
+
+    if (rename(tmp_path, cache_path) < 0) {
+        unlink(tmp_path);
+        return STATUS_ERR_GENERIC;
+    }
+    return STATUS_SUCCESS;
+}
+
+ProjectStatus xml_index_load(const char* cache_path, xml_index_t** out_idx)
+{
+    xml_index_file_t hdr;
+    if (cache_path == NULL || out_idx == NULL) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    *out_idx = NULL;
+
+    int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return STATUS_ERR_OPEN_ERROR;
+    }
+
+    xml_index_t* idx = calloc(1, sizeof(*idx));
+    if (idx == NULL || xml_read_all(fd, &hdr, sizeof(hdr)) < 0
+        || hdr.magic != XML_INDEX_MAGIC || hdr.version != XML_INDEX_VERSION || hdr.count > XML_INDEX_MAX_KEYS) {
+        goto fail;
+    }
+
+    idx->dev = hdr.dev;
+    idx->ino = hdr.ino;
+    idx->size = hdr.size;
+    idx->mtime_sec = hdr.mtime_sec;
+    idx->mtime_nsec = hdr.mtime_nsec;
+    idx->count = hdr.count;
+    idx->names_len = hdr.names_len;
+    idx->entries = malloc((hdr.count ? hdr.count : 1) * sizeof(*idx->entries));
+    idx->names = malloc(hdr.names_len ? hdr.names_len : 1);
+    if (idx->entries == NULL || idx->names == NULL
+        || xml_read_all(fd, idx->entries, hdr.count * sizeof(*idx->entries)) < 0
+        || xml_read_all(fd, idx->names, hdr.names_len) < 0) {
+        goto fail;
+    }
+
+    /* Never trust offsets coming from disk */
+    for (uint32_t i = 0; i < idx->count; i++) {
+        const xml_index_entry_t* e = &idx->entries[i];
+        if ((uint64_t)e->name_off + e->name_len > idx->names_len || e->type > XML_VALUE_BOOL
+            || (e->type == XML_VALUE_TEXT && e->value_off + e->value_len > idx->size)) {
+            goto fail;
+        }
+    }
+
+    close(fd);
+    *out_idx = idx;
+    return STATUS_SUCCESS;
+
+fail:
+    close(fd);
+    xml_index_free(idx);
+    return STATUS_ERR_READ_ERROR;
+}
+
+void xml_index_cache_clear(void)
+{
+    for (size_t i = 0; i < XML_INDEX_CACHE_SLOTS; i++) {
+        free(g_slots[i].path);
+        xml_index_free(g_slots[i].idx);
+        g_slots[i].path = NULL;
+        g_slots[i].idx = NULL;
+    }
+}
+
+static const xml_index_t* xml_index_remember(const char* file_path, xml_index_t* idx)
+{
+    xml_index_slot_t* slot = &g_slots[g_next_slot];
+    g_next_slot = (g_next_slot + 1) % XML_INDEX_CACHE_SLOTS;
+
+    char* path = strdup(file_path);
+    if (path == NULL) {
+        xml_index_free(idx);
+        return NULL;
+    }
+    free(slot->path);
+    xml_index_free(slot->idx);
+    slot->path = path;
+    slot->idx = idx;
+    return idx;
+}
+
+const xml_index_t* xml_index_get(const char* file_path, int fd, const struct stat* st)
+{
+    char cache_path[128];
+    xml_index_t* idx = NULL;
+    if (file_path == NULL || fd < 0 || st == NULL) {
+        return NULL;
+    }
+
+    /* 1. In memory */
+    for (size_t i = 0; i < XML_INDEX_CACHE_SLOTS; i++) {
+        xml_index_slot_t* slot = &g_slots[i];
+        if (slot->path == NULL || strcmp(slot->path, file_path) != 0) continue;
+        if (xml_index_matches(slot->idx, st)) {
+            return slot->idx;
+        }
+        free(slot->path);
+        xml_index_free(slot->idx);
+        slot->path = NULL;
+        slot->idx = NULL;
+    }
+
+    /* 2. Persisted by a previous run */
+    snprintf(cache_path, sizeof(cache_path), "%s/%08x.idx", XML_INDEX_CACHE_DIR,
+             xml_index_hash(file_path, strlen(file_path)));
+    if (xml_index_load(cache_path, &idx) == STATUS_SUCCESS) {
+        if (xml_index_matches(idx, st)) {
+            return xml_index_remember(file_path, idx);
+        }
+        xml_index_free(idx);
+        idx = NULL;
+    }
+
+    /* 3. Parse once and persist for the next run. Failing to persist is not an error */
+    idx = xml_index_build(fd, st);
+    if (idx == NULL) {
+        return NULL;
+    }
+    if (mkdir(XML_INDEX_CACHE_DIR, 0771) == 0 || errno == EEXIST) {
+        xml_index_save(idx, cache_path);
+    }
+    return xml_index_remember(file_path, idx);
+}
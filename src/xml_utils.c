@@ -1,141 +1,342 @@
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "xml_utils.h"
+#include "xml_index.h"
+#include "xml_abx.h"
 
-#define MAX_TAG_SIZE 1024
-#define MAX_XML_SIZE 16384  // 16KB
+#define XML_MMAP_MAX    (256 * 1024 * 1024)     /* Larger files are streamed instead of mapped */
+#define XML_WINDOW_SIZE (64 * 1024)             /* Streaming window, also the largest single tag */
 
-static ProjectStatus xml_get_attribute(const char* tag_content, const char* attr_name, char* out_val, size_t max_len)
+/*
+ * All boundary searches go through memchr: glibc and bionic ship SSE2/AVX2/NEON versions of it,
+ * so text and quoted values are skipped 16-32 bytes at a time.
+ */
+static inline const char* xml_find(const char* p, const char* end, char c)
 {
-    char quote = 0;
-    char search[64] = { 0 };
-    size_t search_len = 0, i = 0;
-    const char* p = tag_content;
-    snprintf(search, sizeof(search), "%s=", attr_name);
-    search_len = strlen(search);
-
-    while ((p = strstr(p, search)) != NULL)
-    {
-        if (p == tag_content || isspace((unsigned char)*(p - 1)))
-        {
-            p += search_len;
-            quote = *p++;
-            if (quote != '"' && quote != '\'') {
-                return -1;
-            }
+    return (p < end) ? memchr(p, c, (size_t)(end - p)) : NULL;
+}
 
-            i = 0;
-            while (*p && *p != quote && i < max_len - 1) {
-                out_val[i++] = *p++;
-            }
-            out_val[i] = '\0';
-            return STATUS_SUCCESS;
+static inline const char* xml_skip_space(const char* p, const char* end)
+{
+    while (p < end && isspace((unsigned char)*p)) p++;
+    return p;
+}
+
+static inline int xml_span_equals(xml_span_t span, const char* str, size_t str_len)
+{
+    return span.len == str_len && memcmp(span.ptr, str, str_len) == 0;
+}
+
+static void xml_copy_out(xml_span_t value, char* out_buf, size_t out_buf_len)
+{
+    size_t len = (value.len >= out_buf_len) ? out_buf_len - 1 : value.len;  /* Truncate */
+    memcpy(out_buf, value.ptr, len);
+    out_buf[len] = '\0';
+}
+
+/*
+ * Parses the attributes of the tag starting at 'p' (just after its name), up to its closing '>'.
+ * Quoted values are skipped as a whole, so a '>' inside a value does not end the tag.
+ * Returns the position of the closing '>', or NULL if the tag does not end before 'end'.
+ */
+static const char* xml_parse_attributes(const char* p, const char* end, xml_span_t* name, xml_span_t* value)
+{
+    name->ptr = NULL;
+    value->ptr = NULL;
+
+    for (;;) {
+        p = xml_skip_space(p, end);
+        if (p >= end) return NULL;
+        if (*p == '>') return p;
+        if (*p == '/') { p++; continue; }
+
+        /* Attribute name */
+        const char* attr = p;
+        while (p < end && *p != '=' && *p != '>' && *p != '/' && !isspace((unsigned char)*p)) p++;
+        xml_span_t attr_name = { attr, (size_t)(p - attr) };
+
+        p = xml_skip_space(p, end);
+        if (p >= end) return NULL;
+        if (*p != '=') continue;    /* Valueless attribute, not something shared prefs write */
+        p = xml_skip_space(p + 1, end);
+        if (p >= end) return NULL;
+
+        char quote = *p;
+        if (quote != '"' && quote != '\'') {
+            /* Malformed value: let the caller resync on the next '>' */
+            return xml_find(p, end, '>');
         }
-        p++;
+        const char* close = xml_find(p + 1, end, quote);
+        if (close == NULL) return NULL;
+
+        xml_span_t attr_value = { p + 1, (size_t)(close - p - 1) };
+        if (xml_span_equals(attr_name, "name", 4)) {
+            *name = attr_value;
+        } else if (xml_span_equals(attr_name, "value", 5)) {
+            *value = attr_value;
+        }
+        p = close + 1;
     }
-    return STATUS_ERR_XML_PARSER;
 }
 
-static ProjectStatus xml_extract_logic(const char* xml, const char* target_name, char* out_buf, size_t out_buf_len)
+/*
+ * Single pass over [begin, end): looks at every tag that starts before 'limit'.
+ * Those tags, and the text that follows them, are guaranteed to be complete in the buffer.
+ * 'base_offset' is the file offset of 'begin'. '*resume' is set to the first byte not consumed.
+ * Returns 1 if the callback asked to stop.
+ */
+static int xml_scan(const char* begin, const char* end, const char* limit, uint64_t base_offset,
+                    xml_entry_fn fn, void* user, const char** resume)
 {
-    char* tag_end = NULL;
-    const char* cursor = xml;
-    char name_val[128] = { 0 };
-    size_t len = 0, tag_len = 0;
-    char tag_content[MAX_TAG_SIZE] = { 0 };
-    if (xml == NULL || target_name == NULL || out_buf == NULL || out_buf_len == 0) {
-        return STATUS_ERR_INVALID_ARG;
-    }
+    const char* cursor = begin;
 
     /* Iterate each tag */
-    while ((cursor = strchr(cursor, '<')) != NULL)
+    while ((cursor = xml_find(cursor, limit, '<')) != NULL)
     {
-        if (cursor[1] == '/' || cursor[1] == '?' || cursor[1] == '!') {
-            cursor++;
+        const char* tag = cursor;
+        if (tag + 1 >= end) break;
+        if (tag[1] == '/' || tag[1] == '?' || tag[1] == '!') {
+            cursor = tag + 1;
             continue;
         }
-        /* Get current tag content (up to MAX_TAG_SIZE bytes) */
-        tag_end = strchr(cursor, '>');
+
+        /* Skip the element name, then look at its attributes in place */
+        const char* p = tag + 1;
+        while (p < end && *p != '>' && *p != '/' && !isspace((unsigned char)*p)) p++;
+
+        xml_entry_t entry;
+        entry.type = XML_VALUE_TEXT;
+        entry.raw = 0;
+        const char* tag_end = xml_parse_attributes(p, end, &entry.name, &entry.value);
         if (tag_end == NULL) {
+            cursor = tag;
             break;
         }
-        tag_len = tag_end - cursor;
-        if (tag_len >= sizeof(tag_content)) {   /* Truncate */
-            tag_len = sizeof(tag_content) - 1;
-        }
-        memset(tag_content, 0, sizeof(tag_content));
-        memcpy(tag_content, cursor, tag_len); 
-        tag_content[tag_len] = '\0';
 
-        /* Search for our key, and extract its content. Assumes it's stored as one of those options: */
+        /* Entries are stored as one of those options: */
         /* Option 1: 'name="my_key" value="my_value"/>' */
         /* Option 2: 'name="my_key">my_value<' */
-        memset(name_val, 0, sizeof(name_val));
-        if (xml_get_attribute(tag_content, "name", name_val, sizeof(name_val)) == STATUS_SUCCESS
-            && strncmp(name_val, target_name, sizeof(name_val)) == 0)
-        {
-                /* Option 1*/
-                if (xml_get_attribute(tag_content, "value", out_buf, out_buf_len) == STATUS_SUCCESS) {
-                    return STATUS_SUCCESS;
-                }
-                /* Option 2 */
-                const char* content_start = tag_end + 1;
-                const char* content_end = strchr(content_start, '<');
-                if (content_end != NULL) {
-                    len = content_end - content_start;
-                    if (len >= out_buf_len) {   /* Truncate */
-                        len = out_buf_len - 1;
-                    }
-                    if (len > 0) {
-                        memcpy(out_buf, content_start, len);
-                        out_buf[len] = '\0';
-                        return STATUS_SUCCESS;
-                    }
+        if (entry.name.ptr != NULL) {
+            if (entry.value.ptr == NULL) {
+                const char* content_end = xml_find(tag_end + 1, end, '<');
+                if (content_end != NULL && content_end > tag_end + 1) {
+                    entry.value.ptr = tag_end + 1;
+                    entry.value.len = (size_t)(content_end - tag_end - 1);
                 }
+            }
+            entry.name_offset = base_offset + (uint64_t)(entry.name.ptr - begin);
+            entry.value_offset = (entry.value.ptr != NULL) ? base_offset + (uint64_t)(entry.value.ptr - begin) : 0;
+            if (fn(user, &entry)) {
+                return 1;
+            }
         }
         cursor = tag_end + 1;
     }
 
-    return STATUS_ERR_XML_PARSER;
+    *resume = (cursor != NULL) ? cursor : limit;
+    return 0;
 }
 
-ProjectStatus xml_get_value(const char* file_path, const char* key, char* out_buf, size_t max_len)
+/* Files too large to map (or on filesystems without mmap) are read in fixed windows */
+static ProjectStatus xml_stream_entries(int fd, xml_entry_fn fn, void* user)
+{
+    size_t fill = 0;
+    int eof = 0;
+    uint64_t window_offset = 0;
+    ProjectStatus status = STATUS_SUCCESS;
+    char* window = malloc(XML_WINDOW_SIZE);
+    if (window == NULL) {
+        return STATUS_ERR_READ_ERROR;
+    }
+
+    while (!eof)
+    {
+        ssize_t bytes_read = read(fd, window + fill, XML_WINDOW_SIZE - fill);
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            status = STATUS_ERR_READ_ERROR;
+            break;
+        }
+        eof = (bytes_read == 0);
+        fill += (size_t)bytes_read;
+        if (!eof && fill < XML_WINDOW_SIZE) {
+            continue;   /* Short read, fill the window first */
+        }
+
+        /* Everything before the last '<' is complete, the tail is carried over to the next window */
+        const char* end = window + fill;
+        const char* limit = eof ? end : memrchr(window, '<', fill);
+        if (limit == NULL || limit == window) {
+            if (!eof) {
+                /* A single tag larger than the window: not a shared prefs file */
+                status = STATUS_ERR_XML_PARSER;
+                break;
+            }
+            limit = end;
+        }
+
+        const char* resume = limit;
+        if (xml_scan(window, end, limit, window_offset, fn, user, &resume)) break;
+
+        if (resume == window && fill == XML_WINDOW_SIZE) {
+            status = STATUS_ERR_XML_PARSER;     /* No progress possible within one window */
+            break;
+        }
+        window_offset += (uint64_t)(resume - window);
+        fill = (size_t)(end - resume);
+        memmove(window, resume, fill);
+    }
+
+    free(window);
+    return status;
+}
+
+ProjectStatus xml_for_each_entry(int fd, size_t size, xml_entry_fn fn, void* user)
 {
-    size_t total_read = 0;
-    ssize_t bytes_read = 0;
-    char file_buf[MAX_XML_SIZE] = { 0 };
-    if (file_path == NULL || key == NULL || out_buf == NULL || max_len == 0) {
-        DEBUG("xml_get_value: Invalid arguments");
+    if (fd < 0 || fn == NULL) {
         return STATUS_ERR_INVALID_ARG;
     }
 
-    int shared_pref_fd = open(file_path, O_RDONLY);
-    if (shared_pref_fd < 0) {
-        DEBUG("xml_get_value: Failed to open %s", file_path);
-        return STATUS_ERR_OPEN_ERROR;
+    void* map = MAP_FAILED;
+    if (size > 0 && size <= XML_MMAP_MAX) {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        /* Binary XML references earlier bytes (string table), so it can't be streamed */
+        char magic[ABX_MAGIC_SIZE];
+        if (pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) && xml_is_abx(magic, sizeof(magic))) {
+            return STATUS_ERR_XML_PARSER;
+        }
+        if (lseek(fd, 0, SEEK_SET) < 0) {
+            return STATUS_ERR_READ_ERROR;
+        }
+        return xml_stream_entries(fd, fn, user);
     }
 
-    while (total_read < sizeof(file_buf) - 1)
-    {
-        bytes_read = read(shared_pref_fd, file_buf + total_read, sizeof(file_buf) - total_read - 1);
-        if (bytes_read < 0) {
-            if (errno == EINTR) {
-                continue;
+    ProjectStatus status = STATUS_SUCCESS;
+    madvise(map, size, MADV_SEQUENTIAL);
+    if (xml_is_abx(map, size)) {
+        status = abx_for_each_entry(map, size, fn, user);
+    } else {
+        const char* xml = map;
+        const char* resume = NULL;
+        xml_scan(xml, xml + size, xml + size, 0, fn, user, &resume);
+    }
+    munmap(map, size);
+    return status;
+}
+
+/* Batch lookup visitor: resolves every pending query matching the entry, stops once all are done */
+typedef struct xml_batch_s {
+    xml_query_t* queries;
+    size_t count;
+    size_t pending;
+} xml_batch_t;
+
+static int xml_batch_visit(void* user, const xml_entry_t* entry)
+{
+    xml_batch_t* batch = user;
+    if (entry->value.ptr == NULL) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < batch->count; i++) {
+        xml_query_t* q = &batch->queries[i];
+        if (q->status != STATUS_SUCCESS && xml_span_equals(entry->name, q->key, strlen(q->key))) {
+            if (entry->type != XML_VALUE_TEXT) {
+                xml_format_value(entry->type, entry->raw, q->out_buf, q->max_len);
             } else {
-                close(shared_pref_fd);
-                return STATUS_ERR_READ_ERROR;
+                xml_copy_out(entry->value, q->out_buf, q->max_len);
             }
-        } else if (bytes_read == 0) {
-            break; /* EOF */
+            q->status = STATUS_SUCCESS;
+            batch->pending--;
         }
-        total_read += bytes_read;
     }
+    return batch->pending == 0;
+}
+
+/* Fast path: answers every query from the parsed index, values are read with pread */
+static void xml_lookup_indexed(int fd, const xml_index_t* idx, xml_query_t* queries, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        xml_query_t* q = &queries[i];
+        const xml_index_entry_t* e = xml_index_find(idx, q->key, strlen(q->key));
+        if (e == NULL) {
+            continue;
+        }
+        if (e->type != XML_VALUE_TEXT) {
+            /* Typed (ABX) value, kept in the index itself */
+            xml_format_value((xml_value_type_e)e->type, e->value_off, q->out_buf, q->max_len);
+            q->status = STATUS_SUCCESS;
+            continue;
+        }
+
+        size_t len = (e->value_len >= q->max_len) ? q->max_len - 1 : e->value_len;     /* Truncate */
+        ssize_t got;
+        do {
+            got = pread(fd, q->out_buf, len, (off_t)e->value_off);
+        } while (got < 0 && errno == EINTR);
+
+        if (got == (ssize_t)len) {
+            q->out_buf[len] = '\0';
+            q->status = STATUS_SUCCESS;
+        } else {
+            q->status = STATUS_ERR_READ_ERROR;
+        }
+    }
+}
+
+ProjectStatus xml_get_values(const char* file_path, xml_query_t* queries, size_t count)
+{
+    struct stat st;
+    ProjectStatus status = STATUS_SUCCESS;
+    if (file_path == NULL || queries == NULL || count == 0) {
+        DEBUG("xml_get_values: Invalid arguments");
+        return STATUS_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (queries[i].key == NULL || queries[i].out_buf == NULL || queries[i].max_len == 0) {
+            return STATUS_ERR_INVALID_ARG;
+        }
+        queries[i].status = STATUS_ERR_XML_PARSER;
+    }
+
+    int shared_pref_fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (shared_pref_fd < 0) {
+        DEBUG("xml_get_values: Failed to open %s", file_path);
+        return STATUS_ERR_OPEN_ERROR;
+    }
+    if (fstat(shared_pref_fd, &st) < 0) {
+        close(shared_pref_fd);
+        return STATUS_ERR_READ_ERROR;
+    }
+
+    /* Unchanged file: no parsing at all. Otherwise a single pass resolves every key */
+    const xml_index_t* idx = xml_index_get(file_path, shared_pref_fd, &st);
+    if (idx != NULL) {
+        xml_lookup_indexed(shared_pref_fd, idx, queries, count);
+    } else {
+        xml_batch_t batch = { queries, count, count };
+        status = xml_for_each_entry(shared_pref_fd, (size_t)st.st_size, xml_batch_visit, &batch);
+    }
+
     close(shared_pref_fd);
-    file_buf[total_read] = '\0';
-    return xml_extract_logic(file_buf, key, out_buf, max_len);
-}
\ No newline at end of file
+    return status;
+}
+
+ProjectStatus xml_get_value(const char* file_path, const char* key, char* out_buf, size_t max_len)
+{
+    xml_query_t query = { .key = key, .out_buf = out_buf, .max_len = max_len };
+
+    ProjectStatus status = xml_get_values(file_path, &query, 1);
+    return (status == STATUS_SUCCESS) ? query.status : status;
+}
@@ -0,0 +1,282 @@
+/*
+ * Microbenchmark of module responses (ipc.h): the framed header + payload path against the fixed
+ * 4 KiB packet it replaced (memset, strncpy, send/recv of the whole struct over SOCK_DGRAM).
+ * Usage: ipc_bench [<iterations>]
+ * Both ends live in this process: each iteration is one send and one receive. Prints bytes on the
+ * socket, wall time and system (syscall) time per message for a few payload sizes.
+ * Large results go through a sealed memfd instead (ipc_send_blob / ipc_map_blob): that path is
+ * checked (content, unsealed and oversized blobs rejected, fds released), then timed.
+ * Exits non-zero if a check failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "ipc.h"
+
+/* The old wire format: the whole struct, whatever the payload */
+typedef struct legacy_packet_s {
+    int32_t status_code;
+    int32_t data_len;
+    char payload[IPC_PACKET_SIZE - 2 * sizeof(int32_t)];
+} legacy_packet_t;
+
+static volatile uint64_t g_sink;
+static int g_failures;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t stime_ns(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t)ru.ru_stime.tv_sec * 1000000000ull + (uint64_t)ru.ru_stime.tv_usec * 1000ull;
+}
+
+static size_t legacy_round_trip(int fd[2], const char* data)
+{
+    static legacy_packet_t out, in;
+
+    memset(&out, 0, sizeof(out));
+    out.status_code = STATUS_SUCCESS;
+    strncpy(out.payload, data, sizeof(out.payload) - 1);
+    out.data_len = (int32_t)strlen(out.payload);
+    if (send(fd[1], &out, sizeof(out), 0) != (ssize_t)sizeof(out)
+        || recv(fd[0], &in, sizeof(in), 0) != (ssize_t)sizeof(in)) {
+        return 0;
+    }
+    g_sink += (uint64_t)in.data_len;
+    return sizeof(out);
+}
+
+static size_t framed_round_trip(int fd[2], const char* data)
+{
+    static ipc_response_t out, in;
+
+    ipc_set_data(&out, data);
+    if (ipc_send_packet(fd[1], &out) != STATUS_SUCCESS || ipc_receive_packet(fd[0], &in) != STATUS_SUCCESS) {
+        return 0;
+    }
+    g_sink += in.data_len;
+    return sizeof(ipc_header_t) + out.data_len;
+}
+
+typedef size_t (*round_trip_fn)(int fd[2], const char* data);
+
+static void bench(const char* name, int type, round_trip_fn round_trip, const char* data, long iterations)
+{
+    int fd[2];
+    size_t bytes = 0;
+
+    if (socketpair(AF_UNIX, type, 0, fd) < 0) {
+        perror("socketpair");
+        return;
+    }
+    uint64_t t0 = now_ns();
+    uint64_t s0 = stime_ns();
+    for (long i = 0; i < iterations; i++) {
+        bytes = round_trip(fd, data);
+    }
+    uint64_t s1 = stime_ns();
+    uint64_t t1 = now_ns();
+    close(fd[0]);
+    close(fd[1]);
+
+    printf("%-8s %5zu B payload  %5zu B on the socket  %7.1f ns/msg  sys %7.1f ns/msg\n", name, strlen(data),
+           bytes, (double)(t1 - t0) / (double)iterations, (double)(s1 - s0) / (double)iterations);
+}
+
+/* Fills 'size' bytes of a new blob with a pattern and sends it the way a module does */
+static ProjectStatus send_blob(int fd, size_t size)
+{
+    ipc_blob_t blob;
+    ProjectStatus status = ipc_blob_create(&blob, size);
+    if (status != STATUS_SUCCESS) {
+        return status;
+    }
+    for (size_t i = 0; i < size; i++) {
+        ((unsigned char*)blob.data)[i] = (unsigned char)(i * 31);
+    }
+    status = ipc_send_blob(fd, &blob, size);
+    ipc_release_blob(&blob);
+    return status;
+}
+
+/* A blob message whose memfd was never sealed, as a module bypassing ipc_send_blob() could send */
+static ProjectStatus send_unsealed_blob(int fd, size_t size)
+{
+    ipc_blob_t blob;
+    ipc_header_t hdr = { .version = IPC_PROTO_VERSION, .flags = IPC_FLAG_BLOB, .mod_id = -1 };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { .iov_base = &hdr, .iov_len = sizeof(hdr) };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control.buf, .msg_controllen = sizeof(control.buf)
+    };
+
+    if (ipc_blob_create(&blob, size) != STATUS_SUCCESS) {
+        return STATUS_ERR_GENERIC;
+    }
+    memset(&control, 0, sizeof(control));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &blob.fd, sizeof(int));
+    ssize_t sent = sendmsg(fd, &msg, 0);
+    ipc_release_blob(&blob);
+    return (sent == (ssize_t)sizeof(hdr)) ? STATUS_SUCCESS : STATUS_ERR_IPC_SEND;
+}
+
+/* Receives a blob message and maps it as the scheduler does. Returns ipc_map_blob()'s status */
+static ProjectStatus receive_blob(int fd, size_t max_size, ipc_blob_t* blob, int* received_fd)
+{
+    ipc_response_t resp;
+    ProjectStatus status = ipc_receive_packet(fd, &resp);
+    if (status != STATUS_SUCCESS) {
+        return status;
+    }
+    *received_fd = resp.blob_fd;
+    return (resp.flags & IPC_FLAG_BLOB) ? ipc_map_blob(&resp, max_size, blob) : STATUS_ERR_IPC_PROTO;
+}
+
+static int blob_holds_pattern(const ipc_blob_t* blob, size_t size)
+{
+    if (blob->data == NULL || blob->size != size) {
+        return 0;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (((const unsigned char*)blob->data)[i] != (unsigned char)(i * 31)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int fd_closed(int fd)
+{
+    return fd >= 0 && fcntl(fd, F_GETFD) < 0;
+}
+
+static void report_check(const char* step, int ok)
+{
+    printf("blob %-32s %s\n", step, ok ? "ok" : "FAILED");
+    if (!ok) g_failures++;
+}
+
+static void check_blobs(void)
+{
+    ipc_blob_t blob = { .data = NULL, .size = 0, .fd = -1 };
+    int fd[2];
+    int received_fd = -1;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) < 0) {
+        perror("socketpair");
+        g_failures++;
+        return;
+    }
+    int lowest_free = dup(0);
+    close(lowest_free);
+
+    /* Create, fill, send, map: the content arrives as written */
+    int ok = send_blob(fd[1], 1 << 20) == STATUS_SUCCESS
+             && receive_blob(fd[0], 1 << 20, &blob, &received_fd) == STATUS_SUCCESS
+             && blob_holds_pattern(&blob, 1 << 20);
+    report_check("round trip (1 MiB)", ok);
+
+    /* The daemon's mapping is released with its fd */
+    ipc_release_blob(&blob);
+    report_check("release", blob.data == NULL && blob.size == 0 && blob.fd == -1 && fd_closed(received_fd));
+    ipc_release_blob(&blob);
+
+    ok = send_blob(fd[1], 0) == STATUS_ERR_INVALID_ARG;
+    report_check("empty blob refused", ok);
+
+    /* Writable memfd: the module could change it while the daemon reads it */
+    ok = send_unsealed_blob(fd[1], 4096) == STATUS_SUCCESS
+         && receive_blob(fd[0], 1 << 20, &blob, &received_fd) == STATUS_ERR_IPC_PROTO
+         && blob.fd == -1 && blob.data == NULL && fd_closed(received_fd);
+    report_check("unsealed blob rejected", ok);
+
+    /* Larger than the module's max_blob_size */
+    ok = send_blob(fd[1], 8192) == STATUS_SUCCESS
+         && receive_blob(fd[0], 4096, &blob, &received_fd) == STATUS_ERR_IPC_PROTO
+         && blob.fd == -1 && blob.data == NULL && fd_closed(received_fd);
+    report_check("oversized blob rejected", ok);
+
+    /* Nothing is left open on either side */
+    int now_free = dup(0);
+    close(now_free);
+    report_check("no fd leaked", now_free == lowest_free);
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+static void bench_blob(size_t size, long iterations)
+{
+    ipc_blob_t blob;
+    int fd[2];
+    int received_fd;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) < 0) {
+        perror("socketpair");
+        return;
+    }
+    uint64_t t0 = now_ns();
+    uint64_t s0 = stime_ns();
+    for (long i = 0; i < iterations; i++) {
+        if (send_blob(fd[1], size) != STATUS_SUCCESS
+            || receive_blob(fd[0], size, &blob, &received_fd) != STATUS_SUCCESS) {
+            fprintf(stderr, "blob round trip failed\n");
+            break;
+        }
+        g_sink += ((const unsigned char*)blob.data)[size - 1];
+        ipc_release_blob(&blob);
+    }
+    uint64_t s1 = stime_ns();
+    uint64_t t1 = now_ns();
+    close(fd[0]);
+    close(fd[1]);
+
+    printf("%-8s %5zu KiB payload %5zu B on the socket  %7.1f ns/msg  sys %7.1f ns/msg\n", "blob", size / 1024,
+           sizeof(ipc_header_t), (double)(t1 - t0) / (double)iterations, (double)(s1 - s0) / (double)iterations);
+}
+
+int main(int argc, char** argv)
+{
+    static const size_t sizes[] = { 0, 15, 256, 2048 };
+    static char data[IPC_PACKET_SIZE];
+    long iterations = (argc > 1) ? strtol(argv[1], NULL, 10) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [<iterations>]\n", argv[0]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        memset(data, 'x', sizes[i]);
+        data[sizes[i]] = '\0';
+        bench("legacy", SOCK_DGRAM, legacy_round_trip, data, iterations);
+        bench("framed", SOCK_SEQPACKET, framed_round_trip, data, iterations);
+    }
+
+    /* Fill and mmap dominate, far fewer iterations are enough */
+    check_blobs();
+    for (size_t size = 64 * 1024; size <= 4 * 1024 * 1024; size *= 4) {
+        bench_blob(size, (iterations / 100 > 0) ? iterations / 100 : 1);
+    }
+    return g_failures ? 1 : 0;
+}
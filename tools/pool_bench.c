@@ -0,0 +1,159 @@
+/*
+ * Per-request latency of the worker pool (worker_pool.h) against forking one sandboxed process
+ * per stage (spawn_module_process()), the two paths sched_run() picks between.
+ * Usage: pool_bench [<requests>] [<daemon MiB>]
+ * A single echo module stands in for the registry, under the caller's own uid/gid. Each request
+ * is timed from dispatch to reaped child (fork) or released worker (pool). 'daemon MiB' of
+ * touched heap makes this process look like a grown daemon, as fork() copies its page tables.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "worker_pool.h"
+#include "process.h"
+#include "modules.h"
+#include "ipc.h"
+
+static volatile uint64_t g_sink;
+
+static void echo_entry(int socket_fd, const char* arg)
+{
+    ipc_response_t resp;
+    ipc_set_data(&resp, (arg != NULL) ? arg : "");
+    ipc_send_packet(socket_fd, &resp);
+}
+
+static module_config_t g_echo = {
+    .id = MOD_ID_IMEI,
+    .name = "Echo",
+    .selinux_context = "u:r:echo:s0",
+    .entry_point = echo_entry,
+};
+
+/* The registry seen by worker_pool.c: only the echo module */
+const module_config_t* get_module_config(int module_id)
+{
+    return (module_id == g_echo.id) ? &g_echo : NULL;
+}
+
+int module_same_domain(const module_config_t* a, const module_config_t* b)
+{
+    return a != NULL && a == b;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char* name, uint64_t* samples, long count)
+{
+    uint64_t total = 0;
+    for (long i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    qsort(samples, (size_t)count, sizeof(samples[0]), compare_u64);
+    printf("%-6s %6ld requests  mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name, count,
+           (double)total / 1e3 / (double)count, (double)samples[count / 2] / 1e3,
+           (double)samples[count * 99 / 100] / 1e3, (double)samples[count - 1] / 1e3);
+}
+
+/* One stage the way sched_run() does without a pool: fork, read the response, reap */
+static int fork_request(void)
+{
+    ipc_response_t resp;
+    int fd = -1;
+
+    pid_t pid = spawn_module_process(&g_echo, &fd, "ping");
+    if (pid < 0) {
+        return -1;
+    }
+    ProjectStatus status = ipc_receive_packet(fd, &resp);
+    close(fd);
+    if (wait_for_process_exit(pid, NULL) != STATUS_SUCCESS || status != STATUS_SUCCESS) {
+        return -1;
+    }
+    g_sink += resp.data_len;
+    return 0;
+}
+
+/* The same stage handed to the warm worker */
+static int pool_request(worker_pool_t* pool)
+{
+    ipc_response_t resp;
+    int fd = -1;
+
+    if (pool_dispatch(pool, g_echo.id, "ping", 5, &fd) != STATUS_SUCCESS) {
+        return -1;
+    }
+    ProjectStatus status = ipc_receive_packet(fd, &resp);
+    pool_release(pool, g_echo.id, status == STATUS_SUCCESS);
+    if (status != STATUS_SUCCESS) {
+        return -1;
+    }
+    g_sink += resp.data_len;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    worker_pool_t pool;
+    long requests = (argc > 1) ? strtol(argv[1], NULL, 10) : 2000;
+    long heap_mib = (argc > 2) ? strtol(argv[2], NULL, 10) : 0;
+    if (requests <= 0 || heap_mib < 0) {
+        fprintf(stderr, "usage: %s [<requests>] [<daemon MiB>]\n", argv[0]);
+        return 1;
+    }
+
+    g_echo.uid = getuid();
+    g_echo.gid = getgid();
+    char* heap = malloc(((size_t)heap_mib << 20) + 1);
+    uint64_t* samples = calloc((size_t)requests, sizeof(*samples));
+    if (heap == NULL || samples == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    memset(heap, 0x5a, (size_t)heap_mib << 20);
+
+    for (long i = 0; i < requests; i++) {
+        uint64_t t0 = now_ns();
+        if (fork_request() != 0) {
+            fprintf(stderr, "fork request %ld failed\n", i);
+            return 1;
+        }
+        samples[i] = now_ns() - t0;
+    }
+    report("fork", samples, requests);
+
+    /* Recycling included: one worker is forked again every WORKER_POOL_MAX_REQUESTS requests */
+    if (pool_init(&pool, WORKER_POOL_MAX_REQUESTS) != STATUS_SUCCESS) {
+        fprintf(stderr, "pool_init failed\n");
+        return 1;
+    }
+    for (long i = 0; i < requests; i++) {
+        uint64_t t0 = now_ns();
+        if (pool_request(&pool) != 0) {
+            fprintf(stderr, "pool request %ld failed\n", i);
+            return 1;
+        }
+        samples[i] = now_ns() - t0;
+    }
+    report("pool", samples, requests);
+    pool_destroy(&pool);
+
+    free(samples);
+    free(heap);
+    return 0;
+}
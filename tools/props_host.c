@@ -0,0 +1,46 @@
+/*
+ * Command line for the file-backed property store used on Linux hosts (see props_file.h).
+ * Usage: props_host set <name> <value>
+ *        props_host get <name>
+ *        props_host wait [<timeout_ms>]      Blocks until any property is written
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "props_file.h"
+
+static void print_prop(void* cookie, const char* name, const char* value, uint32_t serial)
+{
+    (void)cookie;
+    printf("%s=%s (serial %u)\n", name, value, serial);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 4 && strcmp(argv[1], "set") == 0) {
+        if (props_file_set(argv[2], argv[3]) != 0) {
+            fprintf(stderr, "cannot set %s\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "get") == 0) {
+        const prop_info* pi = props_file_find(argv[2]);
+        if (pi == NULL) {
+            return 1;
+        }
+        return props_file_read(pi, print_prop, NULL) == 0 ? 0 : 1;
+    }
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "wait") == 0) {
+        uint32_t serial = 0;
+        uint32_t timeout_ms = (argc == 3) ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+        if (!props_file_wait(NULL, props_file_area_serial(), &serial, timeout_ms)) {
+            return 1;
+        }
+        printf("area serial %u\n", serial);
+        return 0;
+    }
+    fprintf(stderr, "usage: %s set <name> <value> | get <name> | wait [<timeout_ms>]\n", argv[0]);
+    return 2;
+}
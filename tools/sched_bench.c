@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+/*
+ * Effect of the per-module scheduling settings (module_sched_t) on a co-running latency probe.
+ * Usage: sched_bench <dir> [<seconds>] [<hogs>]
+ * For each setting, 'hogs' module processes (default: one per CPU) are spawned through
+ * spawn_module_process() and burn CPU while writing and syncing files in 'dir', as a VACUUM
+ * would. Meanwhile this process, at the daemon's default priority, runs the probe for 'seconds'
+ * (default 5): 1 ms timer sleeps (wake-up latency), small synced writes (I/O latency) and a
+ * unit of work that takes PROBE_WORK_NS when the machine is idle (CPU share).
+ * The 'cleaner' case takes DBCleaner's settings from the module registry, so link src/modules.c.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+
+#include "process.h"
+#include "modules.h"
+
+#define HOG_MAX         64
+#define HOG_WRITE_SIZE  (256 * 1024)
+#define HOG_SPIN_NS     (5 * 1000000ull)    /* CPU burnt between two writes */
+#define PROBE_SLEEP_NS  1000000
+#define PROBE_SAMPLES   100000
+#define PROBE_WORK_NS   1000000
+
+typedef struct bench_case_s {
+    const char* name;
+    const module_sched_t* sched;
+} bench_case_t;
+
+static const module_sched_t SCHED_IDLE_ALL = {
+    .policy = SCHED_IDLE,
+    .ioprio_class = IOPRIO_CLASS_IDLE,
+};
+
+static volatile uint64_t g_sink;
+static uint64_t g_work_loops;   /* Loops of probe_work() that take PROBE_WORK_NS on an idle machine */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Module side: burns CPU and dirties the disk until the daemon cancels it */
+static void hog_entry(int socket_fd, const char* dir)
+{
+    char path[256];
+    static char block[HOG_WRITE_SIZE];
+    (void)socket_fd;
+
+    snprintf(path, sizeof(path), "%s/sched_bench.%d", dir, getpid());
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    unlink(path);
+    memset(block, 0xa5, sizeof(block));
+    while (!module_cancel_requested()) {
+        uint64_t until = now_ns() + HOG_SPIN_NS;
+        while (now_ns() < until) {
+            g_sink++;
+        }
+        if (fd >= 0 && (pwrite(fd, block, sizeof(block), 0) < 0 || fdatasync(fd) < 0)) {
+            break;
+        }
+    }
+    if (fd >= 0) close(fd);
+}
+
+static module_config_t g_hog = {
+    .id = MOD_ID_DB_CLEANER,
+    .name = "Hog",
+    .selinux_context = "u:r:hog:s0",
+    .entry_point = hog_entry,
+};
+
+static void probe_work(uint64_t loops)
+{
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+    for (uint64_t i = 0; i < loops; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    g_sink += x;
+}
+
+static void calibrate_work(void)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 20; i++) {
+        uint64_t t0 = now_ns();
+        probe_work(1000000);
+        uint64_t ns = now_ns() - t0;
+        if (ns < best) best = ns;
+    }
+    g_work_loops = 1000000ull * PROBE_WORK_NS / (best ? best : 1);
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char* name, const char* probe, uint64_t* samples, long count)
+{
+    if (count == 0) {
+        printf("%-8s %-6s no samples\n", name, probe);
+        return;
+    }
+    qsort(samples, (size_t)count, sizeof(samples[0]), compare_u64);
+    printf("%-8s %-6s %6ld samples  p50 %9.1f us  p99 %9.1f us  max %9.1f us\n", name, probe, count,
+           (double)samples[count / 2] / 1e3, (double)samples[count * 99 / 100] / 1e3,
+           (double)samples[count - 1] / 1e3);
+}
+
+/* Alternates a timer sleep, a small synced write and a unit of work, for 'seconds' */
+static void probe(const char* name, const char* dir, long seconds, uint64_t* wake, uint64_t* io, uint64_t* work)
+{
+    char path[256];
+    char byte = 0;
+    long wakes = 0;
+    long writes = 0;
+
+    snprintf(path, sizeof(path), "%s/sched_bench.probe", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    unlink(path);
+
+    uint64_t end = now_ns() + (uint64_t)seconds * 1000000000ull;
+    while (now_ns() < end && wakes < PROBE_SAMPLES) {
+        struct timespec req = { 0, PROBE_SLEEP_NS };
+        uint64_t t0 = now_ns();
+        nanosleep(&req, NULL);
+        wake[wakes++] = now_ns() - t0 - PROBE_SLEEP_NS;
+
+        t0 = now_ns();
+        if (fd >= 0 && pwrite(fd, &byte, 1, 0) == 1 && fdatasync(fd) == 0) {
+            io[writes++] = now_ns() - t0;
+        }
+
+        t0 = now_ns();
+        probe_work(g_work_loops);
+        work[wakes - 1] = now_ns() - t0;
+    }
+    if (fd >= 0) close(fd);
+
+    report(name, "wake", wake, wakes);
+    report(name, "write", io, writes);
+    report(name, "work", work, wakes);
+}
+
+int main(int argc, char** argv)
+{
+    pid_t pids[HOG_MAX];
+    int fds[HOG_MAX];
+    long seconds = (argc > 2) ? strtol(argv[2], NULL, 10) : 5;
+    long hogs = (argc > 3) ? strtol(argv[3], NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc < 2 || seconds <= 0 || hogs <= 0 || hogs > HOG_MAX) {
+        fprintf(stderr, "usage: %s <dir> [<seconds>] [<hogs>]\n", argv[0]);
+        return 1;
+    }
+    /* The cleaner's settings as registered; its cgroup is left out, only module_sched_t is measured */
+    const bench_case_t cases[] = {
+        { "inherit", NULL },
+        { "cleaner", get_module_config(MOD_ID_DB_CLEANER)->sched },
+        { "idle", &SCHED_IDLE_ALL },
+    };
+
+    g_hog.uid = getuid();
+    g_hog.gid = getgid();
+    uint64_t* wake = calloc(PROBE_SAMPLES, sizeof(*wake));
+    uint64_t* io = calloc(PROBE_SAMPLES, sizeof(*io));
+    uint64_t* work = calloc(PROBE_SAMPLES, sizeof(*work));
+    if (wake == NULL || io == NULL || work == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    calibrate_work();
+    probe("alone", argv[1], seconds, wake, io, work);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        g_hog.sched = cases[c].sched;
+        for (long i = 0; i < hogs; i++) {
+            pids[i] = spawn_module_process(&g_hog, &fds[i], argv[1]);
+            if (pids[i] < 0) {
+                fprintf(stderr, "spawn failed\n");
+                return 1;
+            }
+        }
+
+        probe(cases[c].name, argv[1], seconds, wake, io, work);
+
+        /* Cooperative cancel, as at the run deadline */
+        for (long i = 0; i < hogs; i++) {
+            kill(pids[i], SIGTERM);
+        }
+        for (long i = 0; i < hogs; i++) {
+            wait_for_process_exit(pids[i], NULL);
+            close(fds[i]);
+        }
+    }
+
+    free(wake);
+    free(io);
+    free(work);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Crash-safety checks and timings of the upload spool (spool.h), on a host.
+ * Usage: spool_test <spool file>
+ * The file is recreated. Every record carries its number in its first 4 bytes, so each step
+ * checks which records survive: a reopen, a writer dying without a sync, a torn record, wrapping
+ * past SPOOL_CAPACITY, a torn header slot. Prints one line per step, then append and open costs.
+ * Exits non-zero if any step failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "spool.h"
+
+#define HEADER_SLOT_SIZE    64      /* SPOOL_SLOT_SIZE in spool.c */
+
+static int g_failures;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void append(spool_t* spool, uint32_t number, size_t len)
+{
+    uint8_t record[SPOOL_RECORD_MAX];
+    memset(record, (int)number, len);
+    memcpy(record, &number, sizeof(number));
+    spool_append(spool, record, len);
+}
+
+/* Non-zero if the spool holds exactly records 'first' .. 'first' + 'count' - 1, in order */
+static int holds(const spool_t* spool, uint32_t first, uint32_t count)
+{
+    spool_iter_t it;
+    const void* data;
+    size_t len;
+    uint32_t seen = 0;
+
+    spool_iter_init(spool, &it);
+    while (spool_iter_next(spool, &it, &data, &len)) {
+        uint32_t number;
+        memcpy(&number, data, sizeof(number));
+        if (len < sizeof(number) || number != first + seen) {
+            return 0;
+        }
+        seen++;
+    }
+    return seen == count && spool->count == count;
+}
+
+static void report(const char* step, int ok, const spool_t* spool)
+{
+    printf("%-28s %s (%u records)\n", step, ok ? "ok" : "FAILED", spool->count);
+    if (!ok) g_failures++;
+}
+
+/* Flips one byte of the file, behind the mapping's back */
+static void corrupt(const char* path, off_t off)
+{
+    uint8_t byte;
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0 || pread(fd, &byte, 1, off) != 1) {
+        perror(path);
+        exit(1);
+    }
+    byte ^= 0x55;
+    if (pwrite(fd, &byte, 1, off) != 1) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
+
+int main(int argc, char** argv)
+{
+    spool_t spool;
+    spool_iter_t it;
+    const void* data;
+    size_t len;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <spool file>\n", argv[0]);
+        return 1;
+    }
+    const char* path = argv[1];
+    unlink(path);
+
+    spool_open(&spool, path);
+    for (uint32_t i = 0; i < 100; i++) {
+        append(&spool, i, 100 + i % 50);
+    }
+    report("append", holds(&spool, 0, 100), &spool);
+    spool_consume(&spool, 30);
+    spool_close(&spool);
+    spool_open(&spool, path);
+    report("consume, reopen", holds(&spool, 30, 70), &spool);
+
+    /* A Sender that dies before its appends are synced: they may or may not be there, nothing else moves */
+    if (fork() == 0) {
+        spool_t child;
+        spool_open(&child, path);
+        for (uint32_t i = 100; i < 110; i++) {
+            append(&child, i, 200);
+        }
+        _exit(0);
+    }
+    wait(NULL);
+    spool_close(&spool);
+    spool_open(&spool, path);
+    report("writer died unsynced", spool.count >= 70 && holds(&spool, 30, spool.count), &spool);
+
+    /* A torn record ends the ring: the ones before it survive */
+    uint32_t kept = 0;
+    spool_iter_init(&spool, &it);
+    while (spool_iter_next(&spool, &it, &data, &len) && kept < 47) {
+        kept++;
+    }
+    if (kept == 47) {
+        ((uint8_t*)data)[len / 2] ^= 1;
+    }
+    spool_close(&spool);
+    spool_open(&spool, path);
+    report("torn record", holds(&spool, 30, 47), &spool);
+
+    /* Wrap around: the oldest records are dropped, never more than SPOOL_CAPACITY is kept */
+    for (uint32_t i = 1000; i < 5000; i++) {
+        append(&spool, i, 64 + (i * 37) % 900);
+    }
+    uint32_t count = spool.count;
+    report("wrap", count > 0 && holds(&spool, 5000 - count, count), &spool);
+    spool_close(&spool);
+    spool_open(&spool, path);
+    report("wrap, reopen", holds(&spool, 5000 - count, count), &spool);
+
+    /* A torn header slot falls back to the other one: the consumed records come back, at least once */
+    spool_consume(&spool, 10);
+    spool_close(&spool);
+    corrupt(path, (off_t)((spool.gen & 1) * HEADER_SLOT_SIZE + 8));
+    spool_open(&spool, path);
+    report("torn header slot", spool.count >= count - 10 && holds(&spool, 5000 - spool.count, spool.count), &spool);
+
+    spool_consume(&spool, UINT32_MAX);
+    append(&spool, 7, 500);
+    spool_close(&spool);
+    spool_open(&spool, path);
+    report("drain, append", holds(&spool, 7, 1), &spool);
+
+    spool_consume(&spool, UINT32_MAX);
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < 20000; i++) {
+        append(&spool, i, 120);
+    }
+    printf("append 120 B: %.2f us (msync every %d)\n", (double)(now_ns() - t0) / 20000 / 1e3, SPOOL_SYNC_RECORDS);
+    t0 = now_ns();
+    for (int i = 0; i < 200; i++) {
+        spool_close(&spool);
+        spool_open(&spool, path);
+    }
+    printf("close + open of %u records: %.1f us\n", spool.count, (double)(now_ns() - t0) / 200 / 1e3);
+    spool_close(&spool);
+
+    unlink(path);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Benchmark of the statement cache (stmt_cache.h) against the sqlite3_exec path it replaced, on
+ * a local test database.
+ * Usage: stmt_bench <db file> [<rows>] [<operations>]
+ * The file is recreated with 'rows' rows (default 1M). Then, each way, 'operations' point
+ * updates and lookups with the values spliced into the SQL text (exec) or bound (cached), and
+ * DBCleaner-style chunked deletes of DB_CLEAN_CHUNK_ROWS rows.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "sal.h"
+#include "stmt_cache.h"
+#include "db_cleaner.h"
+
+static volatile long long g_sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char* name, uint64_t ns, long count)
+{
+    printf("%-22s %8ld ops  %10.1f ms  %8.2f us/op\n", name, count, (double)ns / 1e6, (double)ns / 1e3 / (double)count);
+}
+
+static int populate(sqlite3* db, stmt_cache_t* cache, long rows)
+{
+    if (sal_sqlite_exec(db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;"
+                            "CREATE TABLE t(id INTEGER PRIMARY KEY, ts INTEGER, payload TEXT);", NULL) != 0
+        || stmt_cache_exec(stmt_cache_get(cache, "BEGIN;")) != STATUS_SUCCESS) {
+        return -1;
+    }
+    for (long i = 1; i <= rows; i++) {
+        sqlite3_stmt* ins = stmt_cache_get(cache, "INSERT INTO t(id, ts, payload) VALUES (?1, ?2, ?3);");
+        sal_sqlite_bind_int64(ins, 1, i);
+        sal_sqlite_bind_int64(ins, 2, i % 1000);
+        sal_sqlite_bind_text(ins, 3, "com.example.app/some.activity", -1);
+        if (stmt_cache_exec(ins) != STATUS_SUCCESS) {
+            return -1;
+        }
+    }
+    return (stmt_cache_exec(stmt_cache_get(cache, "COMMIT;")) == STATUS_SUCCESS) ? 0 : -1;
+}
+
+static void bench_updates(sqlite3* db, stmt_cache_t* cache, long rows, long ops)
+{
+    char sql[128];
+
+    sal_sqlite_exec(db, "BEGIN;", NULL);
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        snprintf(sql, sizeof(sql), "UPDATE t SET ts = %ld WHERE id = %ld;", i, 1 + (i * 7919) % rows);
+        sal_sqlite_exec(db, sql, NULL);
+    }
+    report("update, exec", now_ns() - t0, ops);
+
+    t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        sqlite3_stmt* upd = stmt_cache_get(cache, "UPDATE t SET ts = ?1 WHERE id = ?2;");
+        sal_sqlite_bind_int64(upd, 1, i);
+        sal_sqlite_bind_int64(upd, 2, 1 + (i * 7919) % rows);
+        stmt_cache_exec(upd);
+    }
+    report("update, cached", now_ns() - t0, ops);
+    sal_sqlite_exec(db, "COMMIT;", NULL);
+}
+
+static void bench_lookups(sqlite3* db, stmt_cache_t* cache, long rows, long ops)
+{
+    char sql[128];
+    long long value = 0;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        snprintf(sql, sizeof(sql), "SELECT ts FROM t WHERE id = %ld;", 1 + (i * 104729) % rows);
+        sal_sqlite_query_int(db, sql, &value);
+        g_sink += value;
+    }
+    report("lookup, exec", now_ns() - t0, ops);
+
+    t0 = now_ns();
+    for (long i = 0; i < ops; i++) {
+        sqlite3_stmt* sel = stmt_cache_get(cache, "SELECT ts FROM t WHERE id = ?1;");
+        sal_sqlite_bind_int64(sel, 1, 1 + (i * 104729) % rows);
+        if (sal_sqlite_step(sel) == SQLITE_ROW) {
+            g_sink += sal_sqlite_column_int64(sel, 0);
+        }
+    }
+    report("lookup, cached", now_ns() - t0, ops);
+}
+
+/*
+ * The DBCleaner loop: one chunk per transaction, rows picked by a scan predicate. Each chunk
+ * leaves the table thinner for the next one, so the two paths alternate chunk by chunk.
+ */
+static void bench_chunks(sqlite3* db, stmt_cache_t* cache, long chunks)
+{
+    char sql[192];
+    uint64_t exec_ns = 0;
+    uint64_t cached_ns = 0;
+
+    for (long i = 0; i < chunks; i++) {
+        uint64_t t0 = now_ns();
+        snprintf(sql, sizeof(sql), "BEGIN IMMEDIATE; DELETE FROM t WHERE rowid IN "
+                 "(SELECT rowid FROM t WHERE ts < %d LIMIT %d); COMMIT;", 500, DB_CLEAN_CHUNK_ROWS);
+        sal_sqlite_exec(db, sql, NULL);
+        uint64_t t1 = now_ns();
+        stmt_cache_exec(stmt_cache_get(cache, "BEGIN IMMEDIATE;"));
+        sqlite3_stmt* del = stmt_cache_get(cache, "DELETE FROM t WHERE rowid IN (SELECT rowid FROM t WHERE ts < ?1 LIMIT ?2);");
+        sal_sqlite_bind_int64(del, 1, 500);
+        sal_sqlite_bind_int64(del, 2, DB_CLEAN_CHUNK_ROWS);
+        stmt_cache_exec(del);
+        stmt_cache_exec(stmt_cache_get(cache, "COMMIT;"));
+        exec_ns += t1 - t0;
+        cached_ns += now_ns() - t1;
+    }
+    report("chunked delete, exec", exec_ns, chunks);
+    report("chunked delete, cached", cached_ns, chunks);
+}
+
+int main(int argc, char** argv)
+{
+    sqlite3* db = NULL;
+    stmt_cache_t cache;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <db file> [<rows>] [<operations>]\n", argv[0]);
+        return 1;
+    }
+    long rows = (argc > 2) ? strtol(argv[2], NULL, 10) : 1000000;
+    long ops = (argc > 3) ? strtol(argv[3], NULL, 10) : 100000;
+    if (rows <= 0 || ops <= 0 || sal_init() != STATUS_SUCCESS) {
+        fprintf(stderr, "bad arguments, or libsqlite not found\n");
+        return 1;
+    }
+
+    /* The SAL opens read-write without SQLITE_OPEN_CREATE: an empty file is an empty database */
+    char path[256];
+    unlink(argv[1]);
+    snprintf(path, sizeof(path), "%s-wal", argv[1]);
+    unlink(path);
+    close(open(argv[1], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (sal_sqlite_open(argv[1], &db) != 0) {
+        fprintf(stderr, "%s: cannot open\n", argv[1]);
+        return 1;
+    }
+    stmt_cache_init(&cache, db);
+
+    uint64_t t0 = now_ns();
+    if (populate(db, &cache, rows) != 0) {
+        fprintf(stderr, "populate failed\n");
+        return 1;
+    }
+    report("populate, cached", now_ns() - t0, rows);
+
+    bench_updates(db, &cache, rows, ops);
+    bench_lookups(db, &cache, rows, ops);
+    bench_chunks(db, &cache, ops / DB_CLEAN_CHUNK_ROWS > 0 ? ops / DB_CLEAN_CHUNK_ROWS : 1);
+
+    stmt_cache_destroy(&cache);
+    sal_sqlite_close(db);
+    sal_cleanup();
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Encode / decode microbenchmark of the TLV results (tlv.h) against the text they replace.
+ * Usage: tlv_bench [<iterations>]
+ * Prints ns per operation for the upload record and for the DBCleaner report.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tlv.h"
+#include "modules.h"
+
+#define BENCH_BUF   512
+
+static const char* const IMEI = "356938035643809";
+static const char* const PHONE = "+15555550123";
+
+static volatile uint64_t g_sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t upload_tlv_encode(char* buf, size_t cap)
+{
+    tlv_writer_t w;
+    size_t len = 0;
+    tlv_writer_init(&w, buf, cap);
+    tlv_begin_record(&w, RESULT_TAG_UPLOAD);
+    tlv_put_str(&w, RESULT_TAG_IMEI, IMEI);
+    tlv_put_str(&w, RESULT_TAG_PHONE, PHONE);
+    tlv_put_uint(&w, RESULT_TAG_DB_CLEANED, 1);
+    tlv_put_uint(&w, RESULT_TAG_PARTIAL, 0);
+    tlv_end_record(&w);
+    tlv_finish(&w, &len);
+    return len;
+}
+
+static uint64_t upload_tlv_decode(const char* buf, size_t len)
+{
+    tlv_field_t upload, field;
+    tlv_reader_t r;
+    uint64_t sum = 0;
+    if (!tlv_find(buf, len, RESULT_TAG_UPLOAD, &upload)) {
+        return 0;
+    }
+    tlv_open_record(&upload, &r);
+    while (tlv_next(&r, &field) == 1) {
+        sum += (field.type == TLV_BYTES) ? field.len : field.u;
+    }
+    return sum;
+}
+
+static size_t upload_text_encode(char* buf, size_t cap)
+{
+    return (size_t)snprintf(buf, cap, "IMEI:%s|PHONE:%s|DB:%d|PARTIAL:%d", IMEI, PHONE, 1, 0);
+}
+
+static uint64_t upload_text_decode(const char* buf, size_t len)
+{
+    char copy[BENCH_BUF];
+    char* save = NULL;
+    uint64_t sum = 0;
+    memcpy(copy, buf, len + 1);
+    for (char* tok = strtok_r(copy, "|", &save); tok != NULL; tok = strtok_r(NULL, "|", &save)) {
+        char* value = strchr(tok, ':');
+        if (value == NULL) continue;
+        value++;
+        if (strncmp(tok, "DB:", 3) == 0 || strncmp(tok, "PARTIAL:", 8) == 0) {
+            sum += strtoull(value, NULL, 10);
+        } else {
+            sum += strlen(value);
+        }
+    }
+    return sum;
+}
+
+static size_t report_tlv_encode(char* buf, size_t cap)
+{
+    tlv_writer_t w;
+    size_t len = 0;
+    tlv_writer_init(&w, buf, cap);
+    tlv_put_uint(&w, RESULT_TAG_ROWS_DELETED, 12345);
+    tlv_put_uint(&w, RESULT_TAG_PAGES_FREED, 678);
+    tlv_put_uint(&w, RESULT_TAG_CLEAN_COMPLETE, 1);
+    tlv_finish(&w, &len);
+    return len;
+}
+
+static uint64_t report_tlv_decode(const char* buf, size_t len)
+{
+    tlv_reader_t r;
+    tlv_field_t field;
+    uint64_t sum = 0;
+    tlv_reader_init(&r, buf, len);
+    while (tlv_next(&r, &field) == 1) {
+        sum += field.u;
+    }
+    return sum;
+}
+
+static size_t report_text_encode(char* buf, size_t cap)
+{
+    return (size_t)snprintf(buf, cap, "deleted=%lld freed=%lld complete=%d", 12345ll, 678ll, 1);
+}
+
+static uint64_t report_text_decode(const char* buf, size_t len)
+{
+    long long deleted = 0, freed = 0;
+    int complete = 0;
+    (void)len;
+    if (sscanf(buf, "deleted=%lld freed=%lld complete=%d", &deleted, &freed, &complete) != 3) {
+        return 0;
+    }
+    return (uint64_t)(deleted + freed + complete);
+}
+
+typedef size_t (*encode_fn)(char* buf, size_t cap);
+typedef uint64_t (*decode_fn)(const char* buf, size_t len);
+
+static void bench(const char* name, encode_fn encode, decode_fn decode, long iterations)
+{
+    char buf[BENCH_BUF];
+    size_t len = 0;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        len = encode(buf, sizeof(buf));
+        g_sink += (uint8_t)buf[len / 2];
+    }
+    uint64_t t1 = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        g_sink += decode(buf, len);
+    }
+    uint64_t t2 = now_ns();
+
+    printf("%-14s %4zu bytes  encode %7.1f ns  decode %7.1f ns\n", name, len,
+           (double)(t1 - t0) / (double)iterations, (double)(t2 - t1) / (double)iterations);
+}
+
+int main(int argc, char** argv)
+{
+    long iterations = (argc > 1) ? strtol(argv[1], NULL, 10) : 1000000;
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [<iterations>]\n", argv[0]);
+        return 1;
+    }
+    bench("upload tlv", upload_tlv_encode, upload_tlv_decode, iterations);
+    bench("upload text", upload_text_encode, upload_text_decode, iterations);
+    bench("report tlv", report_tlv_encode, report_tlv_decode, iterations);
+    bench("report text", report_text_encode, report_text_decode, iterations);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * Offline decoder for the dumps written by trace_dump().
+ * Usage: trace_decode <trace.PID>...
+ * Prints one line per event: wall clock time, pid, level, call site and the formatted message.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+typedef struct decoded_site_s {
+    uint32_t line;
+    uint8_t level;
+    uint8_t nargs;
+    char* fmt;
+    char* file;
+} decoded_site_t;
+
+static const char* level_name(uint8_t level)
+{
+    switch (level) {
+    case TRACE_LEVEL_DEBUG: return "D";
+    case TRACE_LEVEL_INFO:  return "I";
+    case TRACE_LEVEL_ERROR: return "E";
+    default:                return "?";
+    }
+}
+
+static char* read_string(FILE* f, uint16_t len)
+{
+    char* str = malloc((size_t)len + 1);
+    if (str == NULL || fread(str, 1, len, f) != len) {
+        free(str);
+        return NULL;
+    }
+    str[len] = '\0';
+    return str;
+}
+
+/*
+ * Re-applies one printf conversion to a raw argument. 'spec' is the full conversion ("%08llx"),
+ * length modifiers are replaced since every argument was widened to 64 bits.
+ */
+static void format_arg(const char* spec, size_t spec_len, const trace_event_t* ev, int idx, int* str_used)
+{
+    char conv = spec[spec_len - 1];
+    char fmt[32];
+    size_t flags_len = 0;
+
+    /* Flags, width and precision, without the length modifiers */
+    for (size_t i = 0; i + 1 < spec_len && flags_len < sizeof(fmt) - 4; i++) {
+        if (strchr("hljztL", spec[i]) == NULL) {
+            fmt[flags_len++] = spec[i];
+        }
+    }
+
+    uint64_t raw = (idx < TRACE_MAX_ARGS) ? ev->args[idx] : 0;
+    switch (conv) {
+    case 'd': case 'i':
+        memcpy(fmt + flags_len, "ll", 2);
+        fmt[flags_len + 2] = conv;
+        fmt[flags_len + 3] = '\0';
+        printf(fmt, (long long)raw);
+        break;
+    case 'u': case 'x': case 'X': case 'o':
+        memcpy(fmt + flags_len, "ll", 2);
+        fmt[flags_len + 2] = conv;
+        fmt[flags_len + 3] = '\0';
+        /* Narrow arguments were sign-extended: keep the width the site asked for */
+        if (strstr(spec, "ll") == NULL && strchr(spec, 'z') == NULL && strchr(spec, 'l') == NULL) {
+            raw &= 0xffffffffu;
+        }
+        printf(fmt, (unsigned long long)raw);
+        break;
+    case 'c':
+        putchar((int)(raw & 0xff));
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+        double value;
+        memcpy(&value, &raw, sizeof(value));
+        fmt[flags_len] = conv;
+        fmt[flags_len + 1] = '\0';
+        printf(fmt, value);
+        break;
+    }
+    case 'p':
+        printf("0x%llx", (unsigned long long)raw);
+        break;
+    case 's':
+        if (!*str_used && ev->str_len > 0) {
+            /* Only the first string argument travels with the event */
+            *str_used = 1;
+            int len = ev->str_len - 1;
+            printf("%.*s%s", len, ev->str, (len == TRACE_STR_INLINE) ? "~" : "");
+        } else {
+            printf("<str@0x%llx>", (unsigned long long)raw);
+        }
+        break;
+    default:
+        fwrite(spec, 1, spec_len, stdout);
+        break;
+    }
+}
+
+static void print_event(const trace_dump_header_t* hdr, const decoded_site_t* site, const trace_event_t* ev)
+{
+    /* Linear between the two calibration points; the counter is constant-rate on every target */
+    double ns_per_tick = (hdr->dump_ticks > hdr->base_ticks)
+        ? (double)(hdr->dump_ns - hdr->base_ns) / (double)(hdr->dump_ticks - hdr->base_ticks) : 1.0;
+    uint64_t mono_ns = hdr->base_ns + (uint64_t)((double)(int64_t)(ev->ticks - hdr->base_ticks) * ns_per_tick);
+    uint64_t real_ns = mono_ns + hdr->mono_to_real_ns;
+    time_t secs = (time_t)(real_ns / 1000000000ull);
+    struct tm tm;
+    char when[32];
+    localtime_r(&secs, &tm);
+    strftime(when, sizeof(when), "%m-%d %H:%M:%S", &tm);
+    printf("%s.%06llu %5d %s %s:%u  ", when, (unsigned long long)(real_ns % 1000000000ull) / 1000,
+           hdr->pid, level_name(site->level), site->file, site->line);
+
+    int arg = 0;
+    int str_used = 0;
+    for (const char* p = site->fmt; *p != '\0'; p++) {
+        if (*p != '%') {
+            putchar(*p);
+            continue;
+        }
+        if (p[1] == '%') {
+            putchar('%');
+            p++;
+            continue;
+        }
+        size_t len = strspn(p + 1, "-+ #0123456789.*hljztL") + 2;
+        if (p[len - 1] == '\0') {
+            fputs(p, stdout);
+            break;
+        }
+        format_arg(p, len, ev, arg++, &str_used);
+        p += len - 1;
+    }
+    putchar('\n');
+}
+
+static int decode_file(const char* path)
+{
+    trace_dump_header_t hdr;
+    decoded_site_t* sites = NULL;
+    trace_event_t ev;
+    int res = -1;
+
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_DUMP_MAGIC
+        || hdr.version != TRACE_DUMP_VERSION || hdr.event_size != sizeof(trace_event_t)) {
+        fprintf(stderr, "%s: not a trace dump (or another version)\n", path);
+        goto out;
+    }
+
+    sites = calloc(hdr.site_count + 1, sizeof(*sites));
+    if (sites == NULL) {
+        goto out;
+    }
+    for (uint32_t i = 0; i < hdr.site_count; i++) {
+        trace_dump_site_t rec;
+        if (fread(&rec, sizeof(rec), 1, f) != 1) {
+            goto out;
+        }
+        sites[i].line = rec.line;
+        sites[i].level = rec.level;
+        sites[i].nargs = rec.nargs;
+        sites[i].fmt = read_string(f, rec.fmt_len);
+        sites[i].file = read_string(f, rec.file_len);
+        if (sites[i].fmt == NULL || sites[i].file == NULL) {
+            goto out;
+        }
+    }
+
+    if (hdr.lost > 0) {
+        printf("# pid %d: %u events lost (ring overwritten or in flight)\n", hdr.pid, hdr.lost);
+    }
+    for (uint32_t i = 0; i < hdr.event_count && fread(&ev, sizeof(ev), 1, f) == 1; i++) {
+        if (ev.site_id >= hdr.site_count) {
+            printf("# pid %d: event with unknown site %u\n", hdr.pid, ev.site_id);
+            continue;
+        }
+        print_event(&hdr, &sites[ev.site_id], &ev);
+    }
+    res = 0;
+
+out:
+    if (sites != NULL) {
+        for (uint32_t i = 0; i < hdr.site_count; i++) {
+            free(sites[i].fmt);
+            free(sites[i].file);
+        }
+        free(sites);
+    }
+    fclose(f);
+    return res;
+}
+
+int main(int argc, char** argv)
+{
+    int res = 0;
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace dump>...\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (decode_file(argv[i]) != 0) {
+            res = 1;
+        }
+    }
+    return res;
+}
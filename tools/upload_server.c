@@ -0,0 +1,128 @@
+/*
+ * Stand-in for the upload server, to check the Sender's frames (upload.h) on a host.
+ * Usage: upload_server [-d <percent>] <state file>
+ * Reads one frame per line on stdin and answers each on stdout: "OK <version>", or "RESYNC" when
+ * a delta frame is not against the version in the state file. Delete the file to make the server
+ * forget its state. The state after every frame is printed on stderr, as the old text upload.
+ * With -d, that percentage of frames drops the connection: the server exits without answering,
+ * either before applying the frame (lost request) or after (lost acknowledgement).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "upload.h"
+#include "modules.h"
+
+static void print_state(const upload_state_t* state, size_t text_len, size_t frame_len)
+{
+    char imei[256] = "N/A";
+    char phone[256] = "N/A";
+    uint64_t db_cleaned = 0;
+    uint64_t partial = 0;
+    tlv_reader_t r;
+    tlv_field_t field;
+
+    tlv_reader_init(&r, state->fields, state->len);
+    while (tlv_next(&r, &field) == 1) {
+        switch (field.tag) {
+        case RESULT_TAG_IMEI:       tlv_copy_str(&field, imei, sizeof(imei)); break;
+        case RESULT_TAG_PHONE:      tlv_copy_str(&field, phone, sizeof(phone)); break;
+        case RESULT_TAG_DB_CLEANED: db_cleaned = field.u; break;
+        case RESULT_TAG_PARTIAL:    partial = field.u; break;
+        default:                    break;
+        }
+    }
+    fprintf(stderr, "version %llu (%zu bytes sent, %zu decoded): IMEI:%s|PHONE:%s|DB:%d|PARTIAL:%d\n",
+            (unsigned long long)state->acked, text_len, frame_len, imei, phone, (int)db_cleaned, (int)partial);
+}
+
+/* The reply to one frame. 'state' is only changed when the whole frame applied */
+static const char* apply_frame(upload_state_t* state, const char* text)
+{
+    static uint8_t frame[UPLOAD_FRAME_MAX];
+    upload_state_t next = *state;
+    tlv_reader_t r;
+    tlv_field_t field;
+    size_t len = 0;
+    uint64_t base_version = 0;
+    int full = 0;
+
+    if (upload_decode_frame(text, frame, sizeof(frame), &len) != STATUS_SUCCESS) {
+        return "ERROR";
+    }
+    tlv_reader_init(&r, frame, len);
+    while (tlv_next(&r, &field) == 1) {
+        switch (field.tag) {
+        case RESULT_TAG_BASE_VERSION:
+            base_version = field.u;
+            break;
+        case RESULT_TAG_FULL:
+            full = (field.u != 0);
+            next.len = 0;
+            next.acked = base_version;
+            break;
+        case RESULT_TAG_DELTA:
+            /* BASE_VERSION and FULL come first: by now a delta frame was checked against the state */
+            if (!full && base_version != state->acked) {
+                return UPLOAD_RESYNC_REPLY;
+            }
+            if (upload_apply_delta(&next, &field) != STATUS_SUCCESS) {
+                return "ERROR";
+            }
+            next.acked++;
+            break;
+        default:
+            break;
+        }
+    }
+    *state = next;
+    print_state(state, strlen(text), len);
+    return UPLOAD_ACK_REPLY;
+}
+
+int main(int argc, char** argv)
+{
+    static char line[UPLOAD_TEXT_MAX + 2];
+    upload_state_t state;
+    long drop_pct = 0;
+
+    if (argc == 4 && strcmp(argv[1], "-d") == 0) {
+        drop_pct = strtol(argv[2], NULL, 10);
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc != 2 || drop_pct < 0 || drop_pct > 100) {
+        fprintf(stderr, "usage: %s [-d <percent>] <state file>\n", argv[0]);
+        return 1;
+    }
+    srand((unsigned)time(NULL) ^ ((unsigned)getpid() << 16));
+
+    upload_state_load(&state, argv[1]);
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+        int drop = (rand() % 100) < drop_pct;
+        if (drop && (rand() & 1)) {
+            fprintf(stderr, "connection dropped, frame lost\n");
+            return 1;
+        }
+        const char* reply = apply_frame(&state, line);
+        if (strcmp(reply, UPLOAD_ACK_REPLY) == 0) {
+            upload_state_save(&state, argv[1]);
+            if (drop) {
+                fprintf(stderr, "connection dropped, acknowledgement lost\n");
+                return 1;
+            }
+            printf("%s %llu\n", UPLOAD_ACK_REPLY, (unsigned long long)state.acked);
+        } else {
+            printf("%s\n", reply);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
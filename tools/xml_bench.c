@@ -0,0 +1,315 @@
+/*
+ * Throughput of the shared prefs scanner (xml_utils.h) on generated files.
+ * Usage: xml_bench <dir> [<max MiB>]
+ * Writes shared prefs files of 1 KB up to 'max MiB' (default 64) in 'dir' and times full passes
+ * of xml_for_each_entry() over each, mapped and streamed in windows. MB/s staying flat as the
+ * size grows is the linear scaling the scanner is meant to have.
+ * Then writes the same key sets as text and as Android Binary XML (xml_abx.h), checks that both
+ * read back to the same values, and times a pass over each: 'abx+fmt' also renders every typed
+ * value as text, the worst case of a visitor that copies all values out.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "xml_utils.h"
+#include "xml_abx.h"
+
+#define BENCH_BYTES     (256ull << 20)      /* Bytes scanned per case, whatever the file size */
+#define ABX_INTERN_MAX  16                  /* Strings the ABX writer interns: tag and attribute names */
+
+/* Value kinds of the generated entries, the ones SharedPreferences writes */
+typedef enum bench_kind_s {
+    KIND_STRING = 0,
+    KIND_INT,
+    KIND_LONG,
+    KIND_BOOL,
+    KIND_FLOAT,
+    KIND_COUNT
+} bench_kind_e;
+
+static const char* const KIND_TAGS[KIND_COUNT] = { "string", "int", "long", "boolean", "float" };
+
+static volatile uint64_t g_sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Entry 'i' of the key set: its kind, key and value as the text serializer writes it */
+static bench_kind_e make_entry(long i, char* key, size_t key_len, char* value, size_t value_len)
+{
+    bench_kind_e kind = (bench_kind_e)(i % KIND_COUNT);
+    snprintf(key, key_len, "com.example.app.pref_%07ld", i);
+    switch (kind) {
+    case KIND_STRING: snprintf(value, value_len, "session-%08lx-%04ld", (unsigned long)(i * 2654435761u), i % 9973); break;
+    case KIND_INT:    snprintf(value, value_len, "%ld", (i * 7919) % 100000); break;
+    case KIND_LONG:   snprintf(value, value_len, "%lld", 1700000000000ll + i * 1000); break;
+    case KIND_BOOL:   snprintf(value, value_len, "%s", (i & 1) ? "true" : "false"); break;
+    default:          snprintf(value, value_len, "%ld.5", i % 1000); break;
+    }
+    return kind;
+}
+
+/*
+ * Writes entries until the file reaches 'target' bytes, or 'max_entries' entries were written.
+ * Returns its size, 0 on failure. '*count' receives the number of entries.
+ */
+static size_t write_text(const char* path, size_t target, long max_entries, long* count)
+{
+    char key[64];
+    char value[64];
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        return 0;
+    }
+
+    fputs("<?xml version='1.0' encoding='utf-8' standalone='yes' ?>\n<map>\n", f);
+    long i;
+    for (i = 0; i < max_entries && (size_t)ftell(f) < target; i++) {
+        bench_kind_e kind = make_entry(i, key, sizeof(key), value, sizeof(value));
+        if (kind == KIND_STRING) {
+            fprintf(f, "    <string name=\"%s\">%s</string>\n", key, value);
+        } else {
+            fprintf(f, "    <%s name=\"%s\" value=\"%s\" />\n", KIND_TAGS[kind], key, value);
+        }
+    }
+    fputs("</map>\n", f);
+    long size = ftell(f);
+    *count = i;
+    return (fclose(f) == 0 && size > 0) ? (size_t)size : 0;
+}
+
+/* The subset of Android's BinaryXmlSerializer that SharedPreferences uses, see xml_abx.c */
+typedef struct abx_writer_s {
+    FILE* f;
+    const char* interned[ABX_INTERN_MAX];
+    int interned_count;
+} abx_writer_t;
+
+static void abx_put_be(abx_writer_t* w, uint64_t v, int bytes)
+{
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        fputc((int)((v >> shift) & 0xFF), w->f);
+    }
+}
+
+static void abx_put_utf(abx_writer_t* w, const char* str)
+{
+    size_t len = strlen(str);
+    abx_put_be(w, len, 2);
+    fwrite(str, 1, len, w->f);
+}
+
+static void abx_put_interned(abx_writer_t* w, const char* str)
+{
+    for (int i = 0; i < w->interned_count; i++) {
+        if (strcmp(w->interned[i], str) == 0) {
+            abx_put_be(w, (uint64_t)i, 2);
+            return;
+        }
+    }
+    if (w->interned_count < ABX_INTERN_MAX) {
+        w->interned[w->interned_count++] = str;
+    }
+    abx_put_be(w, 0xFFFF, 2);
+    abx_put_utf(w, str);
+}
+
+/* Token byte: command in the low nibble, value type in the high one */
+static void abx_put_token(abx_writer_t* w, int command, int type)
+{
+    fputc(command | (type << 4), w->f);
+}
+
+/* Writes the first 'count' entries of the key set. Returns the file size, 0 on failure */
+static size_t write_abx(const char* path, long count)
+{
+    char key[64];
+    char value[64];
+    abx_writer_t w = { fopen(path, "w"), { NULL }, 0 };
+    if (w.f == NULL) {
+        return 0;
+    }
+
+    fwrite("ABX", 1, ABX_MAGIC_SIZE, w.f);
+    abx_put_token(&w, 0, 1);                            /* START_DOCUMENT, null */
+    abx_put_token(&w, 2, 3);                            /* START_TAG, interned */
+    abx_put_interned(&w, "map");
+    for (long i = 0; i < count; i++) {
+        bench_kind_e kind = make_entry(i, key, sizeof(key), value, sizeof(value));
+        abx_put_token(&w, 2, 3);
+        abx_put_interned(&w, KIND_TAGS[kind]);
+        abx_put_token(&w, 15, 2);                       /* ATTRIBUTE, string */
+        abx_put_interned(&w, "name");
+        abx_put_utf(&w, key);
+
+        union { float f; uint32_t u; } f32;
+        switch (kind) {
+        case KIND_STRING:
+            abx_put_token(&w, 4, 2);                    /* TEXT, string */
+            abx_put_utf(&w, value);
+            break;
+        case KIND_INT:
+            abx_put_token(&w, 15, 6);                   /* ATTRIBUTE, int */
+            abx_put_interned(&w, "value");
+            abx_put_be(&w, (uint32_t)strtol(value, NULL, 10), 4);
+            break;
+        case KIND_LONG:
+            abx_put_token(&w, 15, 8);                   /* ATTRIBUTE, long */
+            abx_put_interned(&w, "value");
+            abx_put_be(&w, (uint64_t)strtoll(value, NULL, 10), 8);
+            break;
+        case KIND_BOOL:
+            abx_put_token(&w, 15, (value[0] == 't') ? 12 : 13);
+            abx_put_interned(&w, "value");
+            break;
+        default:
+            f32.f = strtof(value, NULL);
+            abx_put_token(&w, 15, 10);                  /* ATTRIBUTE, float */
+            abx_put_interned(&w, "value");
+            abx_put_be(&w, f32.u, 4);
+            break;
+        }
+        abx_put_token(&w, 3, 3);                        /* END_TAG, interned */
+        abx_put_interned(&w, KIND_TAGS[kind]);
+    }
+    abx_put_token(&w, 3, 3);
+    abx_put_interned(&w, "map");
+    abx_put_token(&w, 1, 1);                            /* END_DOCUMENT, null */
+
+    long size = ftell(w.f);
+    return (fclose(w.f) == 0 && size > 0) ? (size_t)size : 0;
+}
+
+static int count_entry(void* user, const xml_entry_t* entry)
+{
+    (*(long*)user)++;
+    g_sink += entry->value.len;
+    return 0;
+}
+
+/* Text of every value, as a visitor copying all of them out would need it */
+static int render_entry(void* user, const xml_entry_t* entry)
+{
+    char text[64];
+    (*(long*)user)++;
+    if (entry->type != XML_VALUE_TEXT) {
+        g_sink += xml_format_value(entry->type, entry->raw, text, sizeof(text));
+    } else {
+        g_sink += entry->value.len;
+    }
+    return 0;
+}
+
+/* FNV-1a over every key and value, in document order */
+static int hash_entry(void* user, const xml_entry_t* entry)
+{
+    uint64_t* hash = user;
+    char text[64];
+    xml_span_t spans[2] = { entry->name, entry->value };
+    if (entry->type != XML_VALUE_TEXT) {
+        spans[1].ptr = text;
+        spans[1].len = xml_format_value(entry->type, entry->raw, text, sizeof(text));
+    }
+    for (int s = 0; s < 2; s++) {
+        for (size_t i = 0; i < spans[s].len; i++) {
+            *hash = (*hash ^ (uint8_t)spans[s].ptr[i]) * 0x100000001b3ull;
+        }
+        *hash = (*hash ^ 0xFF) * 0x100000001b3ull;
+    }
+    return 0;
+}
+
+static uint64_t hash_file(int fd, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    return (xml_for_each_entry(fd, size, hash_entry, &hash) == STATUS_SUCCESS) ? hash : 0;
+}
+
+/* 'size' 0 makes xml_for_each_entry() stream the file in windows instead of mapping it */
+static void bench(const char* name, int fd, size_t file_size, size_t size, xml_entry_fn fn)
+{
+    long passes = (long)(BENCH_BYTES / file_size) + 1;
+    long entries = 0;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < passes; i++) {
+        entries = 0;
+        if (xml_for_each_entry(fd, size, fn, &entries) != STATUS_SUCCESS) {
+            fprintf(stderr, "%s: scan failed\n", name);
+            return;
+        }
+    }
+    uint64_t ns = now_ns() - t0;
+
+    printf("%-8s %10zu B  %7ld entries  %10.1f us/pass  %7.1f MB/s\n", name, file_size, entries,
+           (double)ns / 1e3 / (double)passes, (double)file_size * (double)passes * 1e3 / (double)ns);
+}
+
+/* Same key set, both formats: values must read back identical before anything is timed */
+static int bench_abx(const char* text_path, const char* abx_path, long count)
+{
+    long written = 0;
+    size_t text_size = write_text(text_path, (size_t)-1, count, &written);
+    size_t abx_size = write_abx(abx_path, count);
+    int text_fd = open(text_path, O_RDONLY | O_CLOEXEC);
+    int abx_fd = open(abx_path, O_RDONLY | O_CLOEXEC);
+    int ret = -1;
+
+    if (text_size == 0 || abx_size == 0 || text_fd < 0 || abx_fd < 0) {
+        fprintf(stderr, "%s: cannot write\n", abx_path);
+    } else if (hash_file(text_fd, text_size) != hash_file(abx_fd, abx_size)) {
+        fprintf(stderr, "%ld entries: ABX and text read back differently\n", count);
+    } else {
+        bench("text", text_fd, text_size, text_size, count_entry);
+        bench("abx", abx_fd, abx_size, abx_size, count_entry);
+        bench("abx+fmt", abx_fd, abx_size, abx_size, render_entry);
+        ret = 0;
+    }
+    if (text_fd >= 0) close(text_fd);
+    if (abx_fd >= 0) close(abx_fd);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    static const long ABX_COUNTS[] = { 100, 1000, 10000, 100000, 1000000 };
+    char path[256];
+    char abx_path[256];
+    long count;
+    long max_mib = (argc > 2) ? strtol(argv[2], NULL, 10) : 64;
+    if (argc < 2 || max_mib <= 0) {
+        fprintf(stderr, "usage: %s <dir> [<max MiB>]\n", argv[0]);
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "%s/xml_bench.xml", argv[1]);
+    for (size_t target = 1024; target <= ((size_t)max_mib << 20); target *= 4) {
+        size_t size = write_text(path, target, (long)target, &count);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (size == 0 || fd < 0) {
+            fprintf(stderr, "%s: cannot write\n", path);
+            return 1;
+        }
+        bench("mapped", fd, size, size, count_entry);
+        bench("streamed", fd, size, 0, count_entry);
+        close(fd);
+    }
+
+    snprintf(abx_path, sizeof(abx_path), "%s/xml_bench.abx", argv[1]);
+    for (size_t i = 0; i < sizeof(ABX_COUNTS) / sizeof(ABX_COUNTS[0]); i++) {
+        if (bench_abx(path, abx_path, ABX_COUNTS[i]) != 0) {
+            return 1;
+        }
+    }
+    unlink(path);
+    unlink(abx_path);
+    return 0;
+}